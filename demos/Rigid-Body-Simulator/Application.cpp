@@ -12,6 +12,7 @@
 #include "Shape.h"
 
 #include "PrototypePhysicsEngine/P3DynamicsWorld.h"
+#include "PrototypePhysicsEngine/P3OpenGLBackends.h"
 
 // UI stuff
 #include "imgui.h"
@@ -57,6 +58,9 @@ void Application::init()
 	oglutils::checkAndEnableDebugOutput();
 
 	initRenderSystem();
+
+	// The demo runs the whole pipeline on the GPU, the context is current by now
+	mPhysicsWorld.setBackends(P3::createOpenGLBackends());
 	initPhysicsWorld(Demo::ROTATIONAL_TEST);
 	initUI();
 }
@@ -649,7 +653,7 @@ void Application::renderFrame(float dt)
 
 	mRenderSystem.setView(mFlyCamera.getViewMatrix());
 
-	mRenderSystem.render(mModelMatrixContainer, mpCollisionPairPkg, mPhysicsWorld.getRigidBodyCount());
+	mRenderSystem.render(mModelMatrixContainer, mpCollisionPairPkg, mLinearTransformContainer);
 	//mRenderSystem.renderInstanced(mModelMatrixContainer);
 
 	if (showHitBoxVerts)
@@ -721,42 +725,53 @@ void Application::shootBall()
 		glm::vec3(0.0f, 0.0f, -10.0f)
 	);
 
+	// Projectiles are fast enough to skip through thin walls in a single step
+	mPhysicsWorld.setContinuousCollision(mPhysicsWorld.getBodyCount() - 1, true);
+
 	mRenderSystem.registerMeshForBody(RenderSystem::MeshKey::SPHERE, 1u);
 }
 
-void Application::update(float dt)
+void Application::update(float frameDt)
 {
-	mPhysicsWorld.detectCollisions();
+	mPhysicsWorld.advance(frameDt, [this](float dt) { step(dt); });
 
+	// Get collision data if needed
+	mpCollisionPairPkg = mPhysicsWorld.getPCollisionPairPkg();
+	mpManifoldPkg      = mPhysicsWorld.getPManifoldPkg();
+
+	// Update the model matrix array - the bridge from physics quantity to transform matrices for graphics
+	// Combine both rigid and static linear transforms
+	updateModelMatrices();
+}
+
+void Application::step(float dt)
+{
+	// The whole step as one task graph
 	switch (mDemo)
 	{
-	case Demo::BOWLING_GAME:
-		mPhysicsWorld.updateBowlingGame(dt);
+	case Demo::GRAVITY_TEST:
+	case Demo::ROTATIONAL_TEST:
+		mPhysicsWorld.step(dt);
 		break;
 
 	case Demo::MULTIPLE_BOXES:
-		mPhysicsWorld.updateMultipleBoxes(dt);
+		mPhysicsWorld.stepMultipleBoxes(dt);
 		break;
 
-	case Demo::GRAVITY_TEST:
-	case Demo::ROTATIONAL_TEST:
-		mPhysicsWorld.updateGravityTest(dt);
+	// Collision detection alone as a graph, the updates after it stay serial: they are empty for now, so there is
+	//  nothing to run as tasks, and the controllable box reads the inputs, which only this thread may touch
+	case Demo::BOWLING_GAME:
+		mPhysicsWorld.detectCollisions(dt);
+		mPhysicsWorld.updateBowlingGame(dt);
 		break;
 
 	case Demo::CONTROLLABLE_BOX:
 	default:
+		mPhysicsWorld.detectCollisions(dt);
 		updateWithInputs(dt);
 	}
 
 	mPhysicsTickInterval = dt;
-
-	// Get collision data if needed
-	mpCollisionPairPkg = mPhysicsWorld.getPCollisionPairPkg();
-	mpManifoldPkg      = mPhysicsWorld.getPManifoldPkg();
-
-	// Update the model matrix array - the bridge from physics quantity to transform matrices for graphics
-	// Combine both rigid and static linear transforms
-	updateModelMatrices();
 }
 
 void Application::updateWithInputs(float dt)
@@ -786,66 +801,7 @@ void Application::updateWithInputs(float dt)
 
 void Application::updateModelMatrices()
 {
-	int offset = 0;
-
-	// First wipe, rigid bodies
-	for (int i = 0; i < mRigidLinearTransformContainer.size(); ++i)
-	{
-		glm::mat4 translation = glm::translate(glm::vec3(mRigidLinearTransformContainer[i].position));
-
-		if (i >= mModelMatrixContainer.size())
-		{
-			mModelMatrixContainer.emplace_back(translation);
-		}
-		else
-		{
-			mModelMatrixContainer[i] = translation;
-		}
-
-		++offset;
-	}
-
-	// Angular transforms follow up, indices should sync up with linear transforms
-	for (int j = 0; j < mRigidAngularTransformContainer.size(); ++j)
-	{
-		AngularTransform const &angularTransform = mRigidAngularTransformContainer[j];
-
-		if (glm::vec3(angularTransform.angularVelocity) == glm::vec3(0.0f))
-		{
-			mModelMatrixContainer[j] *= glm::mat4(1.0f);
-		}
-		else
-		{
-			mModelMatrixContainer[j] *= glm::mat4_cast(angularTransform.orientation);
-		}
-	}
-
-	// Static bodies
-	for (int k = 0; k < mStaticLinearTransformContainer.size(); ++k)
-	{
-		glm::mat4 translation = glm::translate(glm::vec3(mStaticLinearTransformContainer[k].position));
-
-		if ((k + offset) >= mModelMatrixContainer.size())
-		{
-			mModelMatrixContainer.emplace_back(translation);
-		}
-		else
-		{
-			mModelMatrixContainer[k + offset] = translation;
-		}
-	}
-
-	for (int l = 0; l < mStaticLinearTransformContainer.size(); ++l)
-	{
-		AngularTransform const &angularTransform = mStaticAngularTransformContainer[l];
-
-		if (glm::vec3(angularTransform.angularVelocity) == glm::vec3(0.0f))
-		{
-			mModelMatrixContainer[l + offset] *= glm::mat4(1.0f);
-		}
-		else
-		{
-			mModelMatrixContainer[l + offset] *= glm::mat4_cast(angularTransform.orientation);
-		}
-	}
+	// Every body in the order it was added, static ones included, blended between the last two physics steps
+	//  since the frames don't line up with them
+	mPhysicsWorld.computeInterpolatedTransforms(mModelMatrixContainer);
 }
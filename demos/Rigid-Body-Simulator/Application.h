@@ -65,6 +65,8 @@ private:
 	void initPhysicsWorld(Demo = Demo::CONTROLLABLE_BOX);
 	void initUI();
 
+	// One fixed physics tick, update() runs as many as the frame time calls for
+	void step(float);
 	void updateWithInputs(float);
 
 	void updateModelMatrices();
@@ -112,10 +114,8 @@ private:
 	Demo mDemo = Demo::CONTROLLABLE_BOX;
 
 	// Physics quantities
-	std::vector<LinearTransform> const &mRigidLinearTransformContainer    = mPhysicsWorld.getRigidLinearTransformContainer();
-	std::vector<LinearTransform> const &mStaticLinearTransformContainer   = mPhysicsWorld.getStaticLinearTransformContainer();
-	std::vector<AngularTransform> const &mRigidAngularTransformContainer  = mPhysicsWorld.getRigidAngularTransformContainer();
-	std::vector<AngularTransform> const &mStaticAngularTransformContainer = mPhysicsWorld.getStaticAngularTransformContainer();
+	std::vector<LinearTransform> const &mLinearTransformContainer   = mPhysicsWorld.getLinearTransformContainer();
+	std::vector<AngularTransform> const &mAngularTransformContainer = mPhysicsWorld.getAngularTransformContainer();
 };
 
 #endif // APPLICATION_H
@@ -69,11 +69,6 @@ int main()
 	double UIFrameTimeInterval = frameTimeInterval;
 	int    numFrames           = 0;
 
-	// Semi-fix timestep for physics simulation
-	double lastPhysicsTickTime      = lastTime;
-	double fixedPhysicsTickInterval = 1.0 / 60.0;
-	int physicsTickCount = 0;
-
 	GLuint64 gpuTime = 0;
 	genQueries();
 
@@ -90,13 +85,8 @@ int main()
 		// Start the query and tell OpenGL to use the back buffer to store the result
 		glBeginQuery(GL_TIME_ELAPSED, queryIDs[queryBackBuffer]);
 
-		double realPhysicsTickInterval = currentTime - lastPhysicsTickTime;
-		if (realPhysicsTickInterval >= fixedPhysicsTickInterval || !physicsTickCount)
-		{
-			pApplication->update(float(fixedPhysicsTickInterval));
-			lastPhysicsTickTime = currentTime;
-			++physicsTickCount;
-		}
+		// Fixed timestep for physics simulation, the world runs as many ticks as this frame took
+		pApplication->update(float(frameTimeInterval));
 
 		// End time query and store the result
 		glEndQuery(GL_TIME_ELAPSED);
@@ -289,6 +289,11 @@ void Application::initCpuBuffers()
 				mSsboCpuMem.elementBuffer_B[j] = glm::uvec4(0u);
 			}
 		}
+
+		// Only the part of mesh B that's copied to the SSBO, so both paths test the same triangles
+		mMeshCollider_A.create(positionBuffer_A, elementBuffer_A);
+		mMeshCollider_B.create(std::vector<float>(positionBuffer_B.begin(), positionBuffer_B.begin() + 3 * 4),
+							   std::vector<unsigned int>(elementBuffer_B.begin(), elementBuffer_B.begin() + 3 * 2));
 	}
 
 	// Prep uniform data on the CPU
@@ -521,62 +526,32 @@ void Application::computeOnCpu()
 		printColorSsbo();
 	}
 
-	// TODO: This is just wasting memory. Please fix!
-	glm::mat4 const &model_A = mUboCpuMem.model_A;
-	glm::mat4 const &model_B = mUboCpuMem.model_B;
-	glm::vec4 const (&rPositionBuffer_A)[2763] = mSsboCpuMem.positionBuffer_A;
-	glm::vec4 const (&rPositionBuffer_B)[2763] = mSsboCpuMem.positionBuffer_B;
-	glm::uvec4 const (&rElementBuffer_A)[5522] = mSsboCpuMem.elementBuffer_A;
-	glm::uvec4 const (&rElementBuffer_B)[5522] = mSsboCpuMem.elementBuffer_B;
 	glm::vec4 (&colorBuffer_A)[2763] = mColorOutSsbo.colorBuffer_A;
 	glm::vec4 (&colorBuffer_B)[2763] = mColorOutSsbo.colorBuffer_B;
-	glm::vec3 v0(0.0f), v1(0.0f), v2(0.0f), u0(0.0f), u1(0.0f), u2(0.0f);
-	glm::uvec3 tri_A(0), tri_B(0);
-	bool isColliding = false;
 
-	for (unsigned int elementBufferIdx_B = 0; elementBufferIdx_B < 2; ++elementBufferIdx_B)
+	// Everything starts out not colliding, then only the hit triangles get painted
+	for (int i = 0; i < 2763; ++i)
 	{
-		tri_B = rElementBuffer_B[elementBufferIdx_B].xyz();
-
-		// Prep the vertices: mapping them to world space
-		u0 = (model_B * rPositionBuffer_B[tri_B.x]).xyz();
-		u1 = (model_B * rPositionBuffer_B[tri_B.y]).xyz();
-		u2 = (model_B * rPositionBuffer_B[tri_B.z]).xyz();
-
-		for (unsigned int elementBufferIdx_A = 0; elementBufferIdx_A < 5522; ++elementBufferIdx_A)
-		{
-			tri_A = rElementBuffer_A[elementBufferIdx_A].xyz();
-
-			// Prep the vertices: mapping them to world space
-			v0 = (model_A * rPositionBuffer_A[tri_A.x]).xyz();
-			v1 = (model_A * rPositionBuffer_A[tri_A.y]).xyz();
-			v2 = (model_A * rPositionBuffer_A[tri_A.z]).xyz();
+		colorBuffer_A[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		colorBuffer_B[i] = glm::vec4(2.0f, 0.0f, 0.0f, 1.0f);
+	}
 
-			// Query the test
-			isColliding = fastTriTriIntersect3DTest(v0, v1, v2, u0, u1, u2);
+	// BVH vs BVH, so only triangle pairs with overlapping bounds reach fastTriTriIntersect3DTest
+	std::vector<glm::ivec2> const collidingPairs = P3::findIntersectingTriangles(mMeshCollider_A, mUboCpuMem.model_A,
+																				 mMeshCollider_B, mUboCpuMem.model_B);
 
-			// Output the results to CPU memory
-			if (isColliding)
-			{
-				colorBuffer_A[tri_A.x] = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
-				colorBuffer_A[tri_A.y] = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
-				colorBuffer_A[tri_A.z] = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+	for (glm::ivec2 const &pair : collidingPairs)
+	{
+		glm::uvec3 const &tri_A = mMeshCollider_A.getTriangles()[pair.x];
+		glm::uvec3 const &tri_B = mMeshCollider_B.getTriangles()[pair.y];
 
-				colorBuffer_B[tri_B.x] = glm::vec4(3.0f, 0.0f, 0.0f, 1.0f);
-				colorBuffer_B[tri_B.y] = glm::vec4(3.0f, 0.0f, 0.0f, 1.0f);
-				colorBuffer_B[tri_B.z] = glm::vec4(3.0f, 0.0f, 0.0f, 1.0f);
-			}
-			else
-			{
-				colorBuffer_A[tri_A.x] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-				colorBuffer_A[tri_A.y] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-				colorBuffer_A[tri_A.z] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		colorBuffer_A[tri_A.x] = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+		colorBuffer_A[tri_A.y] = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+		colorBuffer_A[tri_A.z] = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
 
-				colorBuffer_B[tri_B.x] = glm::vec4(2.0f, 0.0f, 0.0f, 1.0f);
-				colorBuffer_B[tri_B.y] = glm::vec4(2.0f, 0.0f, 0.0f, 1.0f);
-				colorBuffer_B[tri_B.z] = glm::vec4(2.0f, 0.0f, 0.0f, 1.0f);
-			}
-		}
+		colorBuffer_B[tri_B.x] = glm::vec4(3.0f, 0.0f, 0.0f, 1.0f);
+		colorBuffer_B[tri_B.y] = glm::vec4(3.0f, 0.0f, 0.0f, 1.0f);
+		colorBuffer_B[tri_B.z] = glm::vec4(3.0f, 0.0f, 0.0f, 1.0f);
 	}
 
 	// Transfer results to GPU buffers
@@ -25,6 +25,8 @@
 #include "Shape.h"
 #include "WindowManager.h"
 
+#include "PrototypePhysicsEngine/P3TriangleMeshCollider.h"
+
 class Application : public EventCallbacks
 {
 public:
@@ -84,6 +86,9 @@ private:
 		glm::vec4 colorBuffer_B[2763];
 	} mColorOutSsbo;
 
+	// Same meshes as the SSBOs above, in model space. Used by computeOnCpu to skip the brute-force pair loop
+	P3::TriangleMeshCollider mMeshCollider_A, mMeshCollider_B;
+
 	WindowManager *mpWindowManager = nullptr;
 	GLuint mVao, mUboGpuID, mSsboGpuID[2];
 
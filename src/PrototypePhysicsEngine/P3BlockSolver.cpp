@@ -0,0 +1,132 @@
+#include "P3BlockSolver.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr int cMaxCount = P3::cMaxBlockContactCount;
+
+// Pivots smaller than this, relative to the biggest diagonal entry, mean the subset is singular
+constexpr float cSingularTolerance = 1e-5f;
+
+// How far below 0 an impulse or a velocity may come out and still count as valid, round-off mostly
+constexpr float cComplementarityTolerance = 1e-5f;
+
+int countBits(int mask)
+{
+	int count = 0;
+	for (; mask; mask &= mask - 1)
+		++count;
+
+	return count;
+}
+
+// Gaussian elimination with partial pivoting, on the rows and columns of the active contacts only
+bool solveActiveSet( P3::NormalBlock const &block, float const (&b)[cMaxCount], int activeMask,
+					 float (&x)[cMaxCount] )
+{
+	int activeIndices[cMaxCount];
+	int activeCount = 0;
+	for (int i = 0; i < block.contactCount; ++i)
+	{
+		if (activeMask & (1 << i))
+			activeIndices[activeCount++] = i;
+	}
+
+	float matrix[cMaxCount][cMaxCount + 1];
+	float scale = 0.0f;
+	for (int row = 0; row < activeCount; ++row)
+	{
+		for (int col = 0; col < activeCount; ++col)
+		{
+			matrix[row][col] = block.inverseEffectiveMass[activeIndices[row]][activeIndices[col]];
+		}
+
+		matrix[row][activeCount] = -b[activeIndices[row]];
+		scale = std::max(scale, matrix[row][row]);
+	}
+
+	for (int col = 0; col < activeCount; ++col)
+	{
+		int pivotRow = col;
+		for (int row = col + 1; row < activeCount; ++row)
+		{
+			if (std::abs(matrix[row][col]) > std::abs(matrix[pivotRow][col]))
+				pivotRow = row;
+		}
+
+		if (std::abs(matrix[pivotRow][col]) <= cSingularTolerance * scale)
+			return false;
+
+		if (pivotRow != col)
+		{
+			for (int k = col; k <= activeCount; ++k)
+				std::swap(matrix[col][k], matrix[pivotRow][k]);
+		}
+
+		for (int row = col + 1; row < activeCount; ++row)
+		{
+			float factor = matrix[row][col] / matrix[col][col];
+			for (int k = col; k <= activeCount; ++k)
+				matrix[row][k] -= factor * matrix[col][k];
+		}
+	}
+
+	float solution[cMaxCount] = {};
+	for (int row = activeCount - 1; row >= 0; --row)
+	{
+		float sum = matrix[row][activeCount];
+		for (int k = row + 1; k < activeCount; ++k)
+			sum -= matrix[row][k] * solution[k];
+
+		solution[row] = sum / matrix[row][row];
+
+		// Active contacts must push
+		if (solution[row] < -cComplementarityTolerance)
+			return false;
+	}
+
+	float candidate[cMaxCount] = {};
+	for (int row = 0; row < activeCount; ++row)
+	{
+		candidate[activeIndices[row]] = std::max(solution[row], 0.0f);
+	}
+
+	// Inactive contacts must not be approaching
+	for (int i = 0; i < block.contactCount; ++i)
+	{
+		if (activeMask & (1 << i))
+			continue;
+
+		float w = b[i];
+		for (int j = 0; j < block.contactCount; ++j)
+			w += block.inverseEffectiveMass[i][j] * candidate[j];
+
+		if (w < -cComplementarityTolerance)
+			return false;
+	}
+
+	std::copy(candidate, candidate + cMaxCount, x);
+	return true;
+}
+}
+
+bool P3::solveNormalBlock( NormalBlock const &block, float const (&b)[cMaxBlockContactCount],
+						   float (&x)[cMaxBlockContactCount] )
+{
+	int fullMask = (1 << block.contactCount) - 1;
+
+	// Resting contacts usually all push, so the biggest sets are the likeliest. The empty set comes last,
+	//  and is valid whenever the bodies are separating at every point.
+	for (int activeCount = block.contactCount; activeCount >= 0; --activeCount)
+	{
+		for (int activeMask = fullMask; activeMask >= 0; --activeMask)
+		{
+			if (countBits(activeMask) == activeCount && solveActiveSet(block, b, activeMask, x))
+				return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,35 @@
+/**
+ * Solves the normal impulses of all the contact points of a manifold at once, instead of one after another.
+ *  Sequential impulses on a box resting on a face see each corner push against the 3 others, so the
+ *  impulses only settle after many iterations and the box rocks in the meantime. Solving them as one small
+ *  LCP gets the final split in a single iteration.
+ *
+ * With x the accumulated impulses, K the effective mass matrix and b the relative normal velocities at x = 0
+ *  minus the bias, find x >= 0 such that w = K x + b >= 0 and x_i w_i = 0. With 4 points or less that is
+ *  done by total enumeration, as in Box2D's 2 point block solver: every subset of active contacts is tried,
+ *  biggest first, until one gives a valid solution.
+ *
+ * 4 points on a face are linearly dependent, a body only has 3 ways to move along the normal there, so the
+ *  full set is singular and a set of 3 usually wins.
+ */
+
+#pragma once
+
+#ifndef P3_BLOCK_SOLVER_H
+#define P3_BLOCK_SOLVER_H
+
+namespace P3
+{
+constexpr int cMaxBlockContactCount = 4;
+
+struct NormalBlock
+{
+	float inverseEffectiveMass[cMaxBlockContactCount][cMaxBlockContactCount]; // K = J M^-1 J^T, symmetric
+	int contactCount;
+};
+
+// Returns false if no subset gives a valid solution, in which case x is left untouched
+bool solveNormalBlock(NormalBlock const &, float const (&b)[cMaxBlockContactCount], float (&x)[cMaxBlockContactCount]);
+}
+
+#endif // P3_BLOCK_SOLVER_H
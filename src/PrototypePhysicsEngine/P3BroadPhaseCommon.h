@@ -3,6 +3,8 @@
 #ifndef P3_BROAD_PHASE_COMMON
 #define P3_BROAD_PHASE_COMMON
 
+#include <vector>
+
 #include "P3Common.h"
 
 struct Aabb
@@ -22,17 +24,54 @@ struct AabbGpuPackage
 	glm::vec4 maxCoords[cMaxObjectCount]{};
 };
 
-// This potentially can store the size of the boxColliders, to solve the potential
-//  padding issue, the size can be padded to 16 bytes, or just use a glm::vec4
+// The vertices of every box collider, cBoxColliderVertCount per box. Grows to the most boxes so far and is never
+//  shrunk, the box count is in misc.
 struct BoxColliderGpuPackage
 {
-	glm::vec4 const *operator[](int boxIdx) const { return boxColliders[boxIdx]; }
+	glm::vec4 const *operator[](int boxIdx) const { return vertices.data() + boxIdx * cBoxColliderVertCount; }
+	glm::vec4 *operator[](int boxIdx) { return vertices.data() + boxIdx * cBoxColliderVertCount; }
+
+	void resize(int boxCount)
+	{
+		if (static_cast<int>(vertices.size()) < boxCount * cBoxColliderVertCount)
+			vertices.resize(boxCount * cBoxColliderVertCount);
+
+		misc.x = boxCount;
+	}
+
+	glm::ivec4 misc{}; // x = box count
+	std::vector<glm::vec4> vertices;
+};
+
+// Each pair once, the higher box index in x. Grows like the box colliders.
+struct CollisionPairGpuPackage
+{
+	glm::ivec4 const &operator[](int pairIdx) const { return collisionPairs[pairIdx]; }
+	glm::ivec4 &operator[](int pairIdx) { return collisionPairs[pairIdx]; }
 
+	void clear() { misc = glm::ivec4(0); }
+
+	void add(int boxAIdx, int boxBIdx)
+	{
+		if (static_cast<int>(collisionPairs.size()) == misc.x)
+			collisionPairs.resize(misc.x + 1);
+
+		collisionPairs[misc.x++] = glm::ivec4(boxAIdx, boxBIdx, 0, 0);
+	}
+
+	glm::ivec4 misc{}; // x = pair count, y = pairs dropped because they didn't fit
+	std::vector<glm::ivec4> collisionPairs;
+};
+
+// The layouts the broad phase shaders work on. The buffers are mapped as is, so they keep a fixed size. The OpenGL
+//  backend copies the pairs to a CollisionPairGpuPackage for the rest of the world.
+struct BoxColliderGpuBuffer
+{
 	glm::ivec4 misc{};
 	glm::vec4 boxColliders[cMaxObjectCount][cBoxColliderVertCount]{};
 };
 
-struct CollisionPairGpuPackage
+struct CollisionPairGpuBuffer
 {
 	glm::ivec4 const &operator[](int boxIdx) const { return collisionPairs[boxIdx]; }
 	glm::ivec4 &operator[](int boxIdx) { return collisionPairs[boxIdx]; }
@@ -0,0 +1,218 @@
+#include "P3Bvh.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace
+{
+Aabb emptyAabb()
+{
+	return Aabb(glm::vec4(std::numeric_limits<float>::max()), glm::vec4(std::numeric_limits<float>::lowest()));
+}
+
+void grow(Aabb &aabb, Aabb const &other)
+{
+	aabb.mMinCoord = glm::min(aabb.mMinCoord, other.mMinCoord);
+	aabb.mMaxCoord = glm::max(aabb.mMaxCoord, other.mMaxCoord);
+}
+
+}
+
+namespace P3
+{
+Aabb transformAabb(Aabb const &aabb, glm::mat4 const &transform)
+{
+	glm::vec3 minCoord(transform[3]);
+	glm::vec3 maxCoord(transform[3]);
+
+	for (int col = 0; col < 3; ++col)
+	{
+		for (int row = 0; row < 3; ++row)
+		{
+			float a = transform[col][row] * aabb.mMinCoord[col];
+			float b = transform[col][row] * aabb.mMaxCoord[col];
+
+			minCoord[row] += std::min(a, b);
+			maxCoord[row] += std::max(a, b);
+		}
+	}
+
+	return Aabb(glm::vec4(minCoord, 1.0f), glm::vec4(maxCoord, 1.0f));
+}
+
+void Bvh::build(std::vector<Aabb> const &primitiveAabbs)
+{
+	int primitiveCount = static_cast<int>(primitiveAabbs.size());
+
+	mNodes.clear();
+	mPrimitiveAabbs = primitiveAabbs;
+	mPrimitiveIndices.resize(primitiveCount);
+	mPrimitiveCentroids.resize(primitiveCount);
+
+	std::iota(mPrimitiveIndices.begin(), mPrimitiveIndices.end(), 0);
+
+	for (int i = 0; i < primitiveCount; ++i)
+	{
+		mPrimitiveCentroids[i] = 0.5f * (glm::vec3(primitiveAabbs[i].mMinCoord) + glm::vec3(primitiveAabbs[i].mMaxCoord));
+	}
+
+	if (!primitiveCount) return;
+
+	// A binary tree with at least one primitive per leaf never has more than 2n - 1 nodes
+	mNodes.reserve(2 * primitiveCount);
+	mNodes.emplace_back();
+	mNodes[0].leftOrFirst = 0;
+	mNodes[0].count = primitiveCount;
+	updateNodeBounds(0);
+
+	// Explicit stack of (node, depth), so a pathological mesh can't blow the call stack. The depth
+	//  cap is what keeps the fixed size traversal stacks in query() safe.
+	std::vector<std::pair<int, int>> buildStack;
+	buildStack.emplace_back(0, 0);
+
+	while (!buildStack.empty())
+	{
+		int nodeIdx = buildStack.back().first;
+		int depth   = buildStack.back().second;
+		buildStack.pop_back();
+
+		if (depth < cBvhMaxStackDepth - 2 && subdivide(nodeIdx))
+		{
+			buildStack.emplace_back(mNodes[nodeIdx].leftOrFirst + 1, depth + 1);
+			buildStack.emplace_back(mNodes[nodeIdx].leftOrFirst, depth + 1);
+		}
+	}
+}
+
+void Bvh::updateNodeBounds(int nodeIdx)
+{
+	BvhNode &node = mNodes[nodeIdx];
+	node.bounds = emptyAabb();
+
+	for (int i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+	{
+		grow(node.bounds, mPrimitiveAabbs[mPrimitiveIndices[i]]);
+	}
+}
+
+// Binned SAH. Returns the cost of the best split, or max float if the centroids can't be split at all.
+float Bvh::findBestSplit(BvhNode const &node, int &bestAxis, float &bestSplitPos) const
+{
+	struct Bin
+	{
+		Aabb bounds = emptyAabb();
+		int count = 0;
+	};
+
+	float bestCost = std::numeric_limits<float>::max();
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float minCentroid = std::numeric_limits<float>::max();
+		float maxCentroid = std::numeric_limits<float>::lowest();
+
+		for (int i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+		{
+			float centroid = mPrimitiveCentroids[mPrimitiveIndices[i]][axis];
+			minCentroid = std::min(minCentroid, centroid);
+			maxCentroid = std::max(maxCentroid, centroid);
+		}
+
+		if (minCentroid == maxCentroid) continue;
+
+		Bin bins[cBvhBinCount];
+		float scale = cBvhBinCount / (maxCentroid - minCentroid);
+
+		for (int i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+		{
+			int primitiveIdx = mPrimitiveIndices[i];
+			int binIdx = std::min(cBvhBinCount - 1, int((mPrimitiveCentroids[primitiveIdx][axis] - minCentroid) * scale));
+
+			++bins[binIdx].count;
+			grow(bins[binIdx].bounds, mPrimitiveAabbs[primitiveIdx]);
+		}
+
+		// Sweep from both ends to get the area and count on each side of every bin plane
+		float leftAreas[cBvhBinCount - 1], rightAreas[cBvhBinCount - 1];
+		int leftCounts[cBvhBinCount - 1], rightCounts[cBvhBinCount - 1];
+		Aabb leftBounds  = emptyAabb();
+		Aabb rightBounds = emptyAabb();
+		int leftSum = 0, rightSum = 0;
+
+		for (int i = 0; i < cBvhBinCount - 1; ++i)
+		{
+			leftSum += bins[i].count;
+			grow(leftBounds, bins[i].bounds);
+			leftCounts[i] = leftSum;
+			leftAreas[i]  = getSurfaceArea(leftBounds);
+
+			rightSum += bins[cBvhBinCount - 1 - i].count;
+			grow(rightBounds, bins[cBvhBinCount - 1 - i].bounds);
+			rightCounts[cBvhBinCount - 2 - i] = rightSum;
+			rightAreas[cBvhBinCount - 2 - i]  = getSurfaceArea(rightBounds);
+		}
+
+		for (int i = 0; i < cBvhBinCount - 1; ++i)
+		{
+			if (!leftCounts[i] || !rightCounts[i]) continue;
+
+			float cost = leftCounts[i] * leftAreas[i] + rightCounts[i] * rightAreas[i];
+
+			if (cost < bestCost)
+			{
+				bestCost     = cost;
+				bestAxis     = axis;
+				bestSplitPos = minCentroid + (i + 1) / scale;
+			}
+		}
+	}
+
+	return bestCost;
+}
+
+// @return: true if the node got split into 2 children
+bool Bvh::subdivide(int nodeIdx)
+{
+	BvhNode node = mNodes[nodeIdx]; // Copy, mNodes grows below
+
+	if (node.count <= cBvhMaxLeafSize) return false;
+
+	int axis = -1;
+	float splitPos = 0.0f;
+	float splitCost = findBestSplit(node, axis, splitPos);
+
+	if (axis < 0) return false;
+
+	// Big nodes always get split, SAH only decides whether a small node is worth splitting.
+	if (node.count <= 4 * cBvhMaxLeafSize && splitCost >= node.count * getSurfaceArea(node.bounds)) return false;
+
+	int *pFirst = mPrimitiveIndices.data() + node.leftOrFirst;
+	int *pMiddle = std::partition(pFirst, pFirst + node.count, [&](int primitiveIdx)
+		{
+			return mPrimitiveCentroids[primitiveIdx][axis] < splitPos;
+		}
+	);
+
+	int leftCount = static_cast<int>(pMiddle - pFirst);
+	if (!leftCount || leftCount == node.count) return false;
+
+	int leftIdx = static_cast<int>(mNodes.size());
+	mNodes.emplace_back();
+	mNodes.emplace_back();
+
+	mNodes[leftIdx].leftOrFirst     = node.leftOrFirst;
+	mNodes[leftIdx].count           = leftCount;
+	mNodes[leftIdx + 1].leftOrFirst = node.leftOrFirst + leftCount;
+	mNodes[leftIdx + 1].count       = node.count - leftCount;
+
+	mNodes[nodeIdx].leftOrFirst = leftIdx;
+	mNodes[nodeIdx].count       = 0;
+
+	updateNodeBounds(leftIdx);
+	updateNodeBounds(leftIdx + 1);
+
+	return true;
+}
+}
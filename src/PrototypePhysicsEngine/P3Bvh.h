@@ -0,0 +1,178 @@
+/**
+ * Bounding volume hierarchy over a set of primitive Aabbs, built on the CPU with
+ *  the surface area heuristic (binned). Mainly used as the midphase of static
+ *  triangle meshes, so a moving body only looks at the triangles it overlaps.
+ *
+ * Nodes are stored flat. An interior node stores the index of its left child,
+ *  the right child is always right next to it. A leaf stores the offset into
+ *  the reordered primitive index list and the number of primitives.
+ *
+ * @reference: Ingo Wald, "On fast Construction of SAH-based Bounding Volume Hierarchies"
+ *             https://www.sci.utah.edu/~wald/Publications/2007/ParallelBVHBuild/fastbuild.pdf
+ */
+
+#pragma once
+
+#ifndef P3_BVH_H
+#define P3_BVH_H
+
+#include <glm/mat4x4.hpp>
+#include <vector>
+
+#include "P3BroadPhaseCommon.h"
+
+inline bool overlaps(Aabb const &a, Aabb const &b)
+{
+	return a.mMinCoord.x <= b.mMaxCoord.x && a.mMaxCoord.x >= b.mMinCoord.x
+		&& a.mMinCoord.y <= b.mMaxCoord.y && a.mMaxCoord.y >= b.mMinCoord.y
+		&& a.mMinCoord.z <= b.mMaxCoord.z && a.mMaxCoord.z >= b.mMinCoord.z;
+}
+
+namespace P3
+{
+constexpr int cBvhMaxLeafSize   = 4;
+constexpr int cBvhBinCount      = 12;
+constexpr int cBvhMaxStackDepth = 64; // Build never goes deeper than this, so traversal stacks can't overflow
+
+struct BvhNode
+{
+	Aabb bounds;
+	int leftOrFirst = 0; // Left child index if interior, first primitive index if leaf
+	int count = 0;       // Zero for interior nodes
+
+	bool isLeaf() const { return count > 0; }
+};
+
+// Aabb of a transformed Aabb, without transforming all 8 corners
+// @reference: Jim Arvo, "Transforming Axis-Aligned Bounding Boxes", Graphics Gems
+Aabb transformAabb(Aabb const &, glm::mat4 const &);
+
+inline float getSurfaceArea(Aabb const &aabb)
+{
+	glm::vec3 extent = glm::vec3(aabb.mMaxCoord) - glm::vec3(aabb.mMinCoord);
+
+	if (extent.x < 0.0f || extent.y < 0.0f || extent.z < 0.0f) return 0.0f;
+
+	return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+class Bvh
+{
+public:
+	void build(std::vector<Aabb> const &);
+
+	// Invoke func(primitiveIdx) for every primitive whose Aabb overlaps the query box
+	template<typename Func>
+	void query(Aabb const &queryAabb, Func &&func) const
+	{
+		if (mNodes.empty()) return;
+
+		int stack[cBvhMaxStackDepth];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize)
+		{
+			BvhNode const &node = mNodes[stack[--stackSize]];
+
+			if (!overlaps(node.bounds, queryAabb)) continue;
+
+			if (node.isLeaf())
+			{
+				for (int i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+				{
+					if (overlaps(mPrimitiveAabbs[mPrimitiveIndices[i]], queryAabb))
+						func(mPrimitiveIndices[i]);
+				}
+			}
+			else
+			{
+				stack[stackSize++] = node.leftOrFirst + 1;
+				stack[stackSize++] = node.leftOrFirst;
+			}
+		}
+	}
+
+	Aabb const &getBounds() const { return mNodes.front().bounds; }
+	std::vector<BvhNode> const &getNodes() const { return mNodes; }
+	std::vector<int> const &getPrimitiveIndices() const { return mPrimitiveIndices; }
+	std::vector<Aabb> const &getPrimitiveAabbs() const { return mPrimitiveAabbs; }
+	bool isEmpty() const { return mNodes.empty(); }
+
+private:
+	void updateNodeBounds(int);
+	float findBestSplit(BvhNode const &, int &, float &) const;
+	bool subdivide(int);
+
+	std::vector<BvhNode> mNodes;
+	std::vector<int> mPrimitiveIndices;
+	std::vector<Aabb> mPrimitiveAabbs;
+	std::vector<glm::vec3> mPrimitiveCentroids;
+};
+
+// Descend 2 BVHs together from the node pair (nodeIdxA, nodeIdxB), with B placed in the space of A by bToA.
+//  Invoke func(primitiveIdxA, primitiveIdxB) for every pair of primitives whose Aabbs overlap.
+template<typename Func>
+void queryPairs(Bvh const &bvhA, Bvh const &bvhB, glm::mat4 const &bToA, int nodeIdxA, int nodeIdxB, Func &&func)
+{
+	std::vector<BvhNode> const &nodesA = bvhA.getNodes();
+	std::vector<BvhNode> const &nodesB = bvhB.getNodes();
+
+	// Each BVH is at most cBvhMaxStackDepth deep, so the pair tree is at most twice as deep
+	int stack[2 * cBvhMaxStackDepth][2];
+	int stackSize = 0;
+	stack[stackSize][0] = nodeIdxA;
+	stack[stackSize][1] = nodeIdxB;
+	++stackSize;
+
+	while (stackSize)
+	{
+		--stackSize;
+		int currentNodeIdxA = stack[stackSize][0];
+		int currentNodeIdxB = stack[stackSize][1];
+		BvhNode const &nodeA = nodesA[currentNodeIdxA];
+		BvhNode const &nodeB = nodesB[currentNodeIdxB];
+		Aabb boundsB = transformAabb(nodeB.bounds, bToA);
+
+		if (!overlaps(nodeA.bounds, boundsB)) continue;
+
+		if (nodeA.isLeaf() && nodeB.isLeaf())
+		{
+			for (int j = nodeB.leftOrFirst; j < nodeB.leftOrFirst + nodeB.count; ++j)
+			{
+				int primitiveIdxB = bvhB.getPrimitiveIndices()[j];
+				Aabb primitiveBoundsB = transformAabb(bvhB.getPrimitiveAabbs()[primitiveIdxB], bToA);
+
+				for (int i = nodeA.leftOrFirst; i < nodeA.leftOrFirst + nodeA.count; ++i)
+				{
+					int primitiveIdxA = bvhA.getPrimitiveIndices()[i];
+
+					if (overlaps(bvhA.getPrimitiveAabbs()[primitiveIdxA], primitiveBoundsB))
+						func(primitiveIdxA, primitiveIdxB);
+				}
+			}
+		}
+		// Descend into the bigger node first, so both sides shrink at the same rate
+		else if (nodeB.isLeaf() || (!nodeA.isLeaf() && getSurfaceArea(nodeA.bounds) >= getSurfaceArea(boundsB)))
+		{
+			stack[stackSize][0] = nodeA.leftOrFirst + 1;
+			stack[stackSize][1] = currentNodeIdxB;
+			++stackSize;
+			stack[stackSize][0] = nodeA.leftOrFirst;
+			stack[stackSize][1] = currentNodeIdxB;
+			++stackSize;
+		}
+		else
+		{
+			stack[stackSize][0] = currentNodeIdxA;
+			stack[stackSize][1] = nodeB.leftOrFirst + 1;
+			++stackSize;
+			stack[stackSize][0] = currentNodeIdxA;
+			stack[stackSize][1] = nodeB.leftOrFirst;
+			++stackSize;
+		}
+	}
+}
+}
+
+#endif // P3_BVH_H
@@ -0,0 +1,73 @@
+#include "P3Ccd.h"
+
+#include <glm/glm.hpp>
+#include <limits>
+
+#include "P3Gjk.h"
+
+namespace P3
+{
+float computeTimeOfImpact( P3Collider const &movingCollider, glm::vec3 const &displacement, P3Collider const &staticCollider,
+						   glm::vec3 *pHitNormal )
+{
+	float timeOfImpact = 0.0f;
+	glm::vec3 separatingAxis(0.0f);
+
+	for (int i = 0; i < cCcdMaxIterations; ++i)
+	{
+		float distance = P3GjkDistance(TranslatedSupport(movingCollider, timeOfImpact * displacement), staticCollider, separatingAxis);
+
+		if (distance <= cCcdTolerance)
+		{
+			if (timeOfImpact <= 0.0f)
+				return 1.0f;
+
+			if (pHitNormal) *pHitNormal = separatingAxis;
+			return timeOfImpact;
+		}
+
+		// How much the gap closes over the whole displacement, moving away or sliding along never hits
+		float closingDistance = glm::dot(displacement, separatingAxis);
+		if (closingDistance <= 0.0f)
+			return 1.0f;
+
+		timeOfImpact += distance / closingDistance;
+		if (timeOfImpact >= 1.0f)
+			return 1.0f;
+	}
+
+	// Didn't converge, still a safe place to stop since every advance was conservative
+	if (pHitNormal) *pHitNormal = separatingAxis;
+	return timeOfImpact;
+}
+
+glm::vec3 BoxSupport::findFarthestPoint(glm::vec3 const &direction) const
+{
+	glm::vec3 maxPoint{ 0.0f };
+	float maxProjectedDistance = std::numeric_limits<float>::lowest();
+
+	for (int i = 0; i < cBoxColliderVertCount; ++i)
+	{
+		glm::vec3 vert = glm::vec3(mBoxCollider[i]);
+		float projectedDistance = glm::dot(vert, direction);
+
+		if (projectedDistance > maxProjectedDistance)
+		{
+			maxProjectedDistance = projectedDistance;
+			maxPoint = vert;
+		}
+	}
+
+	return maxPoint;
+}
+
+glm::vec3 TriangleSupport::findFarthestPoint(glm::vec3 const &direction) const
+{
+	float d0 = glm::dot(mVertices[0], direction);
+	float d1 = glm::dot(mVertices[1], direction);
+	float d2 = glm::dot(mVertices[2], direction);
+
+	if (d0 >= d1 && d0 >= d2) return mVertices[0];
+	return d1 >= d2 ? mVertices[1] : mVertices[2];
+}
+}
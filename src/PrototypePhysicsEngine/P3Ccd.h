@@ -0,0 +1,75 @@
+/**
+ * Continuous collision detection for fast bodies that opted in. The time of impact is found by
+ *  conservative advancement: GJK gives the distance and the separating axis, and nothing on the
+ *  sweep can close that gap faster than the displacement projected onto the axis. So the body can
+ *  safely advance by distance / closing speed, then repeat until the gap is within tolerance.
+ *
+ * Only translation is swept. The orientation at the start of the step is kept for the whole sweep,
+ *  which is fine for projectiles but not for fast spinning bodies. A collider that moves too is
+ *  swept in the frame of the moving one, with the relative displacement.
+ *
+ * Reference: Brian Mirtich, "Impulse-based Dynamic Simulation of Rigid Body Systems", ch 2.3
+ */
+
+#pragma once
+
+#ifndef P3_CCD_H
+#define P3_CCD_H
+
+#include <glm/vec3.hpp>
+
+#include "P3Collider.h"
+
+namespace P3
+{
+constexpr float cCcdTolerance = 0.005f; // Gap at which the sweep counts as a hit
+constexpr int cCcdMaxIterations = 20;
+
+// Fraction of the displacement the moving collider can travel before touching the static one,
+//  1 if it never does. Colliders that already overlap at the start are left to the discrete solver.
+//  On a hit, the normal is set to the direction from the moving collider to the static one.
+float computeTimeOfImpact(P3Collider const &, glm::vec3 const &, P3Collider const &, glm::vec3 *pHitNormal = nullptr);
+
+// A collider moved by some translation, e.g. partway through its sweep
+class TranslatedSupport : public P3Collider
+{
+public:
+	TranslatedSupport(P3Collider const &collider, glm::vec3 const &translation)
+		: mCollider(collider), mTranslation(translation) {}
+
+	glm::vec3 findFarthestPoint(glm::vec3 const &direction) const override
+	{
+		return mCollider.findFarthestPoint(direction) + mTranslation;
+	}
+
+private:
+	P3Collider const &mCollider;
+	glm::vec3 mTranslation;
+};
+
+// Lets the GJK see a box collider
+class BoxSupport : public P3Collider
+{
+public:
+	BoxSupport(P3BoxCollider const &boxCollider) : mBoxCollider(boxCollider) {}
+
+	glm::vec3 findFarthestPoint(glm::vec3 const &) const override;
+
+private:
+	P3BoxCollider const &mBoxCollider;
+};
+
+// Lets the GJK see a single triangle of a static mesh
+class TriangleSupport : public P3Collider
+{
+public:
+	TriangleSupport(glm::vec3 const &v0, glm::vec3 const &v1, glm::vec3 const &v2) : mVertices{ v0, v1, v2 } {}
+
+	glm::vec3 findFarthestPoint(glm::vec3 const &) const override;
+
+private:
+	glm::vec3 mVertices[3];
+};
+}
+
+#endif // P3_CCD_H
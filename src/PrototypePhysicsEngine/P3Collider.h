@@ -46,6 +46,12 @@ public:
 		mInstanceVertices = vertices;
 	}
 
+	// The 8 vertices of a box, copied over the ones there are, so nothing is allocated
+	void setInstanceVertices(glm::vec4 const *vertices)
+	{
+		mInstanceVertices.assign(vertices, vertices + cBoxColliderVertCount);
+	}
+
 	glm::vec3 findFarthestPoint(glm::vec3 const &) const override;
 
 private:
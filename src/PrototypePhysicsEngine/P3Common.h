@@ -7,8 +7,26 @@
 
 constexpr int cBoxColliderFaceCount = 6;
 constexpr int cBoxColliderVertCount = 8;
-constexpr int cMaxContactPointCount = 16;
+constexpr int cMaxContactPointCount = 16; // Found by clipping, before the reduction
+constexpr int cMaxManifoldContactCount = 4; // Kept per manifold after it
 constexpr int cMaxColliderCount = 1024;
 constexpr int cMaxObjectCount = 1024;
 
+// Every body lives in the same index space. These tell the ones the solver must not move, whatever their mass.
+//  Kinematic bodies are moved by the application instead.
+constexpr unsigned int cStaticBodyFlag    = 1u << 0;
+constexpr unsigned int cKinematicBodyFlag = 1u << 1;
+
+inline bool isDynamicBody(unsigned int flags) { return (flags & (cStaticBodyFlag | cKinematicBodyFlag)) == 0u; }
+
+namespace P3
+{
+// How many times the contact solvers may go over the contacts within a step
+struct IterationBounds
+{
+	int minIterationCount;
+	int maxIterationCount;
+};
+}
+
 #endif // P3_COMMON_H
@@ -1,12 +1,45 @@
 #include "P3ConstraintSolver.h"
 
+#include <algorithm>
+#include <cmath>
+
+#include "P3BlockSolver.h"
 #include "P3Collider.h"
 #include "P3NarrowPhaseCommon.h"
 #include "P3Transform.h"
 
 constexpr float cBaumgarteFactor = 0.1f;
 constexpr float cPenetrationSlop = 0.005f;
-constexpr int cIterationCount = 100;
+constexpr float cBlockSoftness = 1e-3f;
+constexpr float cSplitImpulseFactor = 0.2f; // Can push harder than Baumgarte, the push doesn't stay in the velocities
+constexpr int cManifoldsPerTask = 32; // Colors smaller than this are solved on the calling thread alone
+constexpr int cWideBatchesPerTask = cManifoldsPerTask / P3::cWideContactLaneCount;
+
+// Precalculate J M^-1 JT for contact and friction constraint
+void computeContactMasses( Manifold const &manifold, P3::SolverBody const &referenceBody, P3::SolverBody const &incidentBody,
+						   Contact &contact )
+{
+	glm::vec3 referenceRelativePosCrossNormal = glm::cross(glm::vec3(contact.referenceRelativePosition), glm::vec3(manifold.contactNormal));
+	glm::vec3 incidentRelativePosCrossNormal  = glm::cross(glm::vec3(contact.incidentRelativePosition), glm::vec3(manifold.contactNormal));
+
+	float normalTotalInverseMass  = referenceBody.inverseMass + incidentBody.inverseMass;
+	float tangentInverseMasses[2] = { normalTotalInverseMass, normalTotalInverseMass };
+
+	normalTotalInverseMass += glm::dot(referenceRelativePosCrossNormal, referenceBody.worldInverseInertia * referenceRelativePosCrossNormal)
+		+ glm::dot(incidentRelativePosCrossNormal, incidentBody.worldInverseInertia * incidentRelativePosCrossNormal);
+
+	contact.normalTangentMassesBias.x = 1.0f / normalTotalInverseMass;
+
+	// Compute the inverse masses in the 2 tangent components
+	for (int j = 0; j < 2; ++j)
+	{
+		glm::vec3 referenceRelativePosCrossTangent = glm::cross(glm::vec3(manifold.contactTangents[j]), glm::vec3(contact.referenceRelativePosition));
+		glm::vec3 incidentRelativePosCrossTangent  = glm::cross(glm::vec3(manifold.contactTangents[j]), glm::vec3(contact.incidentRelativePosition));
+		tangentInverseMasses[j] += glm::dot(referenceRelativePosCrossTangent, referenceBody.worldInverseInertia * referenceRelativePosCrossTangent)
+			+ glm::dot(incidentRelativePosCrossTangent, incidentBody.worldInverseInertia * incidentRelativePosCrossTangent);
+		contact.normalTangentMassesBias[j + 1] = 1.0f / tangentInverseMasses[j];
+	}
+}
 
 // http://box2d.org/2014/02/computing-a-basis/
 void computeBasis(const glm::vec4 &a, glm::vec4 &b, glm::vec4 &c)
@@ -33,192 +66,1098 @@ void computeBasis(const glm::vec4 &a, glm::vec4 &b, glm::vec4 &c)
 	c = glm::vec4(cVec3, 0.0f);
 }
 
-// Heavily inspired by qu3e physics engine by Randy Gaul
-void P3ConstraintSolver::preSolve( ManifoldGpuPackage &manifoldPkg,
-								   std::vector<LinearTransform> &rigidLinearTransformContainer,
-								   std::vector<AngularTransform> &rigidAngularTransformContainer,
-								   std::vector<LinearTransform> &staticLinearTransformContainer,
-								   std::vector<AngularTransform> &staticAngularTransformContainer,
-								   float dt )
+// K = J M^-1 J^T for the normal constraints of all the contact points of the manifold
+void computeNormalBlock( Manifold const &manifold, Contact const *contacts,
+						 P3::SolverBody const &referenceBody, P3::SolverBody const &incidentBody, P3::NormalBlock &block )
 {
-	// Then solve contact constraints - Iterate through all manifolds
-	for (int i = 0; i < manifoldPkg.misc.x; ++i)
+	glm::vec3 normal = manifold.contactNormal;
+
+	glm::vec3 referenceRelativePosCrossNormals[P3::cMaxBlockContactCount];
+	glm::vec3 incidentRelativePosCrossNormals[P3::cMaxBlockContactCount];
+
+	block.contactCount = manifold.contactBoxIndicesAndContactCount.z;
+	for (int i = 0; i < block.contactCount; ++i)
+	{
+		referenceRelativePosCrossNormals[i] = glm::cross(glm::vec3(contacts[i].referenceRelativePosition), normal);
+		incidentRelativePosCrossNormals[i]  = glm::cross(glm::vec3(contacts[i].incidentRelativePosition), normal);
+	}
+
+	for (int i = 0; i < block.contactCount; ++i)
+	{
+		for (int j = i; j < block.contactCount; ++j)
+		{
+			block.inverseEffectiveMass[i][j] = referenceBody.inverseMass + incidentBody.inverseMass
+				+ glm::dot(referenceRelativePosCrossNormals[i], referenceBody.worldInverseInertia * referenceRelativePosCrossNormals[j])
+				+ glm::dot(incidentRelativePosCrossNormals[i], incidentBody.worldInverseInertia * incidentRelativePosCrossNormals[j]);
+			block.inverseEffectiveMass[j][i] = block.inverseEffectiveMass[i][j];
+		}
+	}
+
+	// 4 points on a face are linearly dependent, and the way the impulses split between them is then not unique.
+	//  A little softness on the diagonal picks one smoothly, instead of jumping between the valid splits.
+	float maxDiagonal = 0.0f;
+	for (int i = 0; i < block.contactCount; ++i)
+	{
+		maxDiagonal = std::max(maxDiagonal, block.inverseEffectiveMass[i][i]);
+	}
+
+	for (int i = 0; i < block.contactCount; ++i)
+	{
+		block.inverseEffectiveMass[i][i] += cBlockSoftness * maxDiagonal;
+	}
+}
+
+// Returns false if the block has no valid solution, the impulses and velocities are then left as they were
+bool solveNormalImpulsesAsBlock( Manifold const &manifold, Contact *contacts, P3::NormalBlock const &block,
+								 P3::SolverBody const &referenceBody, P3::SolverBody const &incidentBody,
+								 glm::vec3 &vA, glm::vec3 &wA, glm::vec3 &vB, glm::vec3 &wB, float &residual )
+{
+	glm::vec3 normal = manifold.contactNormal;
+
+	float oldNormalImpulses[P3::cMaxBlockContactCount];
+	float normalImpulses[P3::cMaxBlockContactCount];
+	float b[P3::cMaxBlockContactCount];
+
+	for (int i = 0; i < block.contactCount; ++i)
+	{
+		Contact const &contact = contacts[i];
+
+		glm::vec3 dv = vB + glm::cross(wB, glm::vec3(contact.incidentRelativePosition)) - vA
+					 - glm::cross(wA, glm::vec3(contact.referenceRelativePosition));
+
+		oldNormalImpulses[i] = normalImpulses[i] = contact.normalTangentBiasImpulses.x;
+		b[i] = glm::dot(dv, normal) - contact.normalTangentMassesBias.w;
+	}
+
+	// The LCP is on the total impulses, so take out what the accumulated ones already did to the velocities
+	for (int i = 0; i < block.contactCount; ++i)
+	{
+		for (int j = 0; j < block.contactCount; ++j)
+		{
+			b[i] -= block.inverseEffectiveMass[i][j] * oldNormalImpulses[j];
+		}
+	}
+
+	if (!P3::solveNormalBlock(block, b, normalImpulses))
+		return false;
+
+	for (int i = 0; i < block.contactCount; ++i)
 	{
-		Manifold &manifold  = manifoldPkg.manifolds[i];
+		Contact &contact = contacts[i];
 
-		if (manifold.frictionRestitution.x <= 0.0f)
-			manifold.frictionRestitution.x = 1.0f;
+		float lambda = normalImpulses[i] - oldNormalImpulses[i];
+		contact.normalTangentBiasImpulses.x = normalImpulses[i];
+		residual = std::max(residual, std::abs(lambda));
 
-		if (manifold.frictionRestitution.y <= 0.0f)
-			manifold.frictionRestitution.y = 0.05f;
+		glm::vec3 normalImpulse = normal * lambda;
+		vA -= normalImpulse * referenceBody.inverseMass;
+		wA -= referenceBody.worldInverseInertia * glm::cross(glm::vec3(contact.referenceRelativePosition), normalImpulse);
+
+		vB += normalImpulse * incidentBody.inverseMass;
+		wB += incidentBody.worldInverseInertia * glm::cross(glm::vec3(contact.incidentRelativePosition), normalImpulse);
+	}
+
+	return true;
+}
+
+Contact *P3ConstraintSolver::getContacts(Manifold const &manifold) const
+{
+	return mpManifoldPkg->getContacts(manifold);
+}
 
-		int referenceBoxIdx = manifold.contactBoxIndicesAndContactCount.x;
-		int incidentBoxIdx  = manifold.contactBoxIndicesAndContactCount.y;
+void P3ConstraintSolver::solve( ManifoldGpuPackage &manifoldPkg,
+								std::vector<LinearTransform> &linearTransformContainer,
+								std::vector<AngularTransform> &angularTransformContainer,
+								float dt )
+{
+	preSolve(manifoldPkg, linearTransformContainer, angularTransformContainer, dt);
+	iterativeSolve(manifoldPkg, linearTransformContainer, angularTransformContainer);
+}
 
-		LinearTransform &referenceLinearTransform   = getLinearTransform(referenceBoxIdx, rigidLinearTransformContainer, staticLinearTransformContainer);
-		AngularTransform &referenceAngularTransform = getAngularTransform(referenceBoxIdx, rigidAngularTransformContainer, staticAngularTransformContainer);
+// Heavily inspired by qu3e physics engine by Randy Gaul
+void P3ConstraintSolver::preSolve( ManifoldGpuPackage &manifoldPkg,
+								   std::vector<LinearTransform> &linearTransformContainer,
+								   std::vector<AngularTransform> &angularTransformContainer,
+								   float dt )
+{
+	gatherSolverBodies(linearTransformContainer, angularTransformContainer);
+	mpManifoldPkg = &manifoldPkg;
+	mDt = dt;
 
-		LinearTransform &incidentLinearTransform   = getLinearTransform(incidentBoxIdx, rigidLinearTransformContainer, staticLinearTransformContainer);
-		AngularTransform &incidentAngularTransform = getAngularTransform(incidentBoxIdx, rigidAngularTransformContainer, staticAngularTransformContainer);
+	if (mIsBlockSolveEnabled)
+		mNormalBlocks.resize(manifoldPkg.misc.x);
 
-		// Compute the basis
-		computeBasis(manifold.contactNormal, manifold.contactTangents[0], manifold.contactTangents[1]);
+	if (isSubstepping())
+		mSubstepContacts.resize(manifoldPkg.misc.x);
 
-		glm::vec3 vA = referenceLinearTransform.velocity;
-		glm::vec3 wA = referenceAngularTransform.angularVelocity;
-		glm::vec3 vB = incidentLinearTransform.velocity;
-		glm::vec3 wB = incidentAngularTransform.angularVelocity;
+	auto preSolveByIdx = [&](int manifoldIdx)
+	{
+		Manifold &manifold = manifoldPkg.manifolds[manifoldIdx];
+		Contact const *contacts = manifoldPkg.getContacts(manifold);
+		preSolveManifold(manifold, linearTransformContainer, dt);
 
-		// Iterate through each contact points
-		for (int contactPointIdx = 0
-			; contactPointIdx < manifold.contactBoxIndicesAndContactCount.z
-			; ++contactPointIdx)
+		// Only the restitution is left in the biases, the sub-steps add the separation part
+		if (isSubstepping())
 		{
-			Contact &contact = manifold.contacts[contactPointIdx];
+			for (int i = 0; i < manifold.contactBoxIndicesAndContactCount.z; ++i)
+			{
+				Contact const &contact = contacts[i];
+				bool isSpeculative = contact.separation.w > 0.0f;
 
-			// Relative positions of the contact point to the 2 bodies
-			contact.referenceRelativePosition = contact.position - referenceLinearTransform.position;
-			contact.incidentRelativePosition  = contact.position - incidentLinearTransform.position;
+				mSubstepContacts[manifoldIdx].separations[i] = isSpeculative ? contact.separation.w : manifold.contactNormal.w;
+				mSubstepContacts[manifoldIdx].restitutionBiases[i] = contact.normalTangentMassesBias.w;
+			}
+		}
 
-			// Precalculate J M^-1 JT for contact and friction constraint
-			glm::vec3 referenceRelativePosCrossNormal = glm::cross(glm::vec3(contact.referenceRelativePosition), glm::vec3(manifold.contactNormal));
-			glm::vec3 incidentRelativePosCrossNormal  = glm::cross(glm::vec3(contact.incidentRelativePosition), glm::vec3(manifold.contactNormal));
+		if (!mIsBlockSolveEnabled)
+			return;
 
-			float normalTotalInverseMass  = referenceLinearTransform.inverseMass + incidentLinearTransform.inverseMass;
-			float tangentInverseMasses[2] = { normalTotalInverseMass, normalTotalInverseMass };
+		// A single point has nothing to be solved together with
+		int contactCount = manifold.contactBoxIndicesAndContactCount.z;
+		if (contactCount >= 2 && contactCount <= P3::cMaxBlockContactCount)
+		{
+			computeNormalBlock( manifold, contacts,
+								mSolverBodies[manifold.contactBoxIndicesAndContactCount.x],
+								mSolverBodies[manifold.contactBoxIndicesAndContactCount.y],
+								mNormalBlocks[manifoldIdx] );
+		}
+		else
+		{
+			mNormalBlocks[manifoldIdx].contactCount = 0;
+		}
+	};
 
-			normalTotalInverseMass += glm::dot(referenceRelativePosCrossNormal, glm::mat3(referenceAngularTransform.inverseInertia) * referenceRelativePosCrossNormal)
-				+ glm::dot(incidentRelativePosCrossNormal, glm::mat3(incidentAngularTransform.inverseInertia) * incidentRelativePosCrossNormal);
+	if (mIsIslandSolveEnabled)
+	{
+		P3::buildIslands(manifoldPkg, mSolverBodies, mIslandSet);
+		buildIslandTasks();
 
-			contact.normalTangentMassesBias.x = 1.0f / normalTotalInverseMass;
+		mIslandIterationBounds.assign(mIslandSet.getIslandCount(), mIterationBounds);
+		mIslandIterationCounts.assign(mIslandSet.getIslandCount(), 0);
+		if (mIslandIterationBoundsFunc)
+		{
+			for (int islandIdx = 0; islandIdx < mIslandSet.getIslandCount(); ++islandIdx)
+			{
+				mIslandIterationBounds[islandIdx] = mIslandIterationBoundsFunc(islandIdx);
+			}
+		}
 
-			// Compute the inverse masses in the 2 tangent components
-			for (int j = 0; j < 2; ++j)
+		forEachIsland([&](int islandIdx)
+		{
+			for (int i = mIslandSet.firstManifoldIndices[islandIdx]; i < mIslandSet.firstManifoldIndices[islandIdx + 1]; ++i)
 			{
-				glm::vec3 referenceRelativePosCrossTangent = glm::cross(glm::vec3(manifold.contactTangents[j]), glm::vec3(contact.referenceRelativePosition));
-				glm::vec3 incidentRelativePosCrossTangent  = glm::cross(glm::vec3(manifold.contactTangents[j]), glm::vec3(contact.incidentRelativePosition));
-				tangentInverseMasses[j] += glm::dot(referenceRelativePosCrossTangent, glm::mat3(referenceAngularTransform.inverseInertia) * referenceRelativePosCrossTangent)
-					+ glm::dot(incidentRelativePosCrossTangent, glm::mat3(incidentAngularTransform.inverseInertia) * incidentRelativePosCrossTangent);
-				contact.normalTangentMassesBias[j + 1] = 1.0f / tangentInverseMasses[j];
+				preSolveByIdx(mIslandSet.manifoldIndices[i]);
 			}
+		});
+
+		if (mIsShockPropagationEnabled && !isSubstepping())
+			orderShockManifolds(manifoldPkg);
+
+		return;
+	}
+
+	colorManifolds(manifoldPkg);
+
+	if (mIsShockPropagationEnabled && !isSubstepping())
+		orderShockManifolds(manifoldPkg);
 
-			// Precalculate the bias factor
+	// Then solve contact constraints - Iterate through all manifolds
+	forEachManifoldByColor(preSolveByIdx);
+}
+
+void P3ConstraintSolver::preSolveManifold( Manifold &manifold,
+										   std::vector<LinearTransform> const &linearTransformContainer,
+										   float dt )
+{
+	Contact *contacts = getContacts(manifold);
+
+	if (manifold.frictionRestitution.x <= 0.0f)
+		manifold.frictionRestitution.x = 1.0f;
+
+	if (manifold.frictionRestitution.y <= 0.0f)
+		manifold.frictionRestitution.y = 0.05f;
+
+	int referenceBoxIdx = manifold.contactBoxIndicesAndContactCount.x;
+	int incidentBoxIdx  = manifold.contactBoxIndicesAndContactCount.y;
+
+	P3::SolverBody &referenceBody = mSolverBodies[referenceBoxIdx];
+	P3::SolverBody &incidentBody  = mSolverBodies[incidentBoxIdx];
+
+	glm::vec3 referencePosition = linearTransformContainer[referenceBoxIdx].position;
+	glm::vec3 incidentPosition  = linearTransformContainer[incidentBoxIdx].position;
+
+	// Compute the basis
+	computeBasis(manifold.contactNormal, manifold.contactTangents[0], manifold.contactTangents[1]);
+
+	glm::vec3 vA = referenceBody.linearVelocity;
+	glm::vec3 wA = referenceBody.angularVelocity;
+	glm::vec3 vB = incidentBody.linearVelocity;
+	glm::vec3 wB = incidentBody.angularVelocity;
+
+	// Iterate through each contact points
+	for (int contactPointIdx = 0
+		; contactPointIdx < manifold.contactBoxIndicesAndContactCount.z
+		; ++contactPointIdx)
+	{
+		Contact &contact = contacts[contactPointIdx];
+
+		// Relative positions of the contact point to the 2 bodies
+		contact.referenceRelativePosition = glm::vec4(glm::vec3(contact.position) - referencePosition, 0.0f);
+		contact.incidentRelativePosition  = glm::vec4(glm::vec3(contact.position) - incidentPosition, 0.0f);
+
+		computeContactMasses(manifold, referenceBody, incidentBody, contact);
+
+		// Precalculate the bias factor. A speculative contact is still apart, so instead of pushing out, the bias lets
+		//  the bodies approach by up to the gap this step. The impulse only kicks in if they would close it.
+		//  With split impulse the penetration is left to the position pass instead, and sub-steps recompute it.
+		bool isSpeculative = contact.separation.w > 0.0f;
+		if (isSubstepping())
+			contact.normalTangentMassesBias.w = 0.0f;
+		else if (isSpeculative)
+			contact.normalTangentMassesBias.w = -contact.separation.w / dt;
+		else if (mIsSplitImpulseEnabled)
+			contact.normalTangentMassesBias.w = 0.0f;
+		else
 			contact.normalTangentMassesBias.w = -cBaumgarteFactor * std::min(0.0f, manifold.contactNormal.w + cPenetrationSlop) / dt;
 
-			// Warm start
+		// The pseudo velocities start from rest every step, so their impulses do too
+		contact.normalTangentBiasImpulses.w = 0.0f;
+
+		// Warm start, unless every sub-step does its own
+		if (!isSubstepping())
+		{
 			glm::vec3 oldP = glm::vec3(manifold.contactNormal) * contact.normalTangentBiasImpulses.x;
 
 			// Friction
 			oldP += glm::vec3(manifold.contactTangents[0]) * contact.normalTangentBiasImpulses.y;
 			oldP += glm::vec3(manifold.contactTangents[1]) * contact.normalTangentBiasImpulses.z;
 
-			vA -= oldP * referenceLinearTransform.inverseMass;
-			wA -= glm::mat3(referenceAngularTransform.inverseInertia) * glm::cross(glm::vec3(contact.referenceRelativePosition), oldP);
+			vA -= oldP * referenceBody.inverseMass;
+			wA -= referenceBody.worldInverseInertia * glm::cross(glm::vec3(contact.referenceRelativePosition), oldP);
+
+			vB += oldP * incidentBody.inverseMass;
+			wB += incidentBody.worldInverseInertia * glm::cross(glm::vec3(contact.incidentRelativePosition), oldP);
+		}
+
+		// Restitution bias
+		float dv = glm::dot(vB + glm::cross(wB, glm::vec3(contact.incidentRelativePosition)) - vA - glm::cross(wA, glm::vec3(contact.referenceRelativePosition))
+			, glm::vec3(manifold.contactNormal));
+
+		if (dv < -1.0f && !isSpeculative)
+		{
+			contact.normalTangentMassesBias.w += -(manifold.frictionRestitution.y) * dv;
+		}
+
+	}
+
+	// Static bodies can be shared within a color, so they must not be written to
+	if (referenceBody.isDynamic())
+	{
+		referenceBody.linearVelocity = vA;
+		referenceBody.angularVelocity = wA;
+	}
+
+	if (incidentBody.isDynamic())
+	{
+		incidentBody.linearVelocity = vB;
+		incidentBody.angularVelocity = wB;
+	}
+}
+
+void P3ConstraintSolver::iterativeSolve( ManifoldGpuPackage &manifoldPkg,
+										 std::vector<LinearTransform> &linearTransformContainer,
+										 std::vector<AngularTransform> &angularTransformContainer )
+{
+	mpManifoldPkg = &manifoldPkg;
+	mLastIterationCount = 0;
+
+	if (isSubstepping())
+	{
+		solveSubsteps(manifoldPkg);
+	}
+	else if (mIsIslandSolveEnabled)
+	{
+		// Islands don't affect each other, so each one runs all of its iterations without waiting on the rest
+		forEachIsland([&](int islandIdx)
+		{
+			int iterationCount = 0;
+			float residual = 0.0f;
+
+			do
+			{
+				residual = 0.0f;
+				for (int i = mIslandSet.firstManifoldIndices[islandIdx]; i < mIslandSet.firstManifoldIndices[islandIdx + 1]; ++i)
+				{
+					int manifoldIdx = mIslandSet.manifoldIndices[i];
+					residual = std::max(residual, solveManifold(manifoldPkg.manifolds[manifoldIdx], getNormalBlock(manifoldIdx)));
+				}
+			} while (!hasConverged(++iterationCount, residual, mIslandIterationBounds[islandIdx]));
+
+			if (mIsShockPropagationEnabled)
+			{
+				for (int i = mIslandSet.firstManifoldIndices[islandIdx]; i < mIslandSet.firstManifoldIndices[islandIdx + 1]; ++i)
+				{
+					int manifoldIdx = mShockManifoldIndices[i];
+					solveShockManifold(manifoldPkg.manifolds[manifoldIdx], manifoldIdx);
+				}
+
+				++iterationCount;
+			}
+
+			mIslandIterationCounts[islandIdx] = iterationCount;
+		});
 
-			vB += oldP * incidentLinearTransform.inverseMass;
-			wB += glm::mat3(incidentAngularTransform.inverseInertia) * glm::cross(glm::vec3(contact.incidentRelativePosition), oldP);
+		for (int iterationCount : mIslandIterationCounts)
+		{
+			mLastIterationCount = std::max(mLastIterationCount, iterationCount);
+		}
+	}
+	else if (mIsWideContactSolveEnabled)
+	{
+		mWideContactSolver.prepare(manifoldPkg, mColorManifoldIndices, mSolverBodies);
+		mResiduals.resize(mWideContactSolver.getBatchCount());
+
+		float residual = 0.0f;
+		do
+		{
+			for (int color = 0; color < mWideContactSolver.getColorCount(); ++color)
+			{
+				int firstBatchIdx = mWideContactSolver.getFirstBatchIdx(color);
+
+				P3::getJobSystem().parallelFor(mWideContactSolver.getBatchCount(color), cWideBatchesPerTask, [&](int begin, int end)
+				{
+					for (int i = begin; i < end; ++i)
+					{
+						mResiduals[firstBatchIdx + i] = mWideContactSolver.solveBatch(firstBatchIdx + i, mSolverBodies);
+					}
+				});
+			}
+
+			residual = 0.0f;
+			for (int manifoldIdx : mUncoloredManifoldIndices)
+			{
+				residual = std::max(residual, solveManifold(manifoldPkg.manifolds[manifoldIdx], getNormalBlock(manifoldIdx)));
+			}
 
-			// Restitution bias
-			float dv = glm::dot(vB + glm::cross(wB, glm::vec3(contact.incidentRelativePosition)) - vA - glm::cross(wA, glm::vec3(contact.referenceRelativePosition))
-				, glm::vec3(manifold.contactNormal));
+			for (float batchResidual : mResiduals)
+			{
+				residual = std::max(residual, batchResidual);
+			}
+		} while (!hasConverged(++mLastIterationCount, residual, mIterationBounds));
 
-			if (dv < -1.0f)
+		mWideContactSolver.finish(manifoldPkg);
+	}
+	else
+	{
+		mResiduals.resize(manifoldPkg.misc.x);
+
+		float residual = 0.0f;
+		do
+		{
+			forEachManifoldByColor([&](int manifoldIdx)
 			{
-				contact.normalTangentMassesBias.w += -(manifold.frictionRestitution.y) * dv;
+				mResiduals[manifoldIdx] = solveManifold(manifoldPkg.manifolds[manifoldIdx], getNormalBlock(manifoldIdx));
+			});
+
+			residual = 0.0f;
+			for (float manifoldResidual : mResiduals)
+			{
+				residual = std::max(residual, manifoldResidual);
 			}
+		} while (!hasConverged(++mLastIterationCount, residual, mIterationBounds));
+	}
 
-			referenceLinearTransform.velocity = glm::vec4(vA, 0.0f);
-			referenceAngularTransform.angularVelocity = glm::vec4(wA, 0.0f);
-			incidentLinearTransform.velocity = glm::vec4(vB, 0.0f);
-			incidentAngularTransform.angularVelocity = glm::vec4(wB, 0.0f);
+	// Islands did theirs already
+	if (mIsShockPropagationEnabled && !isSubstepping() && !mIsIslandSolveEnabled)
+	{
+		for (int manifoldIdx : mShockManifoldIndices)
+		{
+			solveShockManifold(manifoldPkg.manifolds[manifoldIdx], manifoldIdx);
 		}
+
+		++mLastIterationCount;
 	}
+
+	if (mIsSplitImpulseEnabled && !isSubstepping())
+		solvePositions(manifoldPkg);
+
+	scatterSolverBodies(linearTransformContainer, angularTransformContainer);
 }
 
-void P3ConstraintSolver::iterativeSolve( ManifoldGpuPackage &manifoldPkg,
-										 std::vector<LinearTransform> &rigidLinearTransformContainer,
-										 std::vector<AngularTransform> &rigidAngularTransformContainer,
-										 std::vector<LinearTransform> &staticLinearTransformContainer,
-										 std::vector<AngularTransform> &staticAngularTransformContainer )
+void P3ConstraintSolver::solveSubsteps(ManifoldGpuPackage &manifoldPkg)
 {
-	for (int iteration = 0; iteration < cIterationCount; ++iteration)
+	float substepDt = mDt / mSubstepCount;
+	P3::IterationBounds substepBounds{ 1, mSubstepIterationCount };
+
+	mDisplacements.assign(mSolverBodies.size(), P3::Displacement{ glm::vec3(0.0f), glm::vec3(0.0f) });
+
+	if (mIsIslandSolveEnabled)
 	{
-		for (int k = 0; k < manifoldPkg.misc.x; ++k)
+		// All the sub-steps of an island run on the same thread, no sync between them
+		forEachIsland([&](int islandIdx)
 		{
-			Manifold &manifold = manifoldPkg.manifolds[k];
+			int firstManifoldIdx = mIslandSet.firstManifoldIndices[islandIdx];
+			int lastManifoldIdx  = mIslandSet.firstManifoldIndices[islandIdx + 1];
+			int firstBodyIdx = mIslandSet.firstBodyIndices[islandIdx];
+			int lastBodyIdx  = mIslandSet.firstBodyIndices[islandIdx + 1];
+			int totalIterationCount = 0;
 
-			int referenceBoxIdx = manifold.contactBoxIndicesAndContactCount.x;
-			int incidentBoxIdx  = manifold.contactBoxIndicesAndContactCount.y;
+			for (int substep = 0; substep < mSubstepCount; ++substep)
+			{
+				for (int i = firstBodyIdx; i < lastBodyIdx; ++i)
+				{
+					applyExternalForces(mIslandSet.bodyIndices[i], substepDt);
+				}
 
-			LinearTransform &referenceLinearTransform   = getLinearTransform(referenceBoxIdx, rigidLinearTransformContainer, staticLinearTransformContainer);
-			AngularTransform &referenceAngularTransform = getAngularTransform(referenceBoxIdx, rigidAngularTransformContainer, staticAngularTransformContainer);
+				for (int i = firstManifoldIdx; i < lastManifoldIdx; ++i)
+				{
+					int manifoldIdx = mIslandSet.manifoldIndices[i];
+					warmStartManifold(manifoldPkg.manifolds[manifoldIdx]);
+					updateSubstepBiases(manifoldPkg.manifolds[manifoldIdx], manifoldIdx, substepDt, true);
+				}
 
-			LinearTransform &incidentLinearTransform   = getLinearTransform(incidentBoxIdx, rigidLinearTransformContainer, staticLinearTransformContainer);
-			AngularTransform &incidentAngularTransform = getAngularTransform(incidentBoxIdx, rigidAngularTransformContainer, staticAngularTransformContainer);
+				int iterationCount = 0;
+				float residual = 0.0f;
+				do
+				{
+					residual = 0.0f;
+					for (int i = firstManifoldIdx; i < lastManifoldIdx; ++i)
+					{
+						int manifoldIdx = mIslandSet.manifoldIndices[i];
+						residual = std::max(residual, solveManifold(manifoldPkg.manifolds[manifoldIdx], getNormalBlock(manifoldIdx)));
+					}
+				} while (!hasConverged(++iterationCount, residual, substepBounds));
 
-			glm::vec3 vA = referenceLinearTransform.velocity;
-			glm::vec3 wA = referenceAngularTransform.angularVelocity;
-			glm::vec3 vB = incidentLinearTransform.velocity;
-			glm::vec3 wB = incidentAngularTransform.angularVelocity;
+				// And 1 for the relaxation below
+				totalIterationCount += iterationCount + 1;
 
-			for (int contactPointIdx = 0; contactPointIdx < manifold.contactBoxIndicesAndContactCount.z; ++contactPointIdx)
-			{
-				Contact &contact = manifold.contacts[contactPointIdx];
+				for (int i = firstBodyIdx; i < lastBodyIdx; ++i)
+				{
+					integrateDisplacement(mIslandSet.bodyIndices[i], substepDt);
+				}
 
-				// Relative velocity at contact
-				glm::vec3 dv = vB + glm::cross(wB, glm::vec3(contact.incidentRelativePosition)) - vA
-							 - glm::cross(wA, glm::vec3(contact.referenceRelativePosition));
+				// Relaxation, takes out the velocity the push out left, so it doesn't carry over to the next sub-step
+				for (int i = firstManifoldIdx; i < lastManifoldIdx; ++i)
+				{
+					int manifoldIdx = mIslandSet.manifoldIndices[i];
+					updateSubstepBiases(manifoldPkg.manifolds[manifoldIdx], manifoldIdx, substepDt, false);
+					solveManifold(manifoldPkg.manifolds[manifoldIdx], getNormalBlock(manifoldIdx));
+				}
+			}
 
-				// For friction
-				for (int k = 0; k < 2; ++k)
+			mIslandIterationCounts[islandIdx] = totalIterationCount;
+		});
+
+		for (int iterationCount : mIslandIterationCounts)
+		{
+			mLastIterationCount = std::max(mLastIterationCount, iterationCount);
+		}
+
+		// Islands without manifolds were skipped, their bodies only feel the forces
+		for (int islandIdx = 0; islandIdx < mIslandSet.getIslandCount(); ++islandIdx)
+		{
+			if (mIslandSet.getManifoldCount(islandIdx) > 0)
+				continue;
+
+			for (int i = mIslandSet.firstBodyIndices[islandIdx]; i < mIslandSet.firstBodyIndices[islandIdx + 1]; ++i)
+			{
+				for (int substep = 0; substep < mSubstepCount; ++substep)
 				{
-					float lambda = -glm::dot(dv, glm::vec3(manifold.contactTangents[k])) * contact.normalTangentMassesBias[k + 1];
+					applyExternalForces(mIslandSet.bodyIndices[i], substepDt);
+					integrateDisplacement(mIslandSet.bodyIndices[i], substepDt);
+				}
+			}
+		}
+
+		return;
+	}
+
+	mResiduals.resize(manifoldPkg.misc.x);
+
+	int bodyCount = static_cast<int>(mSolverBodies.size());
+	for (int substep = 0; substep < mSubstepCount; ++substep)
+	{
+		for (int i = 0; i < bodyCount; ++i)
+		{
+			applyExternalForces(i, substepDt);
+		}
+
+		forEachManifoldByColor([&](int manifoldIdx)
+		{
+			warmStartManifold(manifoldPkg.manifolds[manifoldIdx]);
+			updateSubstepBiases(manifoldPkg.manifolds[manifoldIdx], manifoldIdx, substepDt, true);
+		});
+
+		int iterationCount = 0;
+		float residual = 0.0f;
+		do
+		{
+			forEachManifoldByColor([&](int manifoldIdx)
+			{
+				mResiduals[manifoldIdx] = solveManifold(manifoldPkg.manifolds[manifoldIdx], getNormalBlock(manifoldIdx));
+			});
+
+			residual = 0.0f;
+			for (float manifoldResidual : mResiduals)
+			{
+				residual = std::max(residual, manifoldResidual);
+			}
+		} while (!hasConverged(++iterationCount, residual, substepBounds));
+
+		mLastIterationCount += iterationCount + 1;
+
+		for (int i = 0; i < bodyCount; ++i)
+		{
+			integrateDisplacement(i, substepDt);
+		}
+
+		// Relaxation, takes out the velocity the push out left, so it doesn't carry over to the next sub-step
+		forEachManifoldByColor([&](int manifoldIdx)
+		{
+			updateSubstepBiases(manifoldPkg.manifolds[manifoldIdx], manifoldIdx, substepDt, false);
+			solveManifold(manifoldPkg.manifolds[manifoldIdx], getNormalBlock(manifoldIdx));
+		});
+	}
+}
+
+void P3ConstraintSolver::orderShockManifolds(ManifoldGpuPackage const &manifoldPkg)
+{
+	P3::computeBodyLayers(manifoldPkg, mSolverBodies, mBodyLayers);
 
-					// Frictional impulse
-					float maxLambda = manifold.frictionRestitution.x * contact.normalTangentBiasImpulses.x;
+	auto getManifoldLayer = [&](int manifoldIdx)
+	{
+		glm::ivec4 const &bodyIndices = manifoldPkg.manifolds[manifoldIdx].contactBoxIndicesAndContactCount;
+		return std::min(mBodyLayers[bodyIndices.x], mBodyLayers[bodyIndices.y]);
+	};
+
+	auto isLowerLayer = [&](int manifoldIdxA, int manifoldIdxB)
+	{
+		return getManifoldLayer(manifoldIdxA) < getManifoldLayer(manifoldIdxB);
+	};
+
+	if (mIsIslandSolveEnabled)
+	{
+		mShockManifoldIndices = mIslandSet.manifoldIndices;
+		for (int islandIdx = 0; islandIdx < mIslandSet.getIslandCount(); ++islandIdx)
+		{
+			std::stable_sort( mShockManifoldIndices.begin() + mIslandSet.firstManifoldIndices[islandIdx],
+							  mShockManifoldIndices.begin() + mIslandSet.firstManifoldIndices[islandIdx + 1],
+							  isLowerLayer );
+		}
+
+		return;
+	}
+
+	mShockManifoldIndices.resize(manifoldPkg.misc.x);
+	for (int i = 0; i < manifoldPkg.misc.x; ++i)
+	{
+		mShockManifoldIndices[i] = i;
+	}
+
+	std::stable_sort(mShockManifoldIndices.begin(), mShockManifoldIndices.end(), isLowerLayer);
+}
+
+void P3ConstraintSolver::solveShockManifold(Manifold &manifold, int manifoldIdx)
+{
+	Contact *contacts = getContacts(manifold);
+
+	int referenceBoxIdx = manifold.contactBoxIndicesAndContactCount.x;
+	int incidentBoxIdx  = manifold.contactBoxIndicesAndContactCount.y;
+
+	if (mBodyLayers[referenceBoxIdx] == mBodyLayers[incidentBoxIdx])
+	{
+		solveManifold(manifold, getNormalBlock(manifoldIdx));
+		return;
+	}
+
+	// Frozen for this manifold only, like a static body. The masses of the contacts follow, the block doesn't.
+	int frozenBodyIdx = mBodyLayers[referenceBoxIdx] < mBodyLayers[incidentBoxIdx] ? referenceBoxIdx : incidentBoxIdx;
+	P3::SolverBody frozenBody = mSolverBodies[frozenBodyIdx];
+
+	mSolverBodies[frozenBodyIdx].inverseMass = 0.0f;
+	mSolverBodies[frozenBodyIdx].worldInverseInertia = P3::SymmetricMat3{};
+	mSolverBodies[frozenBodyIdx].flags |= cKinematicBodyFlag;
+
+	glm::vec4 contactMasses[cMaxManifoldContactCount];
+	for (int i = 0; i < manifold.contactBoxIndicesAndContactCount.z; ++i)
+	{
+		contactMasses[i] = contacts[i].normalTangentMassesBias;
+		computeContactMasses(manifold, mSolverBodies[referenceBoxIdx], mSolverBodies[incidentBoxIdx], contacts[i]);
+	}
+
+	solveManifold(manifold, nullptr);
+
+	for (int i = 0; i < manifold.contactBoxIndicesAndContactCount.z; ++i)
+	{
+		contacts[i].normalTangentMassesBias = contactMasses[i];
+	}
+
+	mSolverBodies[frozenBodyIdx] = frozenBody;
+}
+
+void P3ConstraintSolver::warmStartManifold(Manifold &manifold)
+{
+	Contact *contacts = getContacts(manifold);
+
+	int referenceBoxIdx = manifold.contactBoxIndicesAndContactCount.x;
+	int incidentBoxIdx  = manifold.contactBoxIndicesAndContactCount.y;
+
+	P3::SolverBody &referenceBody = mSolverBodies[referenceBoxIdx];
+	P3::SolverBody &incidentBody  = mSolverBodies[incidentBoxIdx];
+
+	glm::vec3 vA = referenceBody.linearVelocity;
+	glm::vec3 wA = referenceBody.angularVelocity;
+	glm::vec3 vB = incidentBody.linearVelocity;
+	glm::vec3 wB = incidentBody.angularVelocity;
+
+	for (int contactPointIdx = 0; contactPointIdx < manifold.contactBoxIndicesAndContactCount.z; ++contactPointIdx)
+	{
+		Contact const &contact = contacts[contactPointIdx];
+
+		glm::vec3 oldP = glm::vec3(manifold.contactNormal) * contact.normalTangentBiasImpulses.x;
+		oldP += glm::vec3(manifold.contactTangents[0]) * contact.normalTangentBiasImpulses.y;
+		oldP += glm::vec3(manifold.contactTangents[1]) * contact.normalTangentBiasImpulses.z;
+
+		vA -= oldP * referenceBody.inverseMass;
+		wA -= referenceBody.worldInverseInertia * glm::cross(glm::vec3(contact.referenceRelativePosition), oldP);
+
+		vB += oldP * incidentBody.inverseMass;
+		wB += incidentBody.worldInverseInertia * glm::cross(glm::vec3(contact.incidentRelativePosition), oldP);
+	}
+
+	if (referenceBody.isDynamic())
+	{
+		referenceBody.linearVelocity = vA;
+		referenceBody.angularVelocity = wA;
+	}
+
+	if (incidentBody.isDynamic())
+	{
+		incidentBody.linearVelocity = vB;
+		incidentBody.angularVelocity = wB;
+	}
+}
+
+void P3ConstraintSolver::updateSubstepBiases(Manifold &manifold, int manifoldIdx, float substepDt, bool isPushingOut)
+{
+	Contact *contacts = getContacts(manifold);
 
-					// Clamp frictional impulse
-					float oldTangentImpulse = contact.normalTangentBiasImpulses[k + 1];
-					contact.normalTangentBiasImpulses[k + 1] = glm::clamp(oldTangentImpulse + lambda, -maxLambda, maxLambda);
-					lambda = contact.normalTangentBiasImpulses[k + 1] - oldTangentImpulse;
+	P3::Displacement const &referenceDisplacement = mDisplacements[manifold.contactBoxIndicesAndContactCount.x];
+	P3::Displacement const &incidentDisplacement  = mDisplacements[manifold.contactBoxIndicesAndContactCount.y];
+	SubstepContacts const &substepContacts = mSubstepContacts[manifoldIdx];
 
-					// Apply frictional impulse
-					glm::vec3 tangentImpulse = manifold.contactTangents[k] * lambda;
-					vA -= tangentImpulse * referenceLinearTransform.inverseMass;
-					wA -= glm::mat3(referenceAngularTransform.inverseInertia) * glm::cross(glm::vec3(contact.referenceRelativePosition), tangentImpulse);
+	for (int contactPointIdx = 0; contactPointIdx < manifold.contactBoxIndicesAndContactCount.z; ++contactPointIdx)
+	{
+		Contact &contact = contacts[contactPointIdx];
+
+		// The lever arms are kept from the start of the step, linearized like the velocities
+		glm::vec3 relativeDisplacement = incidentDisplacement.linear
+			+ glm::cross(incidentDisplacement.angular, glm::vec3(contact.incidentRelativePosition))
+			- referenceDisplacement.linear
+			- glm::cross(referenceDisplacement.angular, glm::vec3(contact.referenceRelativePosition));
+
+		float separation = substepContacts.separations[contactPointIdx] + glm::dot(relativeDisplacement, glm::vec3(manifold.contactNormal));
+
+		// Apart, the bodies may close the gap within the sub-step. Else push out like the regular solver does over a step.
+		float separationBias = 0.0f;
+		if (separation > 0.0f)
+			separationBias = -separation / substepDt;
+		else if (isPushingOut)
+			separationBias = -cBaumgarteFactor * std::min(0.0f, separation + cPenetrationSlop) / substepDt;
+
+		contact.normalTangentMassesBias.w = substepContacts.restitutionBiases[contactPointIdx] + separationBias;
+	}
+}
+
+void P3ConstraintSolver::applyExternalForces(int bodyIdx, float substepDt)
+{
+	P3::SolverBody &solverBody = mSolverBodies[bodyIdx];
+	if (solverBody.isDynamic())
+		solverBody.linearVelocity += substepDt * mGravity;
+}
+
+void P3ConstraintSolver::integrateDisplacement(int bodyIdx, float substepDt)
+{
+	P3::SolverBody const &solverBody = mSolverBodies[bodyIdx];
+	if (!solverBody.isDynamic())
+		return;
+
+	mDisplacements[bodyIdx].linear  += substepDt * solverBody.linearVelocity;
+	mDisplacements[bodyIdx].angular += substepDt * solverBody.angularVelocity;
+}
+
+void P3ConstraintSolver::solvePositions(ManifoldGpuPackage &manifoldPkg)
+{
+	// Same parallel layout as the velocity iterations, whatever the mode, the wide one uses its colors
+	P3::IterationBounds positionBounds{ 1, mPositionIterationCount };
 
-					vB += tangentImpulse * incidentLinearTransform.inverseMass;
-					wB += glm::mat3(incidentAngularTransform.inverseInertia) * glm::cross(glm::vec3(contact.incidentRelativePosition), tangentImpulse);
+	if (mIsIslandSolveEnabled)
+	{
+		forEachIsland([&](int islandIdx)
+		{
+			int iterationCount = 0;
+			float residual = 0.0f;
+
+			do
+			{
+				residual = 0.0f;
+				for (int i = mIslandSet.firstManifoldIndices[islandIdx]; i < mIslandSet.firstManifoldIndices[islandIdx + 1]; ++i)
+				{
+					residual = std::max(residual, solveManifoldPosition(manifoldPkg.manifolds[mIslandSet.manifoldIndices[i]]));
 				}
+			} while (!hasConverged(++iterationCount, residual, positionBounds));
+		});
+
+		return;
+	}
+
+	mResiduals.resize(manifoldPkg.misc.x);
+
+	int iterationCount = 0;
+	float residual = 0.0f;
+	do
+	{
+		forEachManifoldByColor([&](int manifoldIdx)
+		{
+			mResiduals[manifoldIdx] = solveManifoldPosition(manifoldPkg.manifolds[manifoldIdx]);
+		});
+
+		residual = 0.0f;
+		for (float manifoldResidual : mResiduals)
+		{
+			residual = std::max(residual, manifoldResidual);
+		}
+	} while (!hasConverged(++iterationCount, residual, positionBounds));
+}
+
+float P3ConstraintSolver::solveManifoldPosition(Manifold &manifold)
+{
+	Contact *contacts = getContacts(manifold);
+
+	// Push out of the penetration over a few steps, like Baumgarte but on the pseudo velocities
+	float positionBias = -cSplitImpulseFactor * std::min(0.0f, manifold.contactNormal.w + cPenetrationSlop) / mDt;
+	if (positionBias <= 0.0f)
+		return 0.0f;
+
+	int referenceBoxIdx = manifold.contactBoxIndicesAndContactCount.x;
+	int incidentBoxIdx  = manifold.contactBoxIndicesAndContactCount.y;
+
+	P3::SolverBody const &referenceBody = mSolverBodies[referenceBoxIdx];
+	P3::SolverBody const &incidentBody  = mSolverBodies[incidentBoxIdx];
+
+	glm::vec3 vA = mPseudoVelocities[referenceBoxIdx].linear;
+	glm::vec3 wA = mPseudoVelocities[referenceBoxIdx].angular;
+	glm::vec3 vB = mPseudoVelocities[incidentBoxIdx].linear;
+	glm::vec3 wB = mPseudoVelocities[incidentBoxIdx].angular;
+
+	float residual = 0.0f;
+
+	for (int contactPointIdx = 0; contactPointIdx < manifold.contactBoxIndicesAndContactCount.z; ++contactPointIdx)
+	{
+		Contact &contact = contacts[contactPointIdx];
+
+		// Speculative contacts aren't touching yet, nothing to push out of
+		if (contact.separation.w > 0.0f)
+			continue;
+
+		glm::vec3 dv = vB + glm::cross(wB, glm::vec3(contact.incidentRelativePosition)) - vA
+					 - glm::cross(wA, glm::vec3(contact.referenceRelativePosition));
+
+		float vn = glm::dot(dv, glm::vec3(manifold.contactNormal));
+		float lambda = contact.normalTangentMassesBias.x * (-vn + positionBias);
+
+		float oldPositionImpulse = contact.normalTangentBiasImpulses.w;
+		contact.normalTangentBiasImpulses.w = std::max(oldPositionImpulse + lambda, 0.0f);
+		lambda = contact.normalTangentBiasImpulses.w - oldPositionImpulse;
+		residual = std::max(residual, std::abs(lambda));
+
+		glm::vec3 positionImpulse = glm::vec3(manifold.contactNormal) * lambda;
+		vA -= positionImpulse * referenceBody.inverseMass;
+		wA -= referenceBody.worldInverseInertia * glm::cross(glm::vec3(contact.referenceRelativePosition), positionImpulse);
+
+		vB += positionImpulse * incidentBody.inverseMass;
+		wB += incidentBody.worldInverseInertia * glm::cross(glm::vec3(contact.incidentRelativePosition), positionImpulse);
+	}
+
+	if (referenceBody.isDynamic())
+	{
+		mPseudoVelocities[referenceBoxIdx].linear = vA;
+		mPseudoVelocities[referenceBoxIdx].angular = wA;
+	}
+
+	if (incidentBody.isDynamic())
+	{
+		mPseudoVelocities[incidentBoxIdx].linear = vB;
+		mPseudoVelocities[incidentBoxIdx].angular = wB;
+	}
+
+	return residual;
+}
+
+float P3ConstraintSolver::solveManifold(Manifold &manifold, P3::NormalBlock const *pNormalBlock)
+{
+	Contact *contacts = getContacts(manifold);
+
+	int referenceBoxIdx = manifold.contactBoxIndicesAndContactCount.x;
+	int incidentBoxIdx  = manifold.contactBoxIndicesAndContactCount.y;
+
+	P3::SolverBody &referenceBody = mSolverBodies[referenceBoxIdx];
+	P3::SolverBody &incidentBody  = mSolverBodies[incidentBoxIdx];
+
+	glm::vec3 vA = referenceBody.linearVelocity;
+	glm::vec3 wA = referenceBody.angularVelocity;
+	glm::vec3 vB = incidentBody.linearVelocity;
+	glm::vec3 wB = incidentBody.angularVelocity;
+
+	float residual = 0.0f;
+
+	auto solveNormalImpulse = [&](Contact &contact)
+	{
+		glm::vec3 dv = vB + glm::cross(wB, glm::vec3(contact.incidentRelativePosition)) - vA - glm::cross(wA, glm::vec3(contact.referenceRelativePosition));
+
+		// Normal impulse
+		float vn = glm::dot(dv, glm::vec3(manifold.contactNormal));
+
+		// Factor in positional bias
+		float lambda = contact.normalTangentMassesBias.x * (-vn + contact.normalTangentMassesBias.w);
+
+		// Clamp impulse
+		float tempNormalImpulse = contact.normalTangentBiasImpulses.x;
+		contact.normalTangentBiasImpulses.x = std::max(tempNormalImpulse + lambda, 0.0f);
+		lambda = contact.normalTangentBiasImpulses.x - tempNormalImpulse;
+		residual = std::max(residual, std::abs(lambda));
+
+		// Apply impulse
+		glm::vec3 normalImpulse = glm::vec3(manifold.contactNormal) * lambda;
+		vA -= normalImpulse * referenceBody.inverseMass;
+		wA -= referenceBody.worldInverseInertia * glm::cross(glm::vec3(contact.referenceRelativePosition), normalImpulse);
+
+		vB += normalImpulse * incidentBody.inverseMass;
+		wB += incidentBody.worldInverseInertia * glm::cross(glm::vec3(contact.incidentRelativePosition), normalImpulse);
+	};
+
+	for (int contactPointIdx = 0; contactPointIdx < manifold.contactBoxIndicesAndContactCount.z; ++contactPointIdx)
+	{
+		Contact &contact = contacts[contactPointIdx];
+
+		// Relative velocity at contact
+		glm::vec3 dv = vB + glm::cross(wB, glm::vec3(contact.incidentRelativePosition)) - vA
+					 - glm::cross(wA, glm::vec3(contact.referenceRelativePosition));
+
+		// For friction
+		for (int k = 0; k < 2; ++k)
+		{
+			float lambda = -glm::dot(dv, glm::vec3(manifold.contactTangents[k])) * contact.normalTangentMassesBias[k + 1];
+
+			// Frictional impulse
+			float maxLambda = manifold.frictionRestitution.x * contact.normalTangentBiasImpulses.x;
+
+			// Clamp frictional impulse
+			float oldTangentImpulse = contact.normalTangentBiasImpulses[k + 1];
+			contact.normalTangentBiasImpulses[k + 1] = glm::clamp(oldTangentImpulse + lambda, -maxLambda, maxLambda);
+			lambda = contact.normalTangentBiasImpulses[k + 1] - oldTangentImpulse;
+			residual = std::max(residual, std::abs(lambda));
+
+			// Apply frictional impulse
+			glm::vec3 tangentImpulse = manifold.contactTangents[k] * lambda;
+			vA -= tangentImpulse * referenceBody.inverseMass;
+			wA -= referenceBody.worldInverseInertia * glm::cross(glm::vec3(contact.referenceRelativePosition), tangentImpulse);
+
+			vB += tangentImpulse * incidentBody.inverseMass;
+			wB += incidentBody.worldInverseInertia * glm::cross(glm::vec3(contact.incidentRelativePosition), tangentImpulse);
+		}
+
+		// Solve contact constraint, unless all of them are solved together below
+		if (!pNormalBlock)
+			solveNormalImpulse(contact);
+	}
+
+	// Falls back to one contact after another when no set of pushing contacts fits
+	if (pNormalBlock && !solveNormalImpulsesAsBlock(manifold, contacts, *pNormalBlock, referenceBody, incidentBody, vA, wA, vB, wB, residual))
+	{
+		for (int contactPointIdx = 0; contactPointIdx < manifold.contactBoxIndicesAndContactCount.z; ++contactPointIdx)
+		{
+			solveNormalImpulse(contacts[contactPointIdx]);
+		}
+	}
+
+	// Directly apply the change in velocities, static bodies can be shared within a color so leave them be
+	if (referenceBody.isDynamic())
+	{
+		referenceBody.linearVelocity = vA;
+		referenceBody.angularVelocity = wA;
+	}
+
+	if (incidentBody.isDynamic())
+	{
+		incidentBody.linearVelocity = vB;
+		incidentBody.angularVelocity = wB;
+	}
+
+	return residual;
+}
+
+void P3ConstraintSolver::colorManifolds(ManifoldGpuPackage const &manifoldPkg)
+{
+	for (std::vector<int> &manifoldIndices : mColorManifoldIndices)
+	{
+		manifoldIndices.clear();
+	}
+
+	mUncoloredManifoldIndices.clear();
+	mBodyColorMasks.assign(mSolverBodies.size(), 0u);
+
+	for (int i = 0; i < manifoldPkg.misc.x; ++i)
+	{
+		int referenceBoxIdx = manifoldPkg.manifolds[i].contactBoxIndicesAndContactCount.x;
+		int incidentBoxIdx  = manifoldPkg.manifolds[i].contactBoxIndicesAndContactCount.y;
+
+		bool isReferenceDynamic = mSolverBodies[referenceBoxIdx].isDynamic();
+		bool isIncidentDynamic  = mSolverBodies[incidentBoxIdx].isDynamic();
+
+		uint64_t takenColors = (isReferenceDynamic ? mBodyColorMasks[referenceBoxIdx] : 0u)
+							 | (isIncidentDynamic ? mBodyColorMasks[incidentBoxIdx] : 0u);
+
+		if (takenColors == ~uint64_t(0u))
+		{
+			mUncoloredManifoldIndices.push_back(i);
+			continue;
+		}
+
+		// Lowest color none of the 2 bodies has yet
+		int color = 0;
+		while (takenColors & (uint64_t(1u) << color))
+			++color;
+
+		if (color >= static_cast<int>(mColorManifoldIndices.size()))
+			mColorManifoldIndices.resize(color + 1);
+
+		mColorManifoldIndices[color].push_back(i);
+
+		if (isReferenceDynamic) mBodyColorMasks[referenceBoxIdx] |= uint64_t(1u) << color;
+		if (isIncidentDynamic)  mBodyColorMasks[incidentBoxIdx]  |= uint64_t(1u) << color;
+	}
+}
+
+template<typename Func>
+void P3ConstraintSolver::forEachManifoldByColor(Func const &func)
+{
+	for (std::vector<int> const &manifoldIndices : mColorManifoldIndices)
+	{
+		P3::getJobSystem().parallelFor(static_cast<int>(manifoldIndices.size()), cManifoldsPerTask, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; ++i)
+			{
+				func(manifoldIndices[i]);
+			}
+		});
+	}
+
+	for (int manifoldIdx : mUncoloredManifoldIndices)
+	{
+		func(manifoldIdx);
+	}
+}
+
+void P3ConstraintSolver::buildIslandTasks()
+{
+	mIslandTaskFirstIslands.assign(1, 0);
+
+	int manifoldCount = 0;
+	for (int islandIdx = 0; islandIdx < mIslandSet.getIslandCount(); ++islandIdx)
+	{
+		manifoldCount += mIslandSet.getManifoldCount(islandIdx);
+
+		if (manifoldCount >= cManifoldsPerTask)
+		{
+			mIslandTaskFirstIslands.push_back(islandIdx + 1);
+			manifoldCount = 0;
+		}
+	}
+
+	if (mIslandTaskFirstIslands.back() != mIslandSet.getIslandCount())
+		mIslandTaskFirstIslands.push_back(mIslandSet.getIslandCount());
+}
+
+template<typename Func>
+void P3ConstraintSolver::forEachIsland(Func const &func)
+{
+	int taskCount = static_cast<int>(mIslandTaskFirstIslands.size()) - 1;
+
+	P3::getJobSystem().parallelFor(taskCount, 1, [&](int begin, int end)
+	{
+		for (int islandIdx = mIslandTaskFirstIslands[begin]; islandIdx < mIslandTaskFirstIslands[end]; ++islandIdx)
+		{
+			if (mIslandSet.getManifoldCount(islandIdx))
+				func(islandIdx);
+		}
+	});
+}
+
+void P3ConstraintSolver::gatherSolverBodies( std::vector<LinearTransform> const &linearTransformContainer,
+											 std::vector<AngularTransform> const &angularTransformContainer )
+{
+	int bodyCount = static_cast<int>(linearTransformContainer.size());
+	mSolverBodies.resize(bodyCount);
+
+	if (mIsSplitImpulseEnabled)
+		mPseudoVelocities.assign(bodyCount, P3::PseudoVelocity{ glm::vec3(0.0f), glm::vec3(0.0f) });
 
-				// Solve contact constraint
-				dv = vB + glm::cross(wB, glm::vec3(contact.incidentRelativePosition)) - vA - glm::cross(wA, glm::vec3(contact.referenceRelativePosition));
+	for (int i = 0; i < bodyCount; ++i)
+	{
+		LinearTransform const &linearTransform = linearTransformContainer[i];
+		AngularTransform const &angularTransform = angularTransformContainer[i];
+		P3::SolverBody &solverBody = mSolverBodies[i];
 
-				// Normal impulse
-				float vn = glm::dot(dv, glm::vec3(manifold.contactNormal));
+		// Whatever mass a kinematic body was given, the contacts see it as immovable
+		bool isDynamic = isDynamicBody(linearTransform.flags);
 
-				// Factor in positional bias
-				float lambda = contact.normalTangentMassesBias.x * (-vn + contact.normalTangentMassesBias.w);
+		solverBody.linearVelocity = glm::vec3(linearTransform.velocity);
+		solverBody.inverseMass = isDynamic ? linearTransform.inverseMass : 0.0f;
+		solverBody.angularVelocity = glm::vec3(angularTransform.angularVelocity);
+		solverBody.worldInverseInertia = isDynamic
+			? P3::computeWorldInverseInertia(glm::mat3(angularTransform.inverseInertia), angularTransform.orientation)
+			: P3::SymmetricMat3{};
+		solverBody.flags = linearTransform.flags;
+	}
+}
 
-				// Clamp impulse
-				float tempNormalImpulse = contact.normalTangentBiasImpulses.x;
-				contact.normalTangentBiasImpulses.x = std::max(tempNormalImpulse + lambda, 0.0f);
-				lambda = contact.normalTangentBiasImpulses.x - tempNormalImpulse;
+void P3ConstraintSolver::scatterSolverBodies( std::vector<LinearTransform> &linearTransformContainer,
+											  std::vector<AngularTransform> &angularTransformContainer ) const
+{
+	int bodyCount = static_cast<int>(mSolverBodies.size());
+	for (int i = 0; i < bodyCount; ++i)
+	{
+		if (!mSolverBodies[i].isDynamic())
+			continue;
+
+		linearTransformContainer[i].velocity = glm::vec4(mSolverBodies[i].linearVelocity, 0.0f);
+		angularTransformContainer[i].angularVelocity = glm::vec4(mSolverBodies[i].angularVelocity, 0.0f);
 
-				// Apply impulse
-				glm::vec3 normalImpulse = glm::vec3(manifold.contactNormal) * lambda;
-				vA -= normalImpulse * referenceLinearTransform.inverseMass;
-				wA -= glm::mat3(referenceAngularTransform.inverseInertia) * glm::cross(glm::vec3(contact.referenceRelativePosition), normalImpulse);
+		// The world integrates the final velocities over the whole step, only the difference to the path the
+		//  sub-steps took is applied here
+		if (isSubstepping())
+		{
+			linearTransformContainer[i].position += glm::vec4(mDisplacements[i].linear - mDt * mSolverBodies[i].linearVelocity, 0.0f);
 
-				vB += normalImpulse * incidentLinearTransform.inverseMass;
-				wB += glm::mat3(incidentAngularTransform.inverseInertia) * glm::cross(glm::vec3(contact.incidentRelativePosition), normalImpulse);
+			glm::vec3 angularCorrection = mDisplacements[i].angular - mDt * mSolverBodies[i].angularVelocity;
+			if (angularCorrection != glm::vec3(0.0f))
+			{
+				addScaledVector(angularTransformContainer[i].orientation, angularCorrection, 0.5f);
+				angularTransformContainer[i].orientation = glm::normalize(angularTransformContainer[i].orientation);
 			}
+		}
+
+		// The position correction is applied right away, the integrator only ever sees the real velocities
+		else if (mIsSplitImpulseEnabled)
+		{
+			linearTransformContainer[i].position += glm::vec4(mDt * mPseudoVelocities[i].linear, 0.0f);
 
-			// Directly apply the change in velocities
-			referenceLinearTransform.velocity = glm::vec4(vA, 0.0f);
-			referenceAngularTransform.angularVelocity = glm::vec4(wA, 0.0f);
-			incidentLinearTransform.velocity = glm::vec4(vB, 0.0f);
-			incidentAngularTransform.angularVelocity = glm::vec4(wB, 0.0f);
+			if (mPseudoVelocities[i].angular != glm::vec3(0.0f))
+			{
+				addScaledVector(angularTransformContainer[i].orientation, mPseudoVelocities[i].angular, mDt / 2.0f);
+				angularTransformContainer[i].orientation = glm::normalize(angularTransformContainer[i].orientation);
+			}
 		}
 	}
 }
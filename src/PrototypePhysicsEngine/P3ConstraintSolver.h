@@ -3,13 +3,23 @@
 #ifndef P3_CONSTRAINT_SOLVER
 #define P3_CONSTRAINT_SOLVER
 
+#include <cstdint>
+#include <functional>
 #include <vector>
 
+#include "P3BlockSolver.h"
 #include "P3Common.h"
+#include "P3Island.h"
+#include "P3JobSystem.h"
+#include "P3PhysicsBackend.h"
+#include "P3SolverBody.h"
+#include "P3WideContactSolver.h"
 
 struct AngularTransform;
 struct LinearTransform;
 struct P3BoxCollider;
+struct Contact;
+struct Manifold;
 struct ManifoldGpuPackage;
 
 /**
@@ -19,52 +29,197 @@ struct ManifoldGpuPackage;
  * Much like the collision detection phase, this is also parallelized on the GPU
  *
  * Now, how do I make this configurable? Or what is there to configure?
+ *
+ * On the CPU, the manifolds are colored so that the ones solved in parallel share no dynamic body, or handed
+ *  to the threads an island at a time. The bodies are gathered into a dense P3::SolverBody array indexed like
+ *  the transforms, and the iterations stop early on a residual tolerance. Block, wide, split impulse,
+ *  sub-stepping and shock propagation modes are opt-in, see their setters.
  */
-class P3ConstraintSolver
+class P3ConstraintSolver : public P3::SolverBackend
 {
 public:
+	void init() override {}
+
+	// preSolve then iterativeSolve
+	void solve( ManifoldGpuPackage &,
+				std::vector<LinearTransform> &,
+				std::vector<AngularTransform> &,
+				float ) override;
+
+	// Only while sub-stepping, see setSubstepping
+	bool isApplyingGravity() const override { return isSubstepping(); }
+
 	void preSolve( ManifoldGpuPackage &,
-				   std::vector<LinearTransform> &,
-				   std::vector<AngularTransform> &,
 				   std::vector<LinearTransform> &,
 				   std::vector<AngularTransform> &,
 				   float );
 
 	// Else if on GPU, prob needs to know the handles of ManifoldGpuPackage from init()
 	void iterativeSolve( ManifoldGpuPackage &,
-						 std::vector<LinearTransform> &,
-						 std::vector<AngularTransform> &,
 						 std::vector<LinearTransform> &,
 						 std::vector<AngularTransform> & );
 
+	// Solves 8 manifolds of a color per thread at once, see P3WideContactSolver.h
+	void setWideContactSolve(bool isEnabled) { mIsWideContactSolveEnabled = isEnabled; }
+
+	// Takes over from the colored and wide modes when enabled. Each pile of bodies goes to a thread as a whole and
+	//  is solved like the serial solver would, small ones grouped into one task, and checks its own residual.
+	//  No sync between iterations, but a single big pile runs on one thread.
+	void setIslandSolve(bool isEnabled) { mIsIslandSolveEnabled = isEnabled; }
+
+	P3::IslandSet const &getIslands() const { return mIslandSet; }
+
+	// The normal impulses of manifolds with 2 to 4 points solved together, see P3BlockSolver.h. Only where
+	//  manifolds are solved one at a time, the wide batches stay sequential.
+	void setBlockSolve(bool isEnabled) { mIsBlockSolveEnabled = isEnabled; }
+
+	// Must be set before preSolve. The penetration is no longer a Baumgarte bias of the velocity iterations, a
+	//  position pass after them pushes the bodies apart on pseudo velocities that are then dropped, so pushing out
+	//  adds no energy. The position pass stops early on the same residual tolerance.
+	void setSplitImpulse(bool isEnabled) { mIsSplitImpulseEnabled = isEnabled; }
+	void setPositionIterationCount(int iterationCount) { mPositionIterationCount = iterationCount; }
+
+	// Must be set before preSolve. One last iteration solves the manifolds bottom-up from the ground, the lower
+	//  body of each taken as infinitely heavy, so the support reaches the top of a stack in one pass. Serial, or
+	//  per island in island mode, and not while sub-stepping.
+	void setShockPropagation(bool isEnabled) { mIsShockPropagationEnabled = isEnabled; }
+
+	// Must be set before preSolve. 1 sub-step is the regular solver. TGS: between sub-steps the bodies move and
+	//  the contact separations and biases follow, each sub-step applies gravity, warm starts and ends with a
+	//  relaxation iteration, so the world must leave gravity to the solver. Split impulse and the wide batches
+	//  aren't used. Each sub-step stops early on the residual tolerance too, after at least 1 iteration.
+	void setSubstepping(int substepCount, int iterationsPerSubstep) { mSubstepCount = substepCount; mSubstepIterationCount = iterationsPerSubstep; }
+	bool isSubstepping() const { return mSubstepCount > 1; }
+
+	// Sub-stepping only, applied to the dynamic bodies at the start of every sub-step
+	void setGravity(glm::vec3 const &gravity) { mGravity = gravity; }
+
+	// Never fewer than min iterations nor more than max, whatever the residual. A tolerance of 0 always runs max.
+	void setIterationBounds(P3::IterationBounds const &bounds) override { mIterationBounds = bounds; }
+	void setResidualTolerance(float tolerance) override { mResidualTolerance = tolerance; }
+
+	// Island mode only, called for every island once they are built, getIslands() tells which bodies it holds.
+	//  Lets e.g. a pile the player stands on get more iterations than debris in the distance.
+	void setIslandIterationBounds(std::function<P3::IterationBounds(int islandIdx)> const &func) { mIslandIterationBoundsFunc = func; }
+
+	// Iterations run by the last iterativeSolve, the most of any island in island mode. Sub-steps add theirs up.
+	int getLastIterationCount() const { return mLastIterationCount; }
+
 private:
-	LinearTransform &getLinearTransform( int index,
-										 std::vector<LinearTransform> &rigidLinearTransformContainer,
-										 std::vector<LinearTransform> &staticLinearTransformContainer )
+	// Greedy coloring, each dynamic body keeps a mask of the colors its manifolds already took.
+	//  Static and kinematic bodies never change velocity, so any number of manifolds of one color can share them.
+	void colorManifolds(ManifoldGpuPackage const &);
+
+	// Runs func on every manifold, one color at a time. Templates so the callers' lambdas are never copied to the heap,
+	//  they are only used in the .cpp.
+	template<typename Func>
+	void forEachManifoldByColor(Func const &func);
+
+	// Groups consecutive small islands until each task has enough manifolds to be worth a thread
+	void buildIslandTasks();
+
+	// Runs func on every island with manifolds, islands in parallel
+	template<typename Func>
+	void forEachIsland(Func const &func);
+
+	void gatherSolverBodies( std::vector<LinearTransform> const &,
+							 std::vector<AngularTransform> const & );
+
+	void scatterSolverBodies( std::vector<LinearTransform> &,
+							  std::vector<AngularTransform> & ) const;
+
+	void preSolveManifold( Manifold &,
+						   std::vector<LinearTransform> const &,
+						   float );
+
+	// Returns the largest impulse change applied to a contact of the manifold
+	float solveManifold(Manifold &, P3::NormalBlock const *);
+
+	void solvePositions(ManifoldGpuPackage &);
+
+	// Same as the normal part of solveManifold, on the pseudo velocities and with the penetration as bias
+	float solveManifoldPosition(Manifold &);
+
+	void solveSubsteps(ManifoldGpuPackage &);
+
+	// The manifolds in shock propagation order, grouped like the islands in island mode
+	void orderShockManifolds(ManifoldGpuPackage const &);
+
+	// Like solveManifold, but with the body of the lower layer frozen, if the 2 bodies are in different ones
+	void solveShockManifold(Manifold &, int manifoldIdx);
+
+	// Applies the accumulated impulses of the manifold again
+	void warmStartManifold(Manifold &);
+
+	// Separation part of the biases, from the separations found by the narrow phase plus how far the bodies moved
+	//  since. Without pushing out, penetrating contacts only keep the bodies from closing in further.
+	void updateSubstepBiases(Manifold &, int manifoldIdx, float substepDt, bool isPushingOut);
+
+	void applyExternalForces(int bodyIdx, float substepDt);
+
+	// Moves the bodies by their velocities over a sub-step
+	void integrateDisplacement(int bodyIdx, float substepDt);
+
+	// The contacts of a manifold of the package being solved
+	Contact *getContacts(Manifold const &manifold) const;
+
+	P3::NormalBlock const *getNormalBlock(int manifoldIdx) const
 	{
-		if (index >= rigidLinearTransformContainer.size())
-		{
-			return staticLinearTransformContainer[index - rigidLinearTransformContainer.size()];
-		}
-		else
-		{
-			return rigidLinearTransformContainer[index];
-		}
+		return mIsBlockSolveEnabled && mNormalBlocks[manifoldIdx].contactCount ? &mNormalBlocks[manifoldIdx] : nullptr;
 	}
 
-	AngularTransform &getAngularTransform( int index,
-										   std::vector<AngularTransform> &rigidAngularTransformContainer,
-										   std::vector<AngularTransform> &staticAngularTransformContainer )
+	bool hasConverged(int iterationCount, float residual, P3::IterationBounds const &bounds) const
 	{
-		if (index >= rigidAngularTransformContainer.size())
-		{
-			return staticAngularTransformContainer[index - rigidAngularTransformContainer.size()];
-		}
-		else
-		{
-			return rigidAngularTransformContainer[index];
-		}
+		return iterationCount >= bounds.maxIterationCount
+			|| (iterationCount >= bounds.minIterationCount && residual <= mResidualTolerance);
 	}
+
+	std::vector<P3::SolverBody> mSolverBodies; // Same indices as the transforms
+	ManifoldGpuPackage *mpManifoldPkg = nullptr; // Set by preSolve and iterativeSolve
+
+	P3::IterationBounds mIterationBounds{ 4, 100 };
+	float mResidualTolerance = 1e-4f;
+	int mLastIterationCount = 0;
+	std::vector<float> mResiduals; // Per manifold, or per wide batch, so threads never write the same slot
+
+	std::vector<P3::NormalBlock> mNormalBlocks; // Per manifold, 0 contacts for the ones solved sequentially
+	bool mIsBlockSolveEnabled = false;
+
+	std::vector<P3::PseudoVelocity> mPseudoVelocities; // Same indices as the solver bodies
+	int mPositionIterationCount = 4;
+	bool mIsSplitImpulseEnabled = false;
+	float mDt = 0.0f;
+
+	// Per manifold, what the sub-steps need to recompute the biases
+	struct SubstepContacts
+	{
+		float separations[cMaxManifoldContactCount]; // At the start of the step
+		float restitutionBiases[cMaxManifoldContactCount];
+	};
+
+	std::vector<int> mBodyLayers;
+	std::vector<int> mShockManifoldIndices;
+	bool mIsShockPropagationEnabled = false;
+
+	std::vector<SubstepContacts> mSubstepContacts;
+	std::vector<P3::Displacement> mDisplacements; // Same indices as the solver bodies
+	int mSubstepCount = 1;
+	int mSubstepIterationCount = 1;
+	glm::vec3 mGravity{ 0.0f, -9.8f, 0.0f };
+
+	std::vector<std::vector<int>> mColorManifoldIndices;
+	std::vector<int> mUncoloredManifoldIndices; // Bodies in more manifolds than there are colors, solved serially
+	std::vector<uint64_t> mBodyColorMasks;
+
+	P3::WideContactSolver mWideContactSolver;
+	bool mIsWideContactSolveEnabled = false;
+
+	P3::IslandSet mIslandSet;
+	std::vector<int> mIslandTaskFirstIslands; // One past the end for the last task
+	std::vector<P3::IterationBounds> mIslandIterationBounds;
+	std::vector<int> mIslandIterationCounts;
+	std::function<P3::IterationBounds(int)> mIslandIterationBoundsFunc;
+	bool mIsIslandSolveEnabled = false;
 };
 
 #endif // P3_CONSTRAINT_SOLVER
\ No newline at end of file
@@ -2,123 +2,99 @@
 
 #include <algorithm>
 #include <limits>
-#include <map>
 
 #include "P3Common.h"
+#include "P3JobSystem.h"
+
+constexpr int cBoxesPerTask = 64;
 
 namespace P3
 {
-CollisionPairGpuPackage *CpuBroadPhase::step(std::vector<P3BoxCollider> const &boxColliderContainer)
+CollisionPairGpuPackage *CpuBroadPhase::step( std::vector<P3BoxCollider> const &boxColliderContainer,
+											  std::vector<glm::vec3> const &sweeps )
 {
-	std::map<int, Aabb> aabbMap;
+	int boxCount = static_cast<int>(boxColliderContainer.size());
+	int sweepCount = static_cast<int>(sweeps.size());
+	mAabbs.resize(boxCount);
 
 	// Update Aabbs
-	for (int i = 0; i < boxColliderContainer.size(); ++i)
+	getJobSystem().parallelFor(boxCount, cBoxesPerTask, [&](int begin, int end)
 	{
-		P3BoxCollider const &boxCollider = boxColliderContainer[i];
-
-		float minX, minY, minZ;
-		float maxX, maxY, maxZ;
-
-		minX = minY = minZ = std::numeric_limits<float>::max();
-		maxX = maxY = maxZ = std::numeric_limits<float>::lowest();
-
-		// Go through all vertices of each box collider
-		for (int j = 0; j < cBoxColliderVertCount; ++j)
+		for (int i = begin; i < end; ++i)
 		{
-			minX = std::min(minX, boxCollider[j].x);
-			maxX = std::max(maxX, boxCollider[j].x);
+			P3BoxCollider const &boxCollider = boxColliderContainer[i];
 
-			minY = std::min(minY, boxCollider[j].y);
-			maxY = std::max(maxY, boxCollider[j].y);
+			float minX, minY, minZ;
+			float maxX, maxY, maxZ;
 
-			minZ = std::min(minZ, boxCollider[j].z);
-			maxZ = std::max(maxZ, boxCollider[j].z);
-		}
+			minX = minY = minZ = std::numeric_limits<float>::max();
+			maxX = maxY = maxZ = std::numeric_limits<float>::lowest();
 
-		// Store the results - maybe we don't have to recalculate every frame
-		aabbMap[i] = Aabb(glm::vec4(minX, minY, minZ, i), glm::vec4(maxX, maxY, maxZ, i));
-	}
+			// Go through all vertices of each box collider
+			for (int j = 0; j < cBoxColliderVertCount; ++j)
+			{
+				minX = std::min(minX, boxCollider[j].x);
+				maxX = std::max(maxX, boxCollider[j].x);
 
-	// Sorting in x - PROBLEM IS YOU CAN'T REALLY SORT A MAP, THERE ARE HACKY WAYS TO DO IT THOUGH.
-	//std::sort(aabbMap.begin(), aabbMap.end(), [](std::pair<int, Aabb> const &a, std::pair<int, Aabb> const &b)
-	//	{
-	//		return a.second.mMinCoord.x < b.second.mMinCoord.x;
-	//	}
-	//);
+				minY = std::min(minY, boxCollider[j].y);
+				maxY = std::max(maxY, boxCollider[j].y);
 
-	// Sweep
-	int sweepXIdx = 0;
-	for (auto i = aabbMap.begin(); i != aabbMap.end(); ++i)
-	{
-		for (auto j = aabbMap.begin(); j != aabbMap.end(); ++j)
-		{
-			if (i == j) continue;
+				minZ = std::min(minZ, boxCollider[j].z);
+				maxZ = std::max(maxZ, boxCollider[j].z);
+			}
 
-			if (i->second.mMinCoord.x < j->second.mMaxCoord.x && i->second.mMaxCoord.x > j->second.mMinCoord.x)
+			if (i < sweepCount)
 			{
-				// For sweep x axis, we use x and y comps of collisionPkg to store the 2 indices.
-				(*mpCollisionPairPkg)[sweepXIdx].x = i->first;
-				(*mpCollisionPairPkg)[sweepXIdx++].y = j->first;
+				minX += std::min(0.0f, sweeps[i].x);
+				minY += std::min(0.0f, sweeps[i].y);
+				minZ += std::min(0.0f, sweeps[i].z);
+
+				maxX += std::max(0.0f, sweeps[i].x);
+				maxY += std::max(0.0f, sweeps[i].y);
+				maxZ += std::max(0.0f, sweeps[i].z);
 			}
+
+			mAabbs[i] = Aabb(glm::vec4(minX, minY, minZ, i), glm::vec4(maxX, maxY, maxZ, i));
 		}
-	}
+	});
 
-	// Sort in y
-	//std::sort(aabbMap.begin(), aabbMap.end(), [](Aabb const &a, Aabb const &b)
-	//	{
-	//		return a.mMinCoord.y < b.mMinCoord.y;
-	//	}
-	//);
+	// Every box against every other one, on x, then y, then z. Each range of boxes gets its own list of pairs,
+	//  and the lists are put together in order, so the pairs come out the same whatever the thread count.
+	//  Each pair is found once, by its lower index, and stored with the higher index first.
+	mTaskPairs.resize((boxCount + cBoxesPerTask - 1) / cBoxesPerTask);
 
-	// Sweep
-	int sweepYIdx = 0;
-	for (int collisionPairIdx = 0; collisionPairIdx < sweepXIdx; ++collisionPairIdx)
+	getJobSystem().parallelFor(boxCount, cBoxesPerTask, [&](int begin, int end)
 	{
-		Aabb aabb_1 = aabbMap[(*mpCollisionPairPkg)[collisionPairIdx].x];
-		Aabb aabb_2 = aabbMap[(*mpCollisionPairPkg)[collisionPairIdx].y];
+		std::vector<glm::ivec2> &pairs = mTaskPairs[begin / cBoxesPerTask];
+		pairs.clear();
 
-		if (aabb_1.mMinCoord.y < aabb_2.mMaxCoord.y && aabb_1.mMaxCoord.y > aabb_2.mMinCoord.y)
+		for (int i = begin; i < end; ++i)
 		{
-			// For sweep y axis, we use z and w comps of collisionPkg to store the 2 indices.
-			(*mpCollisionPairPkg)[sweepYIdx].z = int(aabb_1.mMinCoord.w); // w comp stores object ID
-			(*mpCollisionPairPkg)[sweepYIdx++].w = int(aabb_2.mMinCoord.w);
-		}
-	}
+			Aabb const &aabb_1 = mAabbs[i];
 
-	// Sort in z
-	//std::sort(aabbMap.begin(), aabbMap.end(), [](Aabb const &a, Aabb const &b)
-	//	{
-	//		return a.mMinCoord.z < b.mMinCoord.z;
-	//	}
-	//);
+			for (int j = i + 1; j < boxCount; ++j)
+			{
+				Aabb const &aabb_2 = mAabbs[j];
+
+				if (   aabb_1.mMinCoord.x < aabb_2.mMaxCoord.x && aabb_1.mMaxCoord.x > aabb_2.mMinCoord.x
+					&& aabb_1.mMinCoord.y < aabb_2.mMaxCoord.y && aabb_1.mMaxCoord.y > aabb_2.mMinCoord.y
+					&& aabb_1.mMinCoord.z < aabb_2.mMaxCoord.z && aabb_1.mMaxCoord.z > aabb_2.mMinCoord.z )
+				{
+					pairs.emplace_back(j, i);
+				}
+			}
+		}
+	});
 
-	// Sweep
-	int sweepZIdx = 0;
-	for (int collisionPairIdx = 0; collisionPairIdx < sweepYIdx; ++collisionPairIdx)
+	mpCollisionPairPkg->clear();
+	for (std::vector<glm::ivec2> const &pairs : mTaskPairs)
 	{
-		Aabb aabb_1 = aabbMap[(*mpCollisionPairPkg)[collisionPairIdx].z];
-		Aabb aabb_2 = aabbMap[(*mpCollisionPairPkg)[collisionPairIdx].w];
-
-		if (aabb_1.mMinCoord.z < aabb_2.mMaxCoord.z && aabb_1.mMaxCoord.z > aabb_2.mMinCoord.z)
+		for (glm::ivec2 const &pair : pairs)
 		{
-			// Finally, for sweep z axis, we back use x and y comps of collisionPkg to store the 2 indices.
-			// Also sort ID for consistency
-			if (aabb_1.mMinCoord.w < aabb_2.mMinCoord.w)
-			{
-				(*mpCollisionPairPkg)[sweepZIdx].x = int(aabb_2.mMinCoord.w); // w comp stores object ID
-				(*mpCollisionPairPkg)[sweepZIdx++].y = int(aabb_1.mMinCoord.w);
-			}
-			else
-			{
-				(*mpCollisionPairPkg)[sweepZIdx].x = int(aabb_1.mMinCoord.w); // w comp stores object ID
-				(*mpCollisionPairPkg)[sweepZIdx++].y = int(aabb_2.mMinCoord.w);
-			}
+			mpCollisionPairPkg->add(pair.x, pair.y);
 		}
 	}
 
-	mpCollisionPairPkg->misc.x = sweepZIdx;
-
 	return mpCollisionPairPkg;
 }
-}
\ No newline at end of file
+}
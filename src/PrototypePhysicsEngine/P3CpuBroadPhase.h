@@ -7,21 +7,29 @@
 
 #include "P3BroadPhaseCommon.h"
 #include "P3Collider.h"
+#include "P3PhysicsBackend.h"
 
 namespace P3
 {
-class CpuBroadPhase
+class CpuBroadPhase : public BroadPhaseBackend
 {
 public:
-	void init() { mpCollisionPairPkg = new CollisionPairGpuPackage(); }
-	CollisionPairGpuPackage *step(std::vector<P3BoxCollider> const &);
+	void init() override { mpCollisionPairPkg = new CollisionPairGpuPackage(); }
+	// Each Aabb is stretched over the sweep of its box, i.e. its displacement over the coming step, so fast boxes
+	//  also pair up with what they are about to hit. Boxes past the end of the sweeps don't move. The boxes are
+	//  split into ranges on the job system.
+	CollisionPairGpuPackage *step( std::vector<P3BoxCollider> const &,
+								   std::vector<glm::vec3> const & = std::vector<glm::vec3>() ) override;
 
-	CollisionPairGpuPackage const *getPCollisionPkg() const { return mpCollisionPairPkg; }
+	CollisionPairGpuPackage const *getPCollisionPairPkg() const override { return mpCollisionPairPkg; }
 
 	~CpuBroadPhase() { delete mpCollisionPairPkg; }
 
 private:
-	CollisionPairGpuPackage *mpCollisionPairPkg;
+	CollisionPairGpuPackage *mpCollisionPairPkg = nullptr;
+
+	std::vector<Aabb> mAabbs; // Per box
+	std::vector<std::vector<glm::ivec2>> mTaskPairs;
 };
 }
 
@@ -1,9 +1,19 @@
 #include "P3CpuNarrowPhase.h"
 
+#include <algorithm>
+
+#include "P3BroadPhaseCommon.h"
+#include "P3Collider.h"
+#include "P3JobSystem.h"
+#include "P3MeshContact.h"
 #include "P3Sat.h"
+#include "P3TriangleMeshCollider.h"
+#include "P3TriTriBatch.h"
 
 #define EPSILON 0.000001f
 
+constexpr unsigned int cNodePairsPerThread = 8u; // Subtrees per thread, so uneven subtrees still balance out
+
 // We are going old school
 #define ISECT(projVert0, projVert1, projVert2, distVert0, distVert1, distVert2, isectStart, isectEnd)	\
 			  isectStart = projVert0 + (projVert1 - projVert0) * distVert0/(distVert0 - distVert1);		\
@@ -17,11 +27,35 @@
 				b = c;		\
 			}
 
-// Test for intersection between coplanar triangles
+// Test for intersection between coplanar triangles. Project both onto the axis-aligned plane where
+//  they have the largest area, then test their edges against each other, then test for containment.
 bool coplanarTriTriTest(glm::vec3 const &v0, glm::vec3 const &v1, glm::vec3 const &v2,
 	glm::vec3 const &u0, glm::vec3 const &u1, glm::vec3 const &u2,
 	glm::vec3 const &N1)
 {
+	glm::vec3 absN1 = glm::abs(N1);
+	int i0 = 0, i1 = 1; // Projection axes
+
+	if (absN1.x > absN1.y)
+	{
+		if (absN1.x > absN1.z) i0 = 1, i1 = 2; // x is the largest
+		else i0 = 0, i1 = 1;                   // z is the largest
+	}
+	else
+	{
+		if (absN1.z > absN1.y) i0 = 0, i1 = 1; // z is the largest
+		else i0 = 0, i1 = 2;                   // y is the largest
+	}
+
+	// Test all edges of the first triangle against the edges of the second triangle
+	if (edgeTriTest(v0, v1, u0, u1, u2, i0, i1)) return true;
+	if (edgeTriTest(v1, v2, u0, u1, u2, i0, i1)) return true;
+	if (edgeTriTest(v2, v0, u0, u1, u2, i0, i1)) return true;
+
+	// No edges intersect, one triangle can still be totally contained in the other
+	if (pointInTriTest(v0, u0, u1, u2, i0, i1)) return true;
+	if (pointInTriTest(u0, v0, v1, v2, i0, i1)) return true;
+
 	return false;
 }
 
@@ -167,38 +201,249 @@ void computeIntersectInterval(float projVert0, float projVert1, float projVert2,
 	// Triangle is coplanar to the plane.
 	else
 	{
-		isCoplanar = false;
+		isCoplanar = true;
 	}
 }
 
-// Edge to edge test
+// Edge to edge test, edge (v0, v0 + edge) against edge (u0, u1)
 // Reference: Franlin Antonio's "Faster Line Segment Intersection"
 //            in Graphics Gem III pg 199-202
-bool edgeEdgeTest(glm::vec3 const &v0, glm::vec3 const &u0, glm::vec3 const &u1)
+bool edgeEdgeTest(glm::vec3 const &v0, glm::vec3 const &edge, glm::vec3 const &u0, glm::vec3 const &u1, int i0, int i1)
 {
+	float Ax = edge[i0];
+	float Ay = edge[i1];
+	float Bx = u0[i0] - u1[i0];
+	float By = u0[i1] - u1[i1];
+	float Cx = v0[i0] - u0[i0];
+	float Cy = v0[i1] - u0[i1];
+
+	float f = Ay * Bx - Ax * By;
+	float d = By * Cx - Bx * Cy;
+
+	if ((f > 0.0f && d >= 0.0f && d <= f) || (f < 0.0f && d <= 0.0f && d >= f))
+	{
+		float e = Ax * Cy - Ay * Cx;
+
+		if (f > 0.0f)
+			return e >= 0.0f && e <= f;
+		else
+			return e <= 0.0f && e >= f;
+	}
+
 	return false;
 }
 
+// Edge (v0, v1) against all 3 edges of triangle (u0, u1, u2)
 bool edgeTriTest(glm::vec3 const &v0, glm::vec3 const &v1,
-	glm::vec3 const &u0, glm::vec3 const &u1, glm::vec3 const &u2)
+	glm::vec3 const &u0, glm::vec3 const &u1, glm::vec3 const &u2,
+	int i0, int i1)
 {
-	return false;
+	glm::vec3 edge = v1 - v0;
+
+	return edgeEdgeTest(v0, edge, u0, u1, i0, i1)
+		|| edgeEdgeTest(v0, edge, u1, u2, i0, i1)
+		|| edgeEdgeTest(v0, edge, u2, u0, i0, i1);
 }
 
-// TODO: Isn't this just barycentric coord test?
+// Is v0 on the same side of all 3 edges of triangle (u0, u1, u2)
 bool pointInTriTest(glm::vec3 const &v0,
-	glm::vec3 const &u0, glm::vec3 const &u1, glm::vec3 const &u2)
+	glm::vec3 const &u0, glm::vec3 const &u1, glm::vec3 const &u2,
+	int i0, int i1)
 {
-	return false;
+	glm::vec3 const *pTriangle[3] = { &u0, &u1, &u2 };
+	float signedDists[3];
+
+	for (int i = 0; i < 3; ++i)
+	{
+		glm::vec3 const &start = *pTriangle[i];
+		glm::vec3 const &end   = *pTriangle[(i + 1) % 3];
+
+		float a = end[i1] - start[i1];
+		float b = -(end[i0] - start[i0]);
+		float c = -a * start[i0] - b * start[i1];
+
+		signedDists[i] = a * v0[i0] + b * v0[i1] + c;
+	}
+
+	return signedDists[0] * signedDists[1] > 0.0f && signedDists[0] * signedDists[2] > 0.0f;
 }
 
 namespace P3
 {
+void CpuNarrowPhase::init()
+{
+	mpManifoldPkg[0] = new ManifoldGpuPackage();
+	mpManifoldPkg[1] = new ManifoldGpuPackage();
+	mpBoxColliderPkg = new BoxColliderGpuPackage();
+}
+
+CpuNarrowPhase::~CpuNarrowPhase()
+{
+	delete mpManifoldPkg[0];
+	delete mpManifoldPkg[1];
+	delete mpBoxColliderPkg;
+}
+
+// Both buffers, the back one is what the next step warm starts from and the front one what was last rendered
+void CpuNarrowPhase::onBodyRemoved(int bodyIdx)
+{
+	for (ManifoldGpuPackage *pManifoldPkg : mpManifoldPkg)
+	{
+		if (pManifoldPkg) pManifoldPkg->removeBody(bodyIdx);
+	}
+}
+
+void CpuNarrowPhase::onBodyMoved(int fromBodyIdx, int toBodyIdx)
+{
+	for (ManifoldGpuPackage *pManifoldPkg : mpManifoldPkg)
+	{
+		if (pManifoldPkg) pManifoldPkg->moveBody(fromBodyIdx, toBodyIdx);
+	}
+}
+
+ManifoldGpuPackage *CpuNarrowPhase::step( std::vector<P3BoxCollider> const &boxColliders,
+										  CollisionPairGpuPackage const *pCollisionPairPkg,
+										  std::vector<glm::vec3> const &sweeps )
+{
+	int boxCount = static_cast<int>(boxColliders.size());
+	mpBoxColliderPkg->resize(boxCount);
+
+	for (int i = 0; i < boxCount; ++i)
+	{
+		for (int j = 0; j < cBoxColliderVertCount; ++j)
+		{
+			(*mpBoxColliderPkg)[i][j] = boxColliders[i].mVertices[j];
+		}
+	}
+
+	return step(*mpBoxColliderPkg, pCollisionPairPkg, sweeps);
+}
+
+ManifoldGpuPackage *CpuNarrowPhase::stepTriangleMeshes( std::vector<int> const &dynamicBoxIndices,
+														std::vector<TriangleMeshCollider> const &meshColliders,
+														std::vector<int> const &meshBodyIndices )
+{
+	return stepTriangleMeshes(*mpBoxColliderPkg, dynamicBoxIndices, meshColliders, meshBodyIndices);
+}
+
 ManifoldGpuPackage *CpuNarrowPhase::step( BoxColliderGpuPackage const &boxColliderPkg,
-										  const CollisionPairGpuPackage *pCollisionPairPkg )
+										  const CollisionPairGpuPackage *pCollisionPairPkg,
+										  std::vector<glm::vec3> const &sweeps )
 {
-	sat(mpManifoldPkg[mFrontBufferIdx], mpManifoldPkg[!mFrontBufferIdx], boxColliderPkg, pCollisionPairPkg);
+	sat(mpManifoldPkg[mFrontBufferIdx], mpManifoldPkg[!mFrontBufferIdx], boxColliderPkg, pCollisionPairPkg, sweeps);
 
 	return mpManifoldPkg[mFrontBufferIdx];
 }
-}
\ No newline at end of file
+
+ManifoldGpuPackage *CpuNarrowPhase::stepTriangleMeshes( BoxColliderGpuPackage const &boxColliderPkg,
+														std::vector<int> const &dynamicBoxIndices,
+														std::vector<TriangleMeshCollider> const &meshColliders,
+														std::vector<int> const &meshBodyIndices )
+{
+	collideTriangleMeshes( mpManifoldPkg[mFrontBufferIdx], mpManifoldPkg[!mFrontBufferIdx],
+						   boxColliderPkg, dynamicBoxIndices, meshColliders, meshBodyIndices );
+
+	return mpManifoldPkg[mFrontBufferIdx];
+}
+
+std::vector<glm::ivec2> findIntersectingTriangles( TriangleMeshCollider const &meshColliderA, glm::mat4 const &modelA,
+												   TriangleMeshCollider const &meshColliderB, glm::mat4 const &modelB )
+{
+	std::vector<glm::ivec2> intersectingTriangles;
+	Bvh const &bvhA = meshColliderA.getBvh();
+	Bvh const &bvhB = meshColliderB.getBvh();
+
+	if (bvhA.isEmpty() || bvhB.isEmpty()) return intersectingTriangles;
+
+	// Work in the model space of A, so only the vertices of B have to be transformed
+	glm::mat4 bToA = glm::inverse(modelA) * modelB;
+
+	unsigned int threadCount = getJobSystem().getThreadCount();
+
+	// Split the traversal into independent node pairs, breadth first, until there's enough of them to go around
+	std::vector<glm::ivec2> nodePairs{ glm::ivec2(0) };
+	std::vector<glm::ivec2> nextNodePairs;
+	bool canExpand = true;
+
+	while (canExpand && nodePairs.size() < cNodePairsPerThread * threadCount)
+	{
+		canExpand = false;
+		nextNodePairs.clear();
+
+		for (glm::ivec2 const &nodePair : nodePairs)
+		{
+			BvhNode const &nodeA = bvhA.getNodes()[nodePair.x];
+			BvhNode const &nodeB = bvhB.getNodes()[nodePair.y];
+
+			if (!overlaps(nodeA.bounds, transformAabb(nodeB.bounds, bToA))) continue;
+
+			int childCountA = nodeA.isLeaf() ? 1 : 2;
+			int childCountB = nodeB.isLeaf() ? 1 : 2;
+			int firstChildA = nodeA.isLeaf() ? nodePair.x : nodeA.leftOrFirst;
+			int firstChildB = nodeB.isLeaf() ? nodePair.y : nodeB.leftOrFirst;
+
+			canExpand |= childCountA * childCountB > 1;
+
+			for (int i = 0; i < childCountA; ++i)
+			{
+				for (int j = 0; j < childCountB; ++j)
+				{
+					nextNodePairs.emplace_back(firstChildA + i, firstChildB + j);
+				}
+			}
+		}
+
+		nodePairs.swap(nextNodePairs);
+	}
+
+	// Each range of node pairs keeps its own results, merged at the end in order
+	std::vector<std::vector<glm::ivec2>> rangeResults(nodePairs.size());
+
+	getJobSystem().parallelFor(static_cast<int>(nodePairs.size()), 1, [&](int begin, int end)
+	{
+		std::vector<glm::ivec2> &results = rangeResults[begin];
+
+		// Candidate pairs are buffered, then tested 8 at a time
+		TriTriBatch batch;
+		auto flush = [&]()
+		{
+			unsigned int hitMask = fastTriTriIntersect3DTestBatch(batch);
+
+			for (int lane = 0; lane < batch.count; ++lane)
+			{
+				if (hitMask & (1u << lane)) results.push_back(batch.pairIds[lane]);
+			}
+
+			batch.clear();
+		};
+
+		for (int i = begin; i < end; ++i)
+		{
+			queryPairs(bvhA, bvhB, bToA, nodePairs[i].x, nodePairs[i].y, [&](int triangleIdxA, int triangleIdxB)
+				{
+					glm::vec3 u0 = bToA * glm::vec4(meshColliderB.getVertex(triangleIdxB, 0), 1.0f);
+					glm::vec3 u1 = bToA * glm::vec4(meshColliderB.getVertex(triangleIdxB, 1), 1.0f);
+					glm::vec3 u2 = bToA * glm::vec4(meshColliderB.getVertex(triangleIdxB, 2), 1.0f);
+
+					if (batch.push( meshColliderA.getVertex(triangleIdxA, 0),
+									meshColliderA.getVertex(triangleIdxA, 1),
+									meshColliderA.getVertex(triangleIdxA, 2),
+									u0, u1, u2, glm::ivec2(triangleIdxA, triangleIdxB) ))
+					{
+						flush();
+					}
+				}
+			);
+		}
+
+		if (!batch.isEmpty()) flush();
+	});
+
+	for (std::vector<glm::ivec2> const &results : rangeResults)
+	{
+		intersectingTriangles.insert(intersectingTriangles.end(), results.begin(), results.end());
+	}
+
+	return intersectingTriangles;
+}
+}
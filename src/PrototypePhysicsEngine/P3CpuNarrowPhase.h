@@ -14,8 +14,11 @@
 #define P3_CPU_NARROW_PHASE_H
 
 #include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+#include <vector>
 
 #include "P3NarrowPhaseCommon.h"
+#include "P3PhysicsBackend.h"
 
 struct BoxColliderGpuPackage;
 struct CollisionPairGpuPackage;
@@ -33,40 +36,63 @@ void computeIntersectInterval(float, float, float,
 							  float, float,
 							  float &, float &, bool &);
 
-bool edgeEdgeTest(glm::vec3 const &, glm::vec3 const &, glm::vec3 const &);
-bool edgeTriTest(glm::vec3 const &, glm::vec3 const &, glm::vec3 const &, glm::vec3 const &);
-bool pointInTriTest(glm::vec3 const &, glm::vec3 const &, glm::vec3 const &, glm::vec3 const &);
+// Helpers of the coplanar test, they work on the 2D projection onto the axes i0 and i1
+bool edgeEdgeTest(glm::vec3 const &, glm::vec3 const &, glm::vec3 const &, glm::vec3 const &, int, int);
+bool edgeTriTest(glm::vec3 const &, glm::vec3 const &,
+				 glm::vec3 const &, glm::vec3 const &, glm::vec3 const &,
+				 int, int);
+bool pointInTriTest(glm::vec3 const &, glm::vec3 const &, glm::vec3 const &, glm::vec3 const &, int, int);
 
 
 namespace P3
 {
-class CpuNarrowPhase
+class TriangleMeshCollider;
+
+// Every intersecting (triangleIdxA, triangleIdxB) pair of 2 meshes, each built in its own model space. Only the triangles
+//  of overlapping BVH leaves get tested. The traversal is split into jobs, see P3JobSystem.h.
+std::vector<glm::ivec2> findIntersectingTriangles( TriangleMeshCollider const &, glm::mat4 const &,
+												   TriangleMeshCollider const &, glm::mat4 const & );
+
+class CpuNarrowPhase : public NarrowPhaseBackend
 {
 public:
-	void init()
-	{
-		mpManifoldPkg[0] = new ManifoldGpuPackage();
-		mpManifoldPkg[1] = new ManifoldGpuPackage();
-	}
+	void init() override;
+
+	// Packs the box colliders for the overload below, and keeps them for stepTriangleMeshes
+	ManifoldGpuPackage *step( std::vector<P3BoxCollider> const &, CollisionPairGpuPackage const *,
+							  std::vector<glm::vec3> const & ) override;
+
+	ManifoldGpuPackage *stepTriangleMeshes( std::vector<int> const &, std::vector<TriangleMeshCollider> const &,
+											std::vector<int> const & ) override;
 
-	ManifoldGpuPackage *step(BoxColliderGpuPackage const &, const CollisionPairGpuPackage *);
+	// Sweeps are the displacements of the boxes over the coming step, for speculative contacts. See P3::sat
+	ManifoldGpuPackage *step( BoxColliderGpuPackage const &, const CollisionPairGpuPackage *,
+							  std::vector<glm::vec3> const & = std::vector<glm::vec3>() );
 
-	ManifoldGpuPackage *getPManifoldPkg() { return mpManifoldPkg[mFrontBufferIdx]; }
+	// Must be called after step(), box-triangle manifolds are appended after the box-box ones
+	ManifoldGpuPackage *stepTriangleMeshes( BoxColliderGpuPackage const &, std::vector<int> const &,
+											std::vector<TriangleMeshCollider> const &, std::vector<int> const & );
+
+	ManifoldGpuPackage *getPManifoldPkg() override { return mpManifoldPkg[mFrontBufferIdx]; }
 	ManifoldGpuPackage *getPBackManifoldPkg() { return mpManifoldPkg[!mFrontBufferIdx]; }
+	ManifoldGpuPackage const *getPBackManifoldPkg() const { return mpManifoldPkg[!mFrontBufferIdx]; }
+
+	// The back buffer is the last step's manifolds once swapped
+	ManifoldGpuPackage *getPWarmStartCache() override { return getPBackManifoldPkg(); }
 
-	void swapBuffers()
+	void swapBuffers() override
 	{
 		mFrontBufferIdx = !mFrontBufferIdx;
 	}
 
-	~CpuNarrowPhase()
-	{
-		delete mpManifoldPkg[0];
-		delete mpManifoldPkg[1];
-	}
+	void onBodyRemoved(int bodyIdx) override;
+	void onBodyMoved(int fromBodyIdx, int toBodyIdx) override;
+
+	~CpuNarrowPhase();
 
 private:
-	ManifoldGpuPackage *mpManifoldPkg[2];
+	ManifoldGpuPackage *mpManifoldPkg[2]{};
+	BoxColliderGpuPackage *mpBoxColliderPkg = nullptr;
 
 	int mFrontBufferIdx = 0;
 };
@@ -7,6 +7,10 @@
 
 #include "P3DynamicsWorld.h"
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
 #include <ctime>
 #include <iostream>
 
@@ -14,98 +18,181 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 
+#include "P3Ccd.h"
+#include "P3JobSystem.h"
 #include "P3Simplex.h"
 #include "P3Sat.h"
 
+constexpr float cCcdPenetrationSlop = 0.02f;
+constexpr float cCcdSkinWidth = 0.05f; // Swept boxes are shrunk by this, so resting contacts and seams don't stop them
+constexpr int cCcdMaxSubstepCount = 4; // Hits a CCD body can slide off of in one step
+
+// Bodies that moved less than this since the checkpoint base stay out of the deltas
+constexpr float cCheckpointPositionTolerance = 1e-3f;
+constexpr float cCheckpointOrientationTolerance = 1e-5f; // On 1 - |cos| of half the angle between the orientations
+
 float randf()
 {
 	return rand() / float(RAND_MAX);
 }
 
+void P3DynamicsWorld::setBackends(P3::Backends &&backends)
+{
+	mBackends = std::move(backends);
+
+	mpBroadPhase = mBackends.pBroadPhase ? mBackends.pBroadPhase.get() : &mCpuBroadPhase;
+	mpNarrowPhase = mBackends.pNarrowPhase ? mBackends.pNarrowPhase.get() : &mCpuNarrowPhase;
+	mpSolver = mBackends.pSolver ? mBackends.pSolver.get() : &mConstraintSolver;
+
+	// Rebuilt on the next step, which stages are bound to the calling thread may have changed
+	mStepGraph.clear();
+	mCollisionGraph.clear();
+	mDynamicsGraph.clear();
+	mMultipleBoxesStepGraph.clear();
+	mMultipleBoxesGraph.clear();
+}
+
+// In pipeline order, a stage may take the buffers of the one before
 void P3DynamicsWorld::init()
 {
-	mGpuBroadPhase.init();
-	mCpuBroadPhase.init();
-	mCpuNarrowPhase.init();
-	mGpuNarrowPhase.init(mGpuBroadPhase.getBoxCollidersID(), mGpuBroadPhase.getCollisionPairsID());
-	mOglConstraintSolver.init(mGpuNarrowPhase.getManifoldBufferID());
+	mpBroadPhase->init();
+	mpNarrowPhase->init();
+	mpSolver->init();
 }
 
-void P3DynamicsWorld::detectCollisions()
+void P3DynamicsWorld::detectCollisions(float dt)
 {
-#ifdef BROAD_PHASE_CPU
-	mCpuBroadPhase.step(mBoxColliderContainer);
-#else
-	mGpuBroadPhase.betterStep(mBoxColliderContainer);
-#endif // BROAD_PHASE_CPU
+	// The graphs are only built once, their tasks read the time step from the world
+	if (!mCollisionGraph.size())
+		addCollisionTasks(mCollisionGraph, -1);
 
-#ifdef NARROW_PHASE_CPU
-	BoxColliderGpuPackage boxColliderPkg;
-	for (int i = 0; i < mBoxColliderContainer.size(); ++i)
+	mStepDt = dt;
+	P3::getJobSystem().run(mCollisionGraph);
+}
+
+void P3DynamicsWorld::step(float dt)
+{
+	if (!mStepGraph.size())
 	{
-		for (int j = 0; j < cBoxColliderVertCount; ++j)
-		{
-			boxColliderPkg.boxColliders[i][j] = mBoxColliderContainer[i].mVertices[j];
-		}
+		int collisionTaskIdx = addCollisionTasks(mStepGraph, -1);
+		addDynamicsTasks(mStepGraph, collisionTaskIdx);
 	}
 
-#ifdef BROAD_PHASE_CPU
-	mpManifoldPkg = mCpuNarrowPhase.step(boxColliderPkg, mCpuBroadPhase.getPCollisionPkg());
-#else
-	mpManifoldPkg = mCpuNarrowPhase.step(boxColliderPkg, mGpuBroadPhase.getPCollisionPairPkg());
-#endif // BROAD_PHASE_CPU
+	mStepDt = dt;
+	P3::getJobSystem().run(mStepGraph);
+}
 
-#else
+int P3DynamicsWorld::addCollisionTasks(P3::TaskGraph &graph, int dependencyIdx)
+{
+	// Displacement of every box over the coming step, the static ones have no velocity so don't move
+	int sweepTaskIdx = graph.addTask([this]
+	{
+		mSweeps.clear();
+		if (mIsSpeculativeContactEnabled)
+		{
+			for (size_t i = 0; i < mBoxColliderContainer.size(); ++i)
+			{
+				mSweeps.emplace_back(mStepDt * glm::vec3(mLinearTransformContainer[i].velocity));
+			}
+		}
+	}, { dependencyIdx });
 
-#ifdef BROAD_PHASE_CPU
-	BoxColliderGpuPackage boxColliderPkg;
-	for (int i = 0; i < mBoxColliderContainer.size(); ++i)
+	// Only the dynamic boxes are tested against the triangle meshes
+	int dynamicBoxTaskIdx = graph.addTask([this]
 	{
-		for (int j = 0; j < cBoxColliderVertCount; ++j)
+		mDynamicBoxIndices.clear();
+		if (!mTriangleMeshColliderContainer.empty())
 		{
-			boxColliderPkg.boxColliders[i][j] = mBoxColliderContainer[i].mVertices[j];
+			int boxCount = static_cast<int>(mBoxColliderContainer.size());
+			for (int i = 0; i < boxCount; ++i)
+			{
+				if (isDynamicBody(mLinearTransformContainer[i].flags))
+					mDynamicBoxIndices.emplace_back(i);
+			}
 		}
-	}
-	mpManifoldPkg = mCpuNarrowPhase.step(boxColliderPkg, mCpuBroadPhase.getPCollisionPkg());
-#else
-	mGpuNarrowPhase.step();
-	mpManifoldPkg = mGpuNarrowPhase.getPManifoldPkg();
-#endif // BROAD_PHASE_CPU
+	}, { dependencyIdx });
 
-#endif // NARROW_PHASE_CPU
+	int broadPhaseTaskIdx = graph.addTask([this]
+	{
+		mpBroadPhase->step(mBoxColliderContainer, mSweeps);
+	}, { sweepTaskIdx }, mpBroadPhase->isBoundToCallingThread());
+
+	int narrowPhaseTaskIdx = graph.addTask([this]
+	{
+		mpManifoldPkg = mpNarrowPhase->step(mBoxColliderContainer, mpBroadPhase->getPCollisionPairPkg(), mSweeps);
+	}, { broadPhaseTaskIdx }, mpNarrowPhase->isBoundToCallingThread());
+
+	return graph.addTask([this]
+	{
+		if (!mTriangleMeshColliderContainer.empty())
+		{
+			mpManifoldPkg = mpNarrowPhase->stepTriangleMeshes( mDynamicBoxIndices, mTriangleMeshColliderContainer,
+															   mTriangleMeshBodyIndices );
+		}
+	}, { narrowPhaseTaskIdx, dynamicBoxTaskIdx }, mpNarrowPhase->isBoundToCallingThread());
 }
 
 void P3DynamicsWorld::updateMultipleBoxes(float dt)
 {
-	static float radians = 0.0f;
+	if (!mMultipleBoxesGraph.size())
+		addMultipleBoxesTasks(mMultipleBoxesGraph, -1);
 
-	for (int i = 0; i < 50; ++i)
-	{
-		mRigidLinearTransformContainer[i].velocity.x += dt * cosf(10.0f * radians);
-		mRigidLinearTransformContainer[i].velocity.y += dt * cosf(10.0f * radians);
-		mRigidLinearTransformContainer[i].velocity.z += dt * cosf(10.0f * radians);
+	mStepDt = dt;
+	P3::getJobSystem().run(mMultipleBoxesGraph);
+}
 
-		mRigidLinearTransformContainer[i].momentum    = mRigidLinearTransformContainer[i].velocity * mRigidLinearTransformContainer[i].mass;
-		mRigidLinearTransformContainer[i].position   += mRigidLinearTransformContainer[i].velocity * float(dt);
+void P3DynamicsWorld::stepMultipleBoxes(float dt)
+{
+	if (!mMultipleBoxesStepGraph.size())
+	{
+		int collisionTaskIdx = addCollisionTasks(mMultipleBoxesStepGraph, -1);
+		addMultipleBoxesTasks(mMultipleBoxesStepGraph, collisionTaskIdx);
 	}
 
-	for (int j = 50; j < 100; ++j)
+	mStepDt = dt;
+	P3::getJobSystem().run(mMultipleBoxesStepGraph);
+}
+
+int P3DynamicsWorld::addMultipleBoxesTasks(P3::TaskGraph &graph, int dependencyIdx)
+{
+	// The dynamic bodies among the first 100 sway back and forth, the colliders then follow every body
+	return graph.addTask([this]
 	{
-		mRigidLinearTransformContainer[j].velocity.x += dt * cosf(10.0f * radians);
-		mRigidLinearTransformContainer[j].velocity.y += dt * cosf(10.0f * radians);
-		mRigidLinearTransformContainer[j].velocity.z += dt * cosf(10.0f * radians);
+		static float radians = 0.0f;
 
-		mRigidLinearTransformContainer[j].momentum    = mRigidLinearTransformContainer[j].velocity * mRigidLinearTransformContainer[j].mass;
-		mRigidLinearTransformContainer[j].position   += mRigidLinearTransformContainer[j].velocity * float(dt);
-	}
+		float dt = mStepDt;
+		float sway = dt * cosf(10.0f * radians);
+
+		int swayingBodyCount = std::min(100, static_cast<int>(mLinearTransformContainer.size()));
+		P3::getJobSystem().parallelFor(swayingBodyCount, 16, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; ++i)
+			{
+				if (!isDynamicBody(mLinearTransformContainer[i].flags))
+					continue;
+
+				mLinearTransformContainer[i].velocity.x += sway;
+				mLinearTransformContainer[i].velocity.y += sway;
+				mLinearTransformContainer[i].velocity.z += sway;
+
+				mLinearTransformContainer[i].momentum    = mLinearTransformContainer[i].velocity * mLinearTransformContainer[i].mass;
+				mLinearTransformContainer[i].position   += mLinearTransformContainer[i].velocity * float(dt);
+			}
+		});
 
-	for (unsigned int i = 0; i < mRigidLinearTransformContainer.size(); ++i)
-		mMeshColliderContainer[i].update(glm::translate(glm::vec3(mRigidLinearTransformContainer[i].position)));
+		P3::getJobSystem().parallelFor(static_cast<int>(mBoxColliderContainer.size()), 64, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; ++i)
+			{
+				glm::mat4 translation = glm::translate(glm::vec3(mLinearTransformContainer[i].position));
 
-	for (unsigned int i = 0; i < mRigidLinearTransformContainer.size(); ++i)
-		mBoxColliderContainer[i].update(glm::translate(glm::vec3(mRigidLinearTransformContainer[i].position)));
+				mMeshColliderContainer[i].update(translation);
+				mBoxColliderContainer[i].update(translation);
+			}
+		});
 
-	radians += 1.0f;
+		radians += 1.0f;
+	}, { dependencyIdx });
 }
 
  // Order of operations for each timestep: Collision -> apply forces -> solve constraints -> update positions
@@ -119,7 +206,7 @@ void P3DynamicsWorld::updateBowlingGame(float dt)
 
 	//for (int rigidBodyID : mBodyContainer)
 	//{
-	//	LinearTransform &linearTransform = mRigidLinearTransformContainer[rigidBodyID];
+	//	LinearTransform &linearTransform = mLinearTransformContainer[rigidBodyID];
 
 	//	glm::vec3 accumulateImpulse{ 0.0f };
 	//	glm::vec3 sampleVelocity = linearTransform.velocity;
@@ -132,7 +219,7 @@ void P3DynamicsWorld::updateBowlingGame(float dt)
 	//		for (unsigned int i = 5u; i < getOccupancy(); ++i)
 	//		{
 	//			// A very very terrible broad phase
-	//			if (glm::length(mRigidLinearTransformContainer[i].position - linearTransform.position) <= 1.25f)
+	//			if (glm::length(mLinearTransformContainer[i].position - linearTransform.position) <= 1.25f)
 	//			{
 	//				// A very very terrible narrow phase
 	//				P3Simplex gjkSimplex;
@@ -192,27 +279,27 @@ void P3DynamicsWorld::updateBowlingGame(float dt)
 	//	; sampleVelocityContainerIter++)
 	//{
 	//	size_t i = std::distance(sampleVelocityContainer.begin(), sampleVelocityContainerIter);
-	//	mRigidLinearTransformContainer[i].velocity  = glm::vec4(*sampleVelocityContainerIter, 0.0f);
-	//	mRigidLinearTransformContainer[i].momentum  = glm::vec4(*sampleVelocityContainerIter, 0.0f) * mRigidLinearTransformContainer[i].mass;
-	//	mRigidLinearTransformContainer[i].position += *sampleVelocityContainerIter * float(dt);
+	//	mLinearTransformContainer[i].velocity  = glm::vec4(*sampleVelocityContainerIter, 0.0f);
+	//	mLinearTransformContainer[i].momentum  = glm::vec4(*sampleVelocityContainerIter, 0.0f) * mLinearTransformContainer[i].mass;
+	//	mLinearTransformContainer[i].position += *sampleVelocityContainerIter * float(dt);
 	//}
 
-	//for (unsigned int i = 0; i < mRigidLinearTransformContainer.size(); ++i)
-	//	mMeshColliderContainer[i].update(glm::translate(glm::vec3(mRigidLinearTransformContainer[i].position)));
+	//for (unsigned int i = 0; i < mLinearTransformContainer.size(); ++i)
+	//	mMeshColliderContainer[i].update(glm::translate(glm::vec3(mLinearTransformContainer[i].position)));
 
-	//for (unsigned int i = 0; i < mRigidLinearTransformContainer.size(); ++i)
-	//	mBoxColliderContainer[i].update(glm::translate(glm::vec3(mRigidLinearTransformContainer[i].position)));
+	//for (unsigned int i = 0; i < mLinearTransformContainer.size(); ++i)
+	//	mBoxColliderContainer[i].update(glm::translate(glm::vec3(mLinearTransformContainer[i].position)));
 }
 
 // Specifically for the controllable box demo
 void P3DynamicsWorld::updateControllableBox(float dt, glm::vec3 const &deltaP)
 {
 	//// 1st box is static, 2nd box is kinematic/controllable.
-	//mRigidLinearTransformContainer[1].position += deltaP;
+	//mLinearTransformContainer[1].position += deltaP;
 
 	//glm::mat4 extraTransforms = glm::rotate(0.785f, glm::vec3(0.0f, 1.0f, 0.0f));
 	//// TODO: This is extremely ad hoc, please fix!
-	//glm::mat4 temp = glm::translate(glm::vec3(mRigidLinearTransformContainer[1].position)) * extraTransforms;
+	//glm::mat4 temp = glm::translate(glm::vec3(mLinearTransformContainer[1].position)) * extraTransforms;
 	//mMeshColliderContainer[1].update(temp);
 	//mBoxColliderContainer[1].update(temp);
 
@@ -221,7 +308,7 @@ void P3DynamicsWorld::updateControllableBox(float dt, glm::vec3 const &deltaP)
 	//glm::mat4 scale     = glm::scale(glm::vec3(3.0f, 1.0f, 3.0f));
 	//glm::mat4 rotate    = glm::rotate(angle, glm::vec3(0.0f, 1.0f, 0.0f));
 	//rotate = glm::mat4(1.0f);
-	//glm::mat4 translate = glm::translate(glm::vec3(mRigidLinearTransformContainer[3].position));
+	//glm::mat4 translate = glm::translate(glm::vec3(mLinearTransformContainer[3].position));
 	//glm::mat4 ctm       = translate * rotate * scale;
 	//mMeshColliderContainer[3].update(ctm);
 	//mBoxColliderContainer[3].update(ctm);
@@ -232,99 +319,279 @@ void P3DynamicsWorld::updateControllableBox(float dt, glm::vec3 const &deltaP)
 
 void P3DynamicsWorld::updateGravityTest(float dt)
 {
-	// Apply forces
-	for (LinearTransform &linearTransform : mRigidLinearTransformContainer)
+	if (!mDynamicsGraph.size())
+		addDynamicsTasks(mDynamicsGraph, -1);
+
+	mStepDt = dt;
+	P3::getJobSystem().run(mDynamicsGraph);
+}
+
+int P3DynamicsWorld::addDynamicsTasks(P3::TaskGraph &graph, int dependencyIdx)
+{
+	// Apply forces, unless the solver does, e.g. once per sub-step when sub-stepping
+	int gravityTaskIdx = graph.addTask([this]
 	{
-		linearTransform.velocity.y -= 9.8f * dt;
-	}
+		if (!mpSolver->isApplyingGravity())
+			mIntegrator.integrateVelocities(mLinearTransformContainer, glm::vec3(0.0f, -9.8f, 0.0f), mStepDt);
+	}, { dependencyIdx });
 
 	// Solve constraints - produces final impulses at certain contact points
-#ifdef NARROW_PHASE_CPU
-	mConstraintSolver.preSolve(
-		*mpManifoldPkg,
-		mRigidLinearTransformContainer,
-		mRigidAngularTransformContainer,
-		mStaticLinearTransformContainer,
-		mStaticAngularTransformContainer,
-		dt
-	);
-
-	mConstraintSolver.iterativeSolve(
-		*mpManifoldPkg,
-		mRigidLinearTransformContainer,
-		mRigidAngularTransformContainer,
-		mStaticLinearTransformContainer,
-		mStaticAngularTransformContainer
-	);
-#else
-	// TODO: Use the implementation on the GPU
-	//mConstraintSolver.preSolve(
-	//	*mpManifoldPkg,
-	//	mRigidLinearTransformContainer,
-	//	mRigidAngularTransformContainer,
-	//	mStaticLinearTransformContainer,
-	//	mStaticAngularTransformContainer,
-	//	dt
-	//);
-
-	//mConstraintSolver.iterativeSolve(
-	//	*mpManifoldPkg,
-	//	mRigidLinearTransformContainer,
-	//	mRigidAngularTransformContainer,
-	//	mStaticLinearTransformContainer,
-	//	mStaticAngularTransformContainer
-	//);
-#endif
-
-	mOglConstraintSolver.step(
-		mpManifoldPkg->misc.x,
-		mRigidLinearTransformContainer,
-		mRigidAngularTransformContainer,
-		mStaticLinearTransformContainer,
-		mStaticAngularTransformContainer,
-		dt
-	);
-
-	// Apply final linear transforms
-	// There must be a better way to connect linear transforms and hit boxes.
-	// First wipe - linear transforms
-	for (int i = 0; i < mRigidLinearTransformContainer.size(); ++i)
-	{
-		LinearTransform &linearTransform = mRigidLinearTransformContainer[i];
-		linearTransform.position += dt * linearTransform.velocity;
-
-		mBoxColliderCtmContainer[i] = glm::translate(glm::vec3(linearTransform.position));
-	}
-
-	// Apply final angular transforms
-	for (int j = 0; j < mRigidAngularTransformContainer.size(); ++j)
-	{
-		AngularTransform &angularTransform = mRigidAngularTransformContainer[j];
-
-		// @source: Game Physics Engine Development by Ian Millington
-		addScaledVector(angularTransform.orientation, angularTransform.angularVelocity, dt / 2.0f);
-		angularTransform.orientation = glm::normalize(angularTransform.orientation);
-
-		if (glm::vec3(angularTransform.angularVelocity) == glm::vec3(0.0f))
+	int solveTaskIdx = graph.addTask([this]
+	{
+		mpSolver->solve(
+			*mpManifoldPkg,
+			mLinearTransformContainer,
+			mAngularTransformContainer,
+			mStepDt
+		);
+	}, { gravityTaskIdx }, mpSolver->isBoundToCallingThread());
+
+	// Fast bodies that opted in are swept over the step, sliding off what they hit. They are moved here and the
+	//  integrator only turns them. The sweeps all read the bodies as the solver left them, then the results go in.
+	int ccdTaskIdx = graph.addTask([this]
+	{
+		int ccdBodyCount = static_cast<int>(mCcdRigidBodyIndices.size());
+		mStepFractions.assign(mLinearTransformContainer.size(), 1.0f);
+		mCcdDisplacements.resize(ccdBodyCount);
+		mCcdVelocities.resize(ccdBodyCount);
+
+		P3::getJobSystem().parallelFor(ccdBodyCount, 1, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; ++i)
+			{
+				computeCcdMotion(mCcdRigidBodyIndices[i], mCcdDisplacements[i], mCcdVelocities[i]);
+			}
+		});
+
+		for (int i = 0; i < ccdBodyCount; ++i)
+		{
+			LinearTransform &linearTransform = mLinearTransformContainer[mCcdRigidBodyIndices[i]];
+			linearTransform.position += glm::vec4(mCcdDisplacements[i], 0.0f);
+			linearTransform.velocity = glm::vec4(mCcdVelocities[i], 0.0f);
+			linearTransform.momentum = linearTransform.mass * linearTransform.velocity;
+
+			mStepFractions[mCcdRigidBodyIndices[i]] = 0.0f;
+		}
+	}, { solveTaskIdx });
+
+	// Apply final transforms, and the box colliders follow in the same pass. Static bodies, the triangle meshes
+	//  among them, have nothing to integrate and keep the colliders they were created with.
+	int integrationTaskIdx = graph.addTask([this]
+	{
+		mIntegrator.integratePositions( mLinearTransformContainer,
+										mAngularTransformContainer,
+										mStepFractions,
+										mStepDt,
+										mBoxColliderCtmContainer,
+										mBoxColliderContainer );
+	}, { ccdTaskIdx });
+
+	return graph.addTask([this]
+	{
+		mpNarrowPhase->swapBuffers();
+	}, { integrationTaskIdx }, mpNarrowPhase->isBoundToCallingThread());
+}
+
+void P3DynamicsWorld::setFixedTimeStep(float fixedDt, int maxCatchUpSteps)
+{
+	mFixedDt = fixedDt;
+	mMaxCatchUpSteps = std::max(1, maxCatchUpSteps);
+	mAccumulatedTime = std::min(mAccumulatedTime, mFixedDt);
+}
+
+int P3DynamicsWorld::advance(float frameDt, std::function<void(float)> const &step)
+{
+	mAccumulatedTime += std::max(0.0f, frameDt);
+
+	int stepCount = 0;
+	for (; mAccumulatedTime >= mFixedDt && stepCount < mMaxCatchUpSteps; ++stepCount)
+	{
+		mPreviousPositions.resize(mLinearTransformContainer.size());
+		mPreviousOrientations.resize(mAngularTransformContainer.size());
+
+		for (size_t i = 0; i < mLinearTransformContainer.size(); ++i)
+		{
+			mPreviousPositions[i] = glm::vec3(mLinearTransformContainer[i].position);
+			mPreviousOrientations[i] = mAngularTransformContainer[i].orientation;
+		}
+
+		step(mFixedDt);
+		mAccumulatedTime -= mFixedDt;
+	}
+
+	// Spiral of death, the steps can't keep up with real time. Drop what they couldn't catch up on.
+	if (mAccumulatedTime >= mFixedDt)
+	{
+		mAccumulatedTime = std::fmod(mAccumulatedTime, mFixedDt);
+	}
+
+	return stepCount;
+}
+
+void P3DynamicsWorld::computeInterpolatedTransforms(std::vector<glm::mat4> &worldTransforms) const
+{
+	float alpha = getInterpolationFactor();
+	worldTransforms.resize(mLinearTransformContainer.size());
+
+	for (size_t i = 0; i < mLinearTransformContainer.size(); ++i)
+	{
+		glm::vec3 position(mLinearTransformContainer[i].position);
+		glm::quat orientation = mAngularTransformContainer[i].orientation;
+
+		if (i < mPreviousPositions.size() && !(mLinearTransformContainer[i].flags & cStaticBodyFlag))
+		{
+			position = glm::mix(mPreviousPositions[i], position, alpha);
+			orientation = glm::slerp(mPreviousOrientations[i], orientation, alpha);
+		}
+
+		worldTransforms[i] = glm::translate(position) * glm::mat4_cast(orientation);
+	}
+}
+
+void P3DynamicsWorld::computeCcdMotion(int rigidBodyIdx, glm::vec3 &displacement, glm::vec3 &velocity) const
+{
+	displacement = glm::vec3(0.0f);
+	velocity = glm::vec3(mLinearTransformContainer[rigidBodyIdx].velocity);
+
+	float elapsedFraction = 0.0f;
+
+	for (int substepIdx = 0; substepIdx < cCcdMaxSubstepCount; ++substepIdx)
+	{
+		float sweepDt = (1.0f - elapsedFraction) * mStepDt;
+		glm::vec3 sweep = sweepDt * velocity;
+		float sweepLength = glm::length(sweep);
+
+		glm::vec3 hitNormal(0.0f);
+		bool isDynamicHit = false;
+		float timeOfImpact = sweepLength > P3::cCcdTolerance
+			? sweepCcdBody(rigidBodyIdx, displacement, elapsedFraction, sweep, sweepDt, hitNormal, isDynamicHit)
+			: 1.0f;
+
+		if (timeOfImpact >= 1.0f)
+		{
+			displacement += sweep;
+			return;
+		}
+
+		// Out of sub-steps or into a body that can take the momentum, stop slightly inside, so the discrete narrow
+		//  phase sees a contact to resolve
+		if (isDynamicHit || substepIdx == cCcdMaxSubstepCount - 1)
+		{
+			displacement += std::min(1.0f, timeOfImpact + cCcdPenetrationSlop / sweepLength) * sweep;
+			return;
+		}
+
+		displacement += timeOfImpact * sweep;
+		elapsedFraction += timeOfImpact * (1.0f - elapsedFraction);
+
+		// No bounce, what's left of the step goes along the surface
+		float closingSpeed = glm::dot(velocity, hitNormal);
+		if (closingSpeed > 0.0f)
+			velocity -= closingSpeed * hitNormal;
+	}
+}
+
+float P3DynamicsWorld::sweepCcdBody( int rigidBodyIdx, glm::vec3 const &offset, float elapsedFraction,
+									 glm::vec3 const &displacement, float sweepDt,
+									 glm::vec3 &hitNormal, bool &isDynamicHit ) const
+{
+	// Shrunk towards its center, a box sliding on the surface it rests on doesn't hit the next face over
+	P3BoxCollider shrunkCollider = mBoxColliderContainer[rigidBodyIdx];
+	glm::vec4 center(0.0f);
+	for (int i = 0; i < cBoxColliderVertCount; ++i)
+	{
+		center += shrunkCollider[i] / static_cast<float>(cBoxColliderVertCount);
+	}
+	for (int i = 0; i < cBoxColliderVertCount; ++i)
+	{
+		glm::vec4 toVertex = shrunkCollider.mVertices[i] - center;
+		float toVertexLength = glm::length(toVertex);
+		shrunkCollider.mVertices[i] -= std::min(cCcdSkinWidth / toVertexLength, 0.5f) * toVertex;
+	}
+
+	P3::BoxSupport boxCollider(shrunkCollider);
+
+	Aabb aabb;
+	aabb.mMinCoord = glm::vec4(std::numeric_limits<float>::max());
+	aabb.mMaxCoord = glm::vec4(std::numeric_limits<float>::lowest());
+	for (int i = 0; i < cBoxColliderVertCount; ++i)
+	{
+		aabb.mMinCoord = glm::min(aabb.mMinCoord, mBoxColliderContainer[rigidBodyIdx][i]);
+		aabb.mMaxCoord = glm::max(aabb.mMaxCoord, mBoxColliderContainer[rigidBodyIdx][i]);
+	}
+
+	// Swept bounds, moved by the offset and relative to the other body, to skip everything the body can't reach
+	auto getSweptAabb = [&aabb](glm::vec3 const &translation, glm::vec3 const &relativeDisplacement)
+	{
+		glm::vec4 start(translation, 0.0f);
+		glm::vec4 end(translation + relativeDisplacement, 0.0f);
+
+		return Aabb( glm::min(aabb.mMinCoord + start, aabb.mMinCoord + end),
+					 glm::max(aabb.mMaxCoord + start, aabb.mMaxCoord + end) );
+	};
+
+	float timeOfImpact = 1.0f;
+	glm::vec3 normal(0.0f);
+
+	// Box collider i is body i. The other dynamic bodies are swept in the frame of this one.
+	for (int i = 0; i < static_cast<int>(mBoxColliderContainer.size()); ++i)
+	{
+		if (i == rigidBodyIdx) continue;
+
+		bool isDynamic = isDynamicBody(mLinearTransformContainer[i].flags);
+
+		glm::vec3 otherVelocity(0.0f);
+		if (isDynamic)
+			otherVelocity = glm::vec3(mLinearTransformContainer[i].velocity);
+
+		glm::vec3 translation = offset - elapsedFraction * mStepDt * otherVelocity;
+		glm::vec3 relativeDisplacement = displacement - sweepDt * otherVelocity;
+
+		Aabb otherAabb;
+		otherAabb.mMinCoord = glm::vec4(std::numeric_limits<float>::max());
+		otherAabb.mMaxCoord = glm::vec4(std::numeric_limits<float>::lowest());
+		for (int j = 0; j < cBoxColliderVertCount; ++j)
 		{
-			mBoxColliderCtmContainer[j] *= glm::mat4(1.0f);
+			otherAabb.mMinCoord = glm::min(otherAabb.mMinCoord, mBoxColliderContainer[i][j]);
+			otherAabb.mMaxCoord = glm::max(otherAabb.mMaxCoord, mBoxColliderContainer[i][j]);
 		}
-		else
+
+		if (!overlaps(getSweptAabb(translation, relativeDisplacement), otherAabb)) continue;
+
+		// The relative displacement covers the same time as the displacement, so the fractions compare
+		float otherTimeOfImpact = P3::computeTimeOfImpact( P3::TranslatedSupport(boxCollider, translation), relativeDisplacement,
+														   P3::BoxSupport(mBoxColliderContainer[i]), &normal );
+		if (otherTimeOfImpact < timeOfImpact)
 		{
-			mBoxColliderCtmContainer[j] *= glm::mat4_cast(angularTransform.orientation);
+			timeOfImpact = otherTimeOfImpact;
+			hitNormal = normal;
+			isDynamicHit = isDynamic;
 		}
 	}
 
-	for (int m = 0; m < mBoxColliderCtmContainer.size(); ++m)
+	P3::TranslatedSupport movingCollider(boxCollider, offset);
+	Aabb sweptAabb = getSweptAabb(offset, displacement);
+
+	for (P3::TriangleMeshCollider const &meshCollider : mTriangleMeshColliderContainer)
 	{
-		mBoxColliderContainer[m].update(mBoxColliderCtmContainer[m]);
+		meshCollider.query(sweptAabb, [&](int triangleIdx)
+			{
+				P3::TriangleSupport triangle( meshCollider.getVertex(triangleIdx, 0),
+											  meshCollider.getVertex(triangleIdx, 1),
+											  meshCollider.getVertex(triangleIdx, 2) );
+
+				float triangleTimeOfImpact = P3::computeTimeOfImpact(movingCollider, displacement, triangle, &normal);
+				if (triangleTimeOfImpact < timeOfImpact)
+				{
+					timeOfImpact = triangleTimeOfImpact;
+					hitNormal = normal;
+					isDynamicHit = false;
+				}
+			}
+		);
 	}
 
-#ifdef NARROW_PHASE_CPU
-	mCpuNarrowPhase.swapBuffers();
-#else
-	mGpuNarrowPhase.swapBuffers();
-#endif // NARROW_PHASE_CPU
+	return timeOfImpact;
 }
 
 glm::vec3 P3DynamicsWorld::castRay(glm::vec3 const &start, glm::vec3 const &direction)
@@ -349,29 +616,19 @@ glm::vec3 P3DynamicsWorld::castRay(glm::vec3 const &start, glm::vec3 const &dire
 	return glm::vec3(0.0f);
 }
 
-// TODO: WIP
-int P3DynamicsWorld::addRigidBody()
+// A unit box at rest at the origin
+P3::Handle P3DynamicsWorld::addRigidBody()
 {
-	// Generate unique ID and add to ID container
-	mBodyContainer.emplace_back(mUniqueID++);
-	// Add to linear transform container
-	mRigidLinearTransformContainer.emplace_back();
-	// Add to angular transform container
-	mRigidAngularTransformContainer.emplace_back();
-
-	// TODO: Set up appropriate entity -> index and index -> entity maps. This is needed
-	// in the case of removing bodies.
-
-	return mUniqueID;
+	return addRigidBody(1.0f, glm::vec3(0.0f), glm::vec3(0.0f));
 }
 
-int P3DynamicsWorld::addRigidBody(float mass, glm::vec3 const &position, glm::vec3 const &velocity)
+P3::Handle P3DynamicsWorld::addRigidBody(float mass, glm::vec3 const &position, glm::vec3 const &velocity)
 {
-	mBodyContainer.emplace_back(mUniqueID++);
+	P3::Handle handle = mBodies.insert();
 
-	mRigidLinearTransformContainer.emplace_back();
+	mLinearTransformContainer.emplace_back();
 
-	LinearTransform &lastLinearTransform = mRigidLinearTransformContainer.back();
+	LinearTransform &lastLinearTransform = mLinearTransformContainer.back();
 	lastLinearTransform.mass = mass;
 	lastLinearTransform.inverseMass = 1.0f / mass;
 	lastLinearTransform.position = glm::vec4(position, 1.0f);
@@ -385,22 +642,22 @@ int P3DynamicsWorld::addRigidBody(float mass, glm::vec3 const &position, glm::ve
 	mBoxColliderContainer.emplace_back();
 	mBoxColliderContainer.back().update(glm::translate(position));
 
-	mRigidAngularTransformContainer.emplace_back();
-	mRigidAngularTransformContainer.back().orientation = glm::normalize(glm::quat(glm::vec3(0.0f)));
+	mAngularTransformContainer.emplace_back();
+	mAngularTransformContainer.back().orientation = glm::normalize(glm::quat(glm::vec3(0.0f)));
 
 	mBoxColliderCtmContainer.emplace_back(glm::translate(position));
 
-	return mUniqueID;
+	return handle;
 }
 
-int P3DynamicsWorld::addRigidBody( float mass, glm::vec3 const &position, glm::vec3 const &velocity,
+P3::Handle P3DynamicsWorld::addRigidBody( float mass, glm::vec3 const &position, glm::vec3 const &velocity,
 								   glm::mat4 const &extraTransforms )
 {
-	mBodyContainer.emplace_back(mUniqueID++);
+	P3::Handle handle = mBodies.insert();
 
-	mRigidLinearTransformContainer.emplace_back();
+	mLinearTransformContainer.emplace_back();
 
-	LinearTransform &lastLinearTransform = mRigidLinearTransformContainer.back();
+	LinearTransform &lastLinearTransform = mLinearTransformContainer.back();
 	lastLinearTransform.mass = mass;
 	lastLinearTransform.inverseMass = 1.0f / mass;
 	lastLinearTransform.position = glm::vec4(position, 1.0f);
@@ -414,39 +671,50 @@ int P3DynamicsWorld::addRigidBody( float mass, glm::vec3 const &position, glm::v
 	mBoxColliderContainer.emplace_back();
 	mBoxColliderContainer.back().update(glm::translate(position) * extraTransforms);
 
-	mRigidAngularTransformContainer.emplace_back();
-	mRigidAngularTransformContainer.back().orientation = glm::normalize(glm::quat(glm::vec3(0.0f)));
-	mRigidAngularTransformContainer.back().inertia = glm::mat3(std::numeric_limits<float>::max());
-	mRigidAngularTransformContainer.back().inverseInertia = glm::mat3(0.0f);
+	mAngularTransformContainer.emplace_back();
+	mAngularTransformContainer.back().orientation = glm::normalize(glm::quat(glm::vec3(0.0f)));
+	mAngularTransformContainer.back().inertia = glm::mat3(std::numeric_limits<float>::max());
+	mAngularTransformContainer.back().inverseInertia = glm::mat3(0.0f);
 
 	mBoxColliderCtmContainer.emplace_back();
 
-	return mUniqueID;
+	return handle;
 }
 
-// TODO: WIP
-int P3DynamicsWorld::addRigidBody(LinearTransform const &linearTransform, AngularTransform const &angularTransform)
+P3::Handle P3DynamicsWorld::addRigidBody(LinearTransform const &linearTransform, AngularTransform const &angularTransform)
 {
-	mBodyContainer.emplace_back(mUniqueID++);
+	P3::Handle handle = mBodies.insert();
 
-	mRigidLinearTransformContainer.emplace_back(linearTransform); // Copy constructor will be called here.
+	mLinearTransformContainer.emplace_back(linearTransform); // Copy constructor will be called here.
 
 	// Add to angular transform container
-	mRigidAngularTransformContainer.emplace_back(angularTransform);
+	mAngularTransformContainer.emplace_back(angularTransform);
+
+	// Every box body needs its colliders, box collider i is body i
+	glm::mat4 ctm = glm::translate(glm::vec3(linearTransform.position)) * glm::mat4_cast(angularTransform.orientation);
+
+	mMeshColliderContainer.emplace_back();
+	mMeshColliderContainer.back().update(ctm);
+
+	mBoxColliderContainer.emplace_back();
+	mBoxColliderContainer.back().update(ctm);
 
-	return mUniqueID;
+	mBoxColliderCtmContainer.emplace_back(ctm);
+
+	return handle;
 }
 
 // A static body can do more than just standing still, but for now that's all it does.
-int P3DynamicsWorld::addStaticBody(glm::vec3 const &position)
+P3::Handle P3DynamicsWorld::addStaticBody(glm::vec3 const &position)
 {
-	mBodyContainer.emplace_back(mUniqueID++);
+	P3::Handle handle = mBodies.insert();
 
-	mStaticLinearTransformContainer.emplace_back();
+	mLinearTransformContainer.emplace_back();
 
-	LinearTransform &lastLinearTransform = mStaticLinearTransformContainer.back();
+	LinearTransform &lastLinearTransform = mLinearTransformContainer.back();
 	lastLinearTransform.mass = std::numeric_limits<float>::max();
 	lastLinearTransform.inverseMass = 0.0f;
+	lastLinearTransform.flags = cStaticBodyFlag;
 	lastLinearTransform.position = glm::vec4(position, 1.0f);
 	lastLinearTransform.velocity = glm::vec4(0.0f);
 	lastLinearTransform.momentum = glm::vec4(glm::vec3(std::numeric_limits<float>::max()), 0.0f);
@@ -458,30 +726,573 @@ int P3DynamicsWorld::addStaticBody(glm::vec3 const &position)
 	mBoxColliderContainer.emplace_back();
 	mBoxColliderContainer.back().update(glm::translate(position));
 
-	mStaticAngularTransformContainer.emplace_back();
-	mStaticAngularTransformContainer.back().orientation = glm::normalize(glm::quat(glm::vec3(0.0f)));
-	mStaticAngularTransformContainer.back().inertia = glm::mat3(std::numeric_limits<float>::max());
-	mStaticAngularTransformContainer.back().inverseInertia = glm::mat3(0.0f);
+	mAngularTransformContainer.emplace_back();
+	mAngularTransformContainer.back().orientation = glm::normalize(glm::quat(glm::vec3(0.0f)));
+	mAngularTransformContainer.back().inertia = glm::mat3(std::numeric_limits<float>::max());
+	mAngularTransformContainer.back().inverseInertia = glm::mat3(0.0f);
 
 	mBoxColliderCtmContainer.emplace_back(glm::translate(position));
 
-	return mUniqueID;
+	return handle;
+}
+
+void P3DynamicsWorld::addBoxBodies( std::vector<float> const &masses,
+									std::vector<glm::vec3> const &positions,
+									std::vector<glm::vec3> const &velocities,
+									std::vector<glm::vec3> const &halfExtents,
+									std::vector<P3::Handle> &handles )
+{
+	// Box collider i is body i, a box added after a triangle mesh would take the collider slot of the mesh
+	assert(mTriangleMeshBodyIndices.empty());
+	if (!mTriangleMeshBodyIndices.empty())
+		return;
+
+	assert(positions.size() == masses.size());
+	assert(velocities.size() == masses.size());
+	assert(halfExtents.empty() || halfExtents.size() == masses.size());
+
+	int firstBodyIdx = static_cast<int>(mLinearTransformContainer.size());
+	int freeCount = std::max(0, static_cast<int>(mMaxCapacity) - firstBodyIdx);
+	int addedCount = std::min(static_cast<int>(masses.size()), freeCount);
+	int bodyCount = firstBodyIdx + addedCount;
+
+	mBodies.reserve(bodyCount);
+	handles.reserve(handles.size() + addedCount);
+	for (int i = 0; i < addedCount; ++i)
+	{
+		handles.emplace_back(mBodies.insert());
+	}
+
+	mLinearTransformContainer.resize(bodyCount);
+	mAngularTransformContainer.resize(bodyCount);
+	mMeshColliderContainer.resize(bodyCount);
+	mBoxColliderContainer.resize(bodyCount);
+	mBoxColliderCtmContainer.resize(bodyCount);
+
+	P3::getJobSystem().parallelFor(addedCount, 256, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; ++i)
+		{
+			int bodyIdx = firstBodyIdx + i;
+			glm::vec3 const &position = positions[i];
+			bool isStatic = masses[i] == 0.0f;
+
+			LinearTransform &linearTransform = mLinearTransformContainer[bodyIdx];
+			linearTransform.position = glm::vec4(position, 1.0f);
+
+			AngularTransform &angularTransform = mAngularTransformContainer[bodyIdx];
+			angularTransform.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+			if (isStatic)
+			{
+				linearTransform.mass = std::numeric_limits<float>::max();
+				linearTransform.flags = cStaticBodyFlag;
+				linearTransform.momentum = glm::vec4(glm::vec3(std::numeric_limits<float>::max()), 0.0f);
+
+				angularTransform.inertia = glm::mat3(std::numeric_limits<float>::max());
+				angularTransform.inverseInertia = glm::mat3(0.0f);
+			}
+			else
+			{
+				linearTransform.mass = masses[i];
+				linearTransform.inverseMass = 1.0f / masses[i];
+				linearTransform.velocity = glm::vec4(velocities[i], 0.0f);
+				linearTransform.momentum = masses[i] * linearTransform.velocity;
+			}
+
+			// No rotation yet, the colliders are their instance vertices moved by the position
+			glm::vec4 scale(halfExtents.empty() ? glm::vec3(1.0f) : halfExtents[i], 1.0f);
+			glm::vec4 translation(position, 0.0f);
+
+			P3BoxCollider &boxCollider = mBoxColliderContainer[bodyIdx];
+			for (int k = 0; k < cBoxColliderVertCount; ++k)
+			{
+				boxCollider.mInstanceVertices[k] = cInstanceVertices[k] * scale;
+				boxCollider.mVertices[k] = boxCollider.mInstanceVertices[k] + translation;
+			}
+
+			mMeshColliderContainer[bodyIdx].setInstanceVertices(boxCollider.mInstanceVertices);
+
+			glm::mat4 &ctm = mBoxColliderCtmContainer[bodyIdx];
+			ctm = glm::mat4(1.0f);
+			ctm[3] = glm::vec4(position, 1.0f);
+			mMeshColliderContainer[bodyIdx].update(ctm);
+		}
+	});
+}
+
+P3::Handle P3DynamicsWorld::addStaticMesh( std::vector<float> const &positions, std::vector<unsigned int> const &elements,
+									glm::mat4 const &model )
+{
+	P3::Handle handle = mBodies.insert();
+
+	// The vertices are baked into world space, the transform is only there for the solver to see an immovable body
+	mLinearTransformContainer.emplace_back();
+
+	LinearTransform &lastLinearTransform = mLinearTransformContainer.back();
+	lastLinearTransform.mass = std::numeric_limits<float>::max();
+	lastLinearTransform.inverseMass = 0.0f;
+	lastLinearTransform.flags = cStaticBodyFlag;
+	lastLinearTransform.position = glm::vec4(glm::vec3(model[3]), 1.0f);
+	lastLinearTransform.velocity = glm::vec4(0.0f);
+	lastLinearTransform.momentum = glm::vec4(glm::vec3(std::numeric_limits<float>::max()), 0.0f);
+
+	mAngularTransformContainer.emplace_back();
+	mAngularTransformContainer.back().orientation = glm::normalize(glm::quat(glm::vec3(0.0f)));
+	mAngularTransformContainer.back().inertia = glm::mat3(std::numeric_limits<float>::max());
+	mAngularTransformContainer.back().inverseInertia = glm::mat3(0.0f);
+
+	mTriangleMeshColliderContainer.emplace_back();
+	mTriangleMeshColliderContainer.back().create(positions, elements, model);
+	mTriangleMeshBodyIndices.emplace_back(static_cast<int>(mLinearTransformContainer.size()) - 1);
+
+	return handle;
+}
+
+void P3DynamicsWorld::setContinuousCollision(int rigidBodyIdx, bool isEnabled)
+{
+	auto ccdIter = std::find(mCcdRigidBodyIndices.begin(), mCcdRigidBodyIndices.end(), rigidBodyIdx);
+
+	if (isEnabled && ccdIter == mCcdRigidBodyIndices.end())
+	{
+		mCcdRigidBodyIndices.emplace_back(rigidBodyIdx);
+	}
+	else if (!isEnabled && ccdIter != mCcdRigidBodyIndices.end())
+	{
+		mCcdRigidBodyIndices.erase(ccdIter);
+	}
+}
+
+bool P3DynamicsWorld::removeBody(P3::Handle handle)
+{
+	int bodyIdx = mBodies.getIndex(handle);
+	if (bodyIdx < 0)
+		return false;
+
+	setContinuousCollision(bodyIdx, false);
+	mBodies.release(bodyIdx);
+	mpNarrowPhase->onBodyRemoved(bodyIdx);
+
+	int lastBodyIdx = static_cast<int>(mLinearTransformContainer.size()) - 1;
+	int boxBodyCount = static_cast<int>(mBoxColliderContainer.size());
+
+	if (bodyIdx < boxBodyCount)
+	{
+		// The last triangle mesh, if any, then fills the hole left at the end of the boxes
+		moveBody(boxBodyCount - 1, bodyIdx);
+		moveBody(lastBodyIdx, boxBodyCount - 1);
+
+		mMeshColliderContainer.pop_back();
+		mBoxColliderContainer.pop_back();
+		mBoxColliderCtmContainer.pop_back();
+	}
+	else
+	{
+		auto meshIter = std::find(mTriangleMeshBodyIndices.begin(), mTriangleMeshBodyIndices.end(), bodyIdx);
+		size_t meshIdx = meshIter - mTriangleMeshBodyIndices.begin();
+
+		mTriangleMeshColliderContainer[meshIdx] = std::move(mTriangleMeshColliderContainer.back());
+		mTriangleMeshColliderContainer.pop_back();
+		mTriangleMeshBodyIndices[meshIdx] = mTriangleMeshBodyIndices.back();
+		mTriangleMeshBodyIndices.pop_back();
+
+		moveBody(lastBodyIdx, bodyIdx);
+	}
+
+	mLinearTransformContainer.pop_back();
+	mAngularTransformContainer.pop_back();
+	mBodies.popBack();
+
+	if (mPreviousPositions.size() > mLinearTransformContainer.size())
+	{
+		mPreviousPositions.resize(mLinearTransformContainer.size());
+		mPreviousOrientations.resize(mAngularTransformContainer.size());
+	}
+
+	return true;
+}
+
+void P3DynamicsWorld::moveBody(int fromBodyIdx, int toBodyIdx)
+{
+	if (fromBodyIdx == toBodyIdx)
+		return;
+
+	mBodies.move(fromBodyIdx, toBodyIdx);
+	mpNarrowPhase->onBodyMoved(fromBodyIdx, toBodyIdx);
+	mLinearTransformContainer[toBodyIdx] = mLinearTransformContainer[fromBodyIdx];
+	mAngularTransformContainer[toBodyIdx] = mAngularTransformContainer[fromBodyIdx];
+
+	if (fromBodyIdx < static_cast<int>(mBoxColliderContainer.size()))
+	{
+		mMeshColliderContainer[toBodyIdx] = mMeshColliderContainer[fromBodyIdx];
+		mBoxColliderContainer[toBodyIdx] = mBoxColliderContainer[fromBodyIdx];
+		mBoxColliderCtmContainer[toBodyIdx] = mBoxColliderCtmContainer[fromBodyIdx];
+	}
+	else
+	{
+		std::replace(mTriangleMeshBodyIndices.begin(), mTriangleMeshBodyIndices.end(), fromBodyIdx, toBodyIdx);
+	}
+
+	std::replace(mCcdRigidBodyIndices.begin(), mCcdRigidBodyIndices.end(), fromBodyIdx, toBodyIdx);
+
+	// A body added after the last step has nothing to interpolate from, it shows where it is
+	int previousCount = static_cast<int>(mPreviousPositions.size());
+	if (toBodyIdx < previousCount)
+	{
+		bool hasPrevious = fromBodyIdx < previousCount;
+		mPreviousPositions[toBodyIdx] = hasPrevious ? mPreviousPositions[fromBodyIdx]
+													: glm::vec3(mLinearTransformContainer[toBodyIdx].position);
+		mPreviousOrientations[toBodyIdx] = hasPrevious ? mPreviousOrientations[fromBodyIdx]
+													   : mAngularTransformContainer[toBodyIdx].orientation;
+	}
+}
+
+P3::Handle P3DynamicsWorld::addStaticBodies(std::vector<glm::vec3> const &posContainer)
+{
+	P3::Handle handle;
+	for (glm::vec3 const &position : posContainer)
+	{
+		handle = addStaticBody(position);
+	}
+
+	return handle;
+}
+
+bool P3DynamicsWorld::saveSnapshot(std::string const &path) const
+{
+	return saveSnapshot(path, 0u);
+}
+
+bool P3DynamicsWorld::saveSnapshot(std::string const &path, uint64_t checkpointId) const
+{
+	using P3::SnapshotSection;
+
+	P3::SnapshotWriter writer;
+	writer.addSection(SnapshotSection::LINEAR_TRANSFORMS, mLinearTransformContainer);
+	writer.addSection(SnapshotSection::ANGULAR_TRANSFORMS, mAngularTransformContainer);
+	writer.addSection(SnapshotSection::BODY_SLOTS, mBodies.getSlots());
+	writer.addSection(SnapshotSection::BODY_SLOT_GENERATIONS, mBodies.getGenerations());
+	writer.addSection(SnapshotSection::BOX_COLLIDERS, mBoxColliderContainer);
+	writer.addSection(SnapshotSection::BOX_COLLIDER_CTMS, mBoxColliderCtmContainer);
+	writer.addSection(SnapshotSection::CCD_BODY_INDICES, mCcdRigidBodyIndices);
+
+	// The meshes are stored baked, their Bvh and edge flags are built again on load
+	std::vector<int> firstVertexIndices{ 0 };
+	std::vector<int> firstTriangleIndices{ 0 };
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::uvec3> triangles;
+
+	for (P3::TriangleMeshCollider const &triangleMeshCollider : mTriangleMeshColliderContainer)
+	{
+		vertices.insert(vertices.end(), triangleMeshCollider.getVertices().begin(), triangleMeshCollider.getVertices().end());
+		triangles.insert(triangles.end(), triangleMeshCollider.getTriangles().begin(), triangleMeshCollider.getTriangles().end());
+
+		firstVertexIndices.emplace_back(static_cast<int>(vertices.size()));
+		firstTriangleIndices.emplace_back(static_cast<int>(triangles.size()));
+	}
+
+	writer.addSection(SnapshotSection::TRIANGLE_MESH_BODY_INDICES, mTriangleMeshBodyIndices);
+	writer.addSection(SnapshotSection::TRIANGLE_MESH_FIRST_VERTICES, firstVertexIndices);
+	writer.addSection(SnapshotSection::TRIANGLE_MESH_FIRST_TRIANGLES, firstTriangleIndices);
+	writer.addSection(SnapshotSection::TRIANGLE_MESH_VERTICES, vertices);
+	writer.addSection(SnapshotSection::TRIANGLE_MESH_TRIANGLES, triangles);
+
+	if (checkpointId)
+		writer.addSection(SnapshotSection::CHECKPOINT_ID, &checkpointId, 1);
+
+	addManifoldCache(writer);
+
+	return writer.writeFile(path);
+}
+
+void P3DynamicsWorld::addManifoldCache(P3::SnapshotWriter &writer) const
+{
+	// The manifolds of the last step, the next step warm starts from them
+	ManifoldGpuPackage const *pManifoldPkg = mpNarrowPhase->getPWarmStartCache();
+	if (!pManifoldPkg)
+		return;
+
+	writer.addSection(P3::SnapshotSection::MANIFOLD_MISC, &pManifoldPkg->misc, 1);
+	writer.addSection(P3::SnapshotSection::MANIFOLDS, pManifoldPkg->manifolds.data(), pManifoldPkg->misc.x);
+	writer.addSection(P3::SnapshotSection::MANIFOLD_CONTACTS, pManifoldPkg->contacts.data(), pManifoldPkg->misc.y);
+}
+
+void P3DynamicsWorld::loadManifoldCache(P3::SnapshotView const &view)
+{
+	ManifoldGpuPackage *pManifoldPkg = mpNarrowPhase->getPWarmStartCache();
+	if (!pManifoldPkg)
+		return;
+
+	size_t miscCount, manifoldCount, contactCount;
+	glm::ivec4 const *pManifoldMisc = view.getSection<glm::ivec4>(P3::SnapshotSection::MANIFOLD_MISC, miscCount);
+	Manifold const *pManifolds = view.getSection<Manifold>(P3::SnapshotSection::MANIFOLDS, manifoldCount);
+	Contact const *pContacts = view.getSection<Contact>(P3::SnapshotSection::MANIFOLD_CONTACTS, contactCount);
+
+	// A manifold whose contacts aren't all in the pool means the cache is broken, the next step starts cold then
+	bool isCacheValid = true;
+	for (size_t manifoldIdx = 0u; manifoldIdx < manifoldCount && isCacheValid; ++manifoldIdx)
+	{
+		Manifold const &manifold = pManifolds[manifoldIdx];
+		int manifoldContactCount = manifold.contactBoxIndicesAndContactCount.z;
+
+		isCacheValid = manifold.firstContactIdx >= 0
+					&& manifoldContactCount >= 0 && manifoldContactCount <= cMaxManifoldContactCount
+					&& static_cast<size_t>(manifold.firstContactIdx) + manifoldContactCount <= contactCount;
+	}
+
+	// Without a cache the next step just starts cold
+	pManifoldPkg->misc = miscCount ? *pManifoldMisc : glm::ivec4(0);
+	if (!isCacheValid)
+	{
+		pManifoldPkg->clear();
+		return;
+	}
+
+	pManifoldPkg->misc.x = static_cast<int>(manifoldCount);
+	pManifoldPkg->misc.y = static_cast<int>(contactCount);
+	pManifoldPkg->manifolds.assign(pManifolds, pManifolds + manifoldCount);
+	pManifoldPkg->contacts.assign(pContacts, pContacts + contactCount);
+}
+
+bool P3DynamicsWorld::loadSnapshot(std::string const &path)
+{
+	P3::MappedFile file;
+	P3::SnapshotView view;
+
+	return file.open(path) && view.open(file.getData(), file.getSize()) && loadSnapshot(view);
+}
+
+bool P3DynamicsWorld::loadSnapshot(P3::SnapshotView const &view)
+{
+	using P3::SnapshotSection;
+
+	size_t bodyCount, angularCount, slotCount, generationCount, boxCount, ctmCount, ccdCount;
+	LinearTransform const *pLinearTransforms = view.getSection<LinearTransform>(SnapshotSection::LINEAR_TRANSFORMS, bodyCount);
+	AngularTransform const *pAngularTransforms = view.getSection<AngularTransform>(SnapshotSection::ANGULAR_TRANSFORMS, angularCount);
+	uint32_t const *pSlots = view.getSection<uint32_t>(SnapshotSection::BODY_SLOTS, slotCount);
+	uint32_t const *pGenerations = view.getSection<uint32_t>(SnapshotSection::BODY_SLOT_GENERATIONS, generationCount);
+	P3BoxCollider const *pBoxColliders = view.getSection<P3BoxCollider>(SnapshotSection::BOX_COLLIDERS, boxCount);
+	glm::mat4 const *pCtms = view.getSection<glm::mat4>(SnapshotSection::BOX_COLLIDER_CTMS, ctmCount);
+	int const *pCcdBodyIndices = view.getSection<int>(SnapshotSection::CCD_BODY_INDICES, ccdCount);
+
+	size_t meshCount, firstVertexCount, firstTriangleCount, vertexCount, triangleCount;
+	int const *pMeshBodyIndices = view.getSection<int>(SnapshotSection::TRIANGLE_MESH_BODY_INDICES, meshCount);
+	int const *pFirstVertexIndices = view.getSection<int>(SnapshotSection::TRIANGLE_MESH_FIRST_VERTICES, firstVertexCount);
+	int const *pFirstTriangleIndices = view.getSection<int>(SnapshotSection::TRIANGLE_MESH_FIRST_TRIANGLES, firstTriangleCount);
+	glm::vec3 const *pVertices = view.getSection<glm::vec3>(SnapshotSection::TRIANGLE_MESH_VERTICES, vertexCount);
+	glm::uvec3 const *pTriangles = view.getSection<glm::uvec3>(SnapshotSection::TRIANGLE_MESH_TRIANGLES, triangleCount);
+
+	// Missing sections, or sections written with another layout, come back empty
+	if (angularCount != bodyCount || slotCount != bodyCount || generationCount < slotCount || ctmCount != boxCount
+		|| boxCount + meshCount != bodyCount || firstVertexCount != meshCount + 1 || firstTriangleCount != meshCount + 1)
+	{
+		return false;
+	}
+
+	reset();
+
+	mBodies.restore(pSlots, slotCount, pGenerations, generationCount);
+	mLinearTransformContainer.assign(pLinearTransforms, pLinearTransforms + bodyCount);
+	mAngularTransformContainer.assign(pAngularTransforms, pAngularTransforms + bodyCount);
+	mBoxColliderContainer.assign(pBoxColliders, pBoxColliders + boxCount);
+	mBoxColliderCtmContainer.assign(pCtms, pCtms + ctmCount);
+	mCcdRigidBodyIndices.assign(pCcdBodyIndices, pCcdBodyIndices + ccdCount);
+
+	mMeshColliderContainer.resize(boxCount);
+	for (size_t i = 0; i < boxCount; ++i)
+	{
+		P3BoxCollider const &boxCollider = mBoxColliderContainer[i];
+		mMeshColliderContainer[i].setInstanceVertices( std::vector<glm::vec4>( boxCollider.mInstanceVertices,
+																			   boxCollider.mInstanceVertices + cBoxColliderVertCount ) );
+		mMeshColliderContainer[i].update(mBoxColliderCtmContainer[i]);
+	}
+
+	mTriangleMeshBodyIndices.assign(pMeshBodyIndices, pMeshBodyIndices + meshCount);
+	mTriangleMeshColliderContainer.resize(meshCount);
+	for (size_t meshIdx = 0; meshIdx < meshCount; ++meshIdx)
+	{
+		std::vector<float> positions;
+		for (int i = pFirstVertexIndices[meshIdx]; i < pFirstVertexIndices[meshIdx + 1]; ++i)
+		{
+			positions.insert(positions.end(), { pVertices[i].x, pVertices[i].y, pVertices[i].z });
+		}
+
+		std::vector<unsigned int> elements;
+		for (int i = pFirstTriangleIndices[meshIdx]; i < pFirstTriangleIndices[meshIdx + 1]; ++i)
+		{
+			elements.insert(elements.end(), { pTriangles[i].x, pTriangles[i].y, pTriangles[i].z });
+		}
+
+		mTriangleMeshColliderContainer[meshIdx].create(positions, elements);
+	}
+
+	loadManifoldCache(view);
+
+	return true;
+}
+
+bool P3DynamicsWorld::compactCheckpoint(std::string const &basePath)
+{
+	// Unique enough to tell the bases of a run, and of runs before a crash, apart
+	uint64_t checkpointId = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+	checkpointId = std::max(checkpointId, mCheckpointBaseId + 1u);
+
+	if (!saveSnapshot(basePath, checkpointId))
+		return false;
+
+	captureCheckpointBase(checkpointId);
+	return true;
+}
+
+bool P3DynamicsWorld::saveDeltaCheckpoint(std::string const &deltaPath) const
+{
+	using P3::SnapshotSection;
+
+	// Same slots on the same generations, a body removed and another added in its slot would fool the slots alone
+	if ( !mCheckpointBaseId || mBodies.getSlots() != mCheckpointBodySlots
+		 || mBodies.getGenerations() != mCheckpointBodyGenerations )
+	{
+		return false;
+	}
+
+	std::vector<int> bodyIndices;
+	std::vector<LinearTransform> linearTransforms;
+	std::vector<AngularTransform> angularTransforms;
+	std::vector<glm::mat4> ctms;
+
+	int boxCount = static_cast<int>(mBoxColliderCtmContainer.size());
+	for (int i = 0; i < static_cast<int>(mLinearTransformContainer.size()); ++i)
+	{
+		LinearTransform const &linearTransform = mLinearTransformContainer[i];
+		AngularTransform const &angularTransform = mAngularTransformContainer[i];
+
+		if (linearTransform.flags & cStaticBodyFlag)
+			continue;
+
+		// Only where the body is counts, resting bodies jitter in their velocities and those come back as of the base
+		glm::vec3 translation = glm::vec3(linearTransform.position - mCheckpointLinearTransforms[i].position);
+		float orientationCos = std::abs(glm::dot(angularTransform.orientation, mCheckpointAngularTransforms[i].orientation));
+
+		if ( glm::dot(translation, translation) <= cCheckpointPositionTolerance * cCheckpointPositionTolerance
+			 && 1.0f - orientationCos <= cCheckpointOrientationTolerance )
+		{
+			continue;
+		}
+
+		bodyIndices.emplace_back(i);
+		linearTransforms.emplace_back(linearTransform);
+		angularTransforms.emplace_back(angularTransform);
+
+		// The collider vertices follow from these on load
+		if (i < boxCount)
+			ctms.emplace_back(mBoxColliderCtmContainer[i]);
+	}
+
+	P3::SnapshotWriter writer;
+	writer.addSection(SnapshotSection::CHECKPOINT_ID, &mCheckpointBaseId, 1);
+	writer.addSection(SnapshotSection::DELTA_BODY_INDICES, bodyIndices);
+	writer.addSection(SnapshotSection::LINEAR_TRANSFORMS, linearTransforms);
+	writer.addSection(SnapshotSection::ANGULAR_TRANSFORMS, angularTransforms);
+	writer.addSection(SnapshotSection::BOX_COLLIDER_CTMS, ctms);
+	addManifoldCache(writer);
+
+	return writer.writeFile(deltaPath);
+}
+
+bool P3DynamicsWorld::loadCheckpoint(std::string const &basePath, std::string const &deltaPath)
+{
+	using P3::SnapshotSection;
+
+	P3::MappedFile baseFile;
+	P3::SnapshotView baseView;
+	if (!baseFile.open(basePath) || !baseView.open(baseFile.getData(), baseFile.getSize()))
+		return false;
+
+	size_t idCount;
+	uint64_t const *pBaseId = baseView.getSection<uint64_t>(SnapshotSection::CHECKPOINT_ID, idCount);
+
+	// Check the delta before touching the world, so a bad pair leaves it as it was
+	P3::MappedFile deltaFile;
+	P3::SnapshotView deltaView;
+	uint64_t const *pDeltaBaseId = nullptr;
+	if (!deltaPath.empty())
+	{
+		if (!deltaFile.open(deltaPath) || !deltaView.open(deltaFile.getData(), deltaFile.getSize()))
+			return false;
+
+		pDeltaBaseId = deltaView.getSection<uint64_t>(SnapshotSection::CHECKPOINT_ID, idCount);
+		if (!pBaseId || !pDeltaBaseId || *pDeltaBaseId != *pBaseId)
+			return false;
+	}
+
+	if (!loadSnapshot(baseView))
+		return false;
+
+	captureCheckpointBase(pBaseId ? *pBaseId : 0u);
+
+	if (!pDeltaBaseId)
+		return true;
+
+	size_t deltaCount, linearCount, angularCount, ctmCount;
+	int const *pBodyIndices = deltaView.getSection<int>(SnapshotSection::DELTA_BODY_INDICES, deltaCount);
+	LinearTransform const *pLinearTransforms = deltaView.getSection<LinearTransform>(SnapshotSection::LINEAR_TRANSFORMS, linearCount);
+	AngularTransform const *pAngularTransforms = deltaView.getSection<AngularTransform>(SnapshotSection::ANGULAR_TRANSFORMS, angularCount);
+	glm::mat4 const *pCtms = deltaView.getSection<glm::mat4>(SnapshotSection::BOX_COLLIDER_CTMS, ctmCount);
+
+	// The bodies of a delta are in order, the box bodies first
+	int boxCount = static_cast<int>(mBoxColliderContainer.size());
+	for (size_t i = 0, ctmIdx = 0; i < deltaCount && i < linearCount && i < angularCount; ++i)
+	{
+		int bodyIdx = pBodyIndices[i];
+		if (bodyIdx < 0 || bodyIdx >= static_cast<int>(mLinearTransformContainer.size()))
+			continue;
+
+		mLinearTransformContainer[bodyIdx] = pLinearTransforms[i];
+		mAngularTransformContainer[bodyIdx] = pAngularTransforms[i];
+
+		if (bodyIdx < boxCount && ctmIdx < ctmCount)
+		{
+			mBoxColliderCtmContainer[bodyIdx] = pCtms[ctmIdx++];
+			mBoxColliderContainer[bodyIdx].update(mBoxColliderCtmContainer[bodyIdx]);
+			mMeshColliderContainer[bodyIdx].update(mBoxColliderCtmContainer[bodyIdx]);
+		}
+	}
+
+	loadManifoldCache(deltaView);
+
+	return true;
 }
 
-int P3DynamicsWorld::addStaticBodies(std::vector<glm::vec3> const &posContainer)
+void P3DynamicsWorld::captureCheckpointBase(uint64_t checkpointId)
 {
-	mBodyContainer.emplace_back(mUniqueID++);
-	return mUniqueID;
+	mCheckpointBaseId = checkpointId;
+	mCheckpointLinearTransforms = mLinearTransformContainer;
+	mCheckpointAngularTransforms = mAngularTransformContainer;
+	mCheckpointBodySlots = mBodies.getSlots();
+	mCheckpointBodyGenerations = mBodies.getGenerations();
 }
 
 void P3DynamicsWorld::reset()
 {
-	mBodyContainer.clear();
-	mRigidLinearTransformContainer.clear();
-	mRigidAngularTransformContainer.clear();
+	mBodies.clear();
+	mLinearTransformContainer.clear();
+	mAngularTransformContainer.clear();
 	mMeshColliderContainer.clear();
 	mBoxColliderContainer.clear();
-	mUniqueID = 0u;
+	mBoxColliderCtmContainer.clear();
+	mTriangleMeshColliderContainer.clear();
+	mTriangleMeshBodyIndices.clear();
+	mCcdRigidBodyIndices.clear();
+
+	mAccumulatedTime = 0.0f;
+	mPreviousPositions.clear();
+	mPreviousOrientations.clear();
+
+	mCheckpointBaseId = 0u;
+	mCheckpointLinearTransforms.clear();
+	mCheckpointAngularTransforms.clear();
+	mCheckpointBodySlots.clear();
+	mCheckpointBodyGenerations.clear();
 }
 
 // TODO:
@@ -490,11 +1301,9 @@ void P3DynamicsWorld::fillWorldWithBodies()
 	glm::vec3 position(0.0f);
 	float mass = 1.0f;
 
-	for (size_t i = 0; i < mMaxCapacity; ++i)
+	while (!isFull())
 	{
-		// Append unique ID
-		mBodyContainer.emplace_back(mUniqueID);
-		++mUniqueID;
+		addRigidBody(mass, position, glm::vec3(0.0f));
 	}
 }
 
@@ -9,20 +9,24 @@
 #define P3_DYNAMICS_WORLD_H
 
 #include <glm/vec3.hpp>
+#include <functional>
+#include <string>
 #include <vector>
 #include <unordered_map>
 #include <memory>
 
-#include "P3BroadPhaseCollisionDetection.h"
 #include "P3Collider.h"
 #include "P3ConstraintSolver.h"
-#include "P3OpenGLComputeSolver.h"
-#include "P3NarrowPhaseCollisionDetection.h"
+#include "P3CpuBroadPhase.h"
+#include "P3CpuNarrowPhase.h"
+#include "P3Integrator.h"
+#include "P3JobSystem.h"
 #include "P3NarrowPhaseCommon.h"
+#include "P3PhysicsBackend.h"
+#include "P3Snapshot.h"
+#include "P3SparseSet.h"
 #include "P3Transform.h"
-
-//#define BROAD_PHASE_CPU
-//#define NARROW_PHASE_CPU
+#include "P3TriangleMeshCollider.h"
 
 using LinearTransformContainerPtr = std::shared_ptr<std::vector<LinearTransform>>;
 
@@ -32,26 +36,156 @@ public:
 	P3DynamicsWorld() {}
 	P3DynamicsWorld(size_t maxCapacity) : mMaxCapacity(maxCapacity) {} // Might want error checking here
 
+	// Every stage runs on the CPU unless replaced here, e.g. by P3::createOpenGLBackends(). Call before init(),
+	//  the world owns them from then on.
+	void setBackends(P3::Backends &&);
+
+	// Only creates GL objects with GL backends set, the CPU ones need no context
 	void init();
 
-	void detectCollisions();
+	// dt is only needed for speculative contacts, to know how far each body can travel in the coming step
+	void detectCollisions(float dt = 0.0f);
 
 	void updateMultipleBoxes(float dt);
 	void updateBowlingGame(float dt);
 	void updateControllableBox(float dt, glm::vec3 const &);
 	void updateGravityTest(float dt);
 
+	// detectCollisions then updateGravityTest, as a single task graph. The stages run as tasks on the job system,
+	//  see P3JobSystem.h, each one once the stages it reads from are done, and split their loops over all the threads.
+	void step(float dt);
+
+	// detectCollisions then updateMultipleBoxes, as a single task graph like the above
+	void stepMultipleBoxes(float dt);
+
 	glm::vec3 castRay(glm::vec3 const &, glm::vec3 const &);
 
 	//---------------------- Add bodies to the world ----------------------//
 	// Is it the world responsibility to check for max capacity before adding?
-	int addRigidBody();
-	int addRigidBody(float, glm::vec3 const &, glm::vec3 const &);
-	int addRigidBody(float, glm::vec3 const &, glm::vec3 const &, glm::mat4 const &);
-	int addRigidBody(LinearTransform const &, AngularTransform const &);
+	// The returned handles stay valid until the body is removed. Body indices don't, see removeBody.
+	P3::Handle addRigidBody();
+	P3::Handle addRigidBody(float, glm::vec3 const &, glm::vec3 const &);
+	P3::Handle addRigidBody(float, glm::vec3 const &, glm::vec3 const &, glm::mat4 const &);
+	P3::Handle addRigidBody(LinearTransform const &, AngularTransform const &);
+
+	P3::Handle addStaticBody(glm::vec3 const &);
+	P3::Handle addStaticBodies(std::vector<glm::vec3> const &); // Handle of the last one
+
+	// Many boxes at once, e.g. for a level load. Every container is grown once and the bodies are filled in on all
+	//  threads, instead of growing them body by body. The same bodies as addRigidBody, or as addStaticBody for a
+	//  mass of 0. halfExtents may be left empty for unit boxes. Like the other box bodies, add them before any
+	//  triangle mesh, nothing is added otherwise. Bodies past the max capacity are dropped, only the ones added
+	//  get a handle, appended to the last argument.
+	void addBoxBodies( std::vector<float> const &masses,
+					   std::vector<glm::vec3> const &positions,
+					   std::vector<glm::vec3> const &velocities,
+					   std::vector<glm::vec3> const &halfExtents,
+					   std::vector<P3::Handle> &handles );
+
+	// Static triangle meshes take up a body index but have no box collider, and box collider i must stay body i,
+	//  so add them after all the box bodies. Box-triangle contacts are only generated by the CPU narrow phase.
+	P3::Handle addStaticMesh(std::vector<float> const &, std::vector<unsigned int> const &, glm::mat4 const & = glm::mat4(1.0f));
+
+	// Swap-and-pop, every component array stays dense. The last box body takes the index of a removed box body,
+	//  and the last body the index that frees up at the end of the boxes, so box collider i is still body i.
+	//  Returns false for a handle that was already removed.
+	bool removeBody(P3::Handle);
+
+	// -1 once the body is removed
+	int getBodyIndex(P3::Handle handle) const { return mBodies.getIndex(handle); }
+	P3::Handle getBodyHandle(int bodyIdx) const { return mBodies.getHandle(bodyIdx); }
+
+	// Opt-in continuous collision for fast rigid bodies, e.g. projectiles. Their sweep over a timestep stops at the
+	//  first box or triangle in the way, instead of tunneling through thin geometry. The other dynamic bodies are
+	//  swept as they move, and a hit on one ends the sweep there, for the solver to share the momentum next step. At a
+	//  static hit the velocity into the obstacle is dropped, and the body slides on for the rest of the step, over a
+	//  few sub-steps at most.
+	void setContinuousCollision(int rigidBodyIdx, bool isEnabled);
+
+	// Cheaper alternative to the above, for every body at once. Box pairs that are apart but could meet within the step
+	//  get contacts with a positive separation, and the solver only lets them close that gap. CPU broad and narrow phases only.
+	void setSpeculativeContacts(bool isEnabled) { mIsSpeculativeContactEnabled = isEnabled; }
+
+	// Solves the contacts 8 at a time with SIMD. CPU solver only.
+	void setWideContactSolve(bool isEnabled) { mConstraintSolver.setWideContactSolve(isEnabled); }
+
+	// Solves each island of touching bodies on its own thread instead. CPU solver only.
+	void setIslandSolve(bool isEnabled) { mConstraintSolver.setIslandSolve(isEnabled); }
+
+	// Solves the normal impulses of each box-box manifold together, stacks settle in fewer iterations. CPU solver only.
+	void setBlockSolve(bool isEnabled) { mConstraintSolver.setBlockSolve(isEnabled); }
+
+	// Pushes penetrating bodies apart in a separate position pass, instead of through their velocities. CPU solver only.
+	void setSplitImpulse(bool isEnabled) { mConstraintSolver.setSplitImpulse(isEnabled); }
+
+	// One last bottom-up iteration with the lower body of every contact frozen, for tall stacks. CPU solver only.
+	void setShockPropagation(bool isEnabled) { mConstraintSolver.setShockPropagation(isEnabled); }
+
+	// Temporal Gauss-Seidel: substepCount sub-steps of a few iterations each instead of all the iterations at once.
+	//  The narrow phase still runs once per step. 1 sub-step goes back to the regular solver. CPU solver only.
+	void setSubstepping(int substepCount, int iterationsPerSubstep) { mConstraintSolver.setSubstepping(substepCount, iterationsPerSubstep); }
+
+	// The solvers stop iterating once no contact impulse changes by more than the tolerance, within these bounds
+	void setSolverIterationBounds(int minIterationCount, int maxIterationCount)
+	{
+		mConstraintSolver.setIterationBounds({ minIterationCount, maxIterationCount });
+		mpSolver->setIterationBounds({ minIterationCount, maxIterationCount });
+	}
+
+	void setSolverResidualTolerance(float tolerance)
+	{
+		mConstraintSolver.setResidualTolerance(tolerance);
+		mpSolver->setResidualTolerance(tolerance);
+	}
+
+	// Overrides the bounds above for some islands, island solve only
+	void setIslandIterationBounds(std::function<P3::IterationBounds(int islandIdx)> const &func)
+	{
+		mConstraintSolver.setIslandIterationBounds(func);
+	}
+
+	P3::IslandSet const &getIslands() const { return mConstraintSolver.getIslands(); }
+
+	//------------------------ Fixed timestep ------------------------//
+	// Physics always steps by fixedDt, whatever the frame rate. The frame times are banked, and each advance runs as
+	//  many steps as the bank holds, at most maxCatchUpSteps. Past that the rest is dropped and the simulation falls
+	//  behind real time, rather than spending ever longer frames catching up.
+	void setFixedTimeStep(float fixedDt, int maxCatchUpSteps = 4);
+	float getFixedTimeStep() const { return mFixedDt; }
+
+	// step is whichever update the caller runs per tick, detection included, and gets called with the fixed dt.
+	//  Returns how many steps were taken, 0 when the frame was shorter than what is left to the next one.
+	int advance(float frameDt, std::function<void(float)> const &step);
+
+	// How far the time left in the bank is towards the next step, from 0 to 1
+	float getInterpolationFactor() const { return mAccumulatedTime / mFixedDt; }
+
+	// One world transform per body, blended between the last two steps by the factor above, so the renders in
+	//  between steps don't stutter. Bodies added since the last step show where they are.
+	void computeInterpolatedTransforms(std::vector<glm::mat4> &) const;
 
-	int addStaticBody(glm::vec3 const &);
-	int addStaticBodies(std::vector<glm::vec3> const &);
+	//------------------------ Snapshots ------------------------//
+	// Every body with its components and colliders, the handles, the triangle meshes and, with the CPU narrow phase,
+	//  the contact cache the next step warm starts from. See P3Snapshot.h for the format. Loading replaces the
+	//  whole world. The broad phases keep nothing between steps, they rebuild from the colliders every step.
+	bool saveSnapshot(std::string const &path) const;
+	bool loadSnapshot(std::string const &path);
+
+	// The view's memory is only read during the call, e.g. a file mapped just for the load
+	bool loadSnapshot(P3::SnapshotView const &);
+
+	// Checkpoints for crash recovery. A base is a full snapshot, a delta only holds the bodies whose transforms
+	//  moved or turned since the base, past a small tolerance, so static and resting bodies cost nothing to write.
+	//  Deltas don't chain: each one holds everything since the base, so recovering takes the base and the latest
+	//  delta only.
+	//  Compaction writes the current world as a new base that the next deltas start from.
+	bool compactCheckpoint(std::string const &basePath);
+
+	// Fails without writing if there is no base yet, or if bodies were added or removed since, compact then
+	bool saveDeltaCheckpoint(std::string const &deltaPath) const;
+
+	// An empty delta path loads the base alone. The base becomes the one the next deltas start from.
+	bool loadCheckpoint(std::string const &basePath, std::string const &deltaPath);
 
 	//------------------------ Demos ------------------------//
 	void reset();
@@ -65,92 +199,122 @@ public:
 	//----------------------- Some getters and setters -----------------------//
 	float getGravity() const { return mGravity; }
 	float getAirDrag() const { return mAirDrag; }
-	unsigned int getOccupancy() const { return mBodyContainer.size(); }
+	unsigned int getOccupancy() const { return mBodies.size(); }
 	unsigned int getNumBoxColliders() const { return mBoxColliderContainer.size(); }
 	unsigned int getMaxCapacity() const { return mMaxCapacity; }
-	unsigned int getRigidBodyCount() const { return mRigidLinearTransformContainer.size(); }
+	unsigned int getBodyCount() const { return mLinearTransformContainer.size(); }
 	std::vector<P3BoxCollider> const &getBoxColliders() const { return mBoxColliderContainer; }
+	std::vector<P3::TriangleMeshCollider> const &getTriangleMeshColliders() const { return mTriangleMeshColliderContainer; }
 
-	std::vector<LinearTransform> const &getRigidLinearTransformContainer() const
+	// One entry per body, static ones included, in the order they were added. LinearTransform::flags tells them apart.
+	std::vector<LinearTransform> const &getLinearTransformContainer() const
 	{
-		return mRigidLinearTransformContainer;
+		return mLinearTransformContainer;
 	}
 
-	std::vector<LinearTransform> const &getStaticLinearTransformContainer() const
+	std::vector<AngularTransform> const &getAngularTransformContainer() const
 	{
-		return mStaticLinearTransformContainer;
+		return mAngularTransformContainer;
 	}
 
-	std::vector<AngularTransform> const &getRigidAngularTransformContainer() const
-	{
-		return mRigidAngularTransformContainer;
-	}
-
-	std::vector<AngularTransform> const &getStaticAngularTransformContainer() const
-	{
-		return mStaticAngularTransformContainer;
-	}
-
-	CollisionPairGpuPackage const *getPCollisionPairPkg() const
-	{
-#ifdef BROAD_PHASE_CPU
-		return mCpuBroadPhase.getPCollisionPkg();
-#else
-		return mGpuBroadPhase.getPCollisionPairPkg();
-#endif // BROAD_PHASE_CPU
-	}
-
-	ManifoldGpuPackage *getPManifoldPkg()
-	{
-#ifdef NARROW_PHASE_CPU
-		return mpManifoldPkg;
-#else
-		return mGpuNarrowPhase.getPManifoldPkg();
-#endif // NARROW_PHASE_CPU
-	}
+	CollisionPairGpuPackage const *getPCollisionPairPkg() const { return mpBroadPhase->getPCollisionPairPkg(); }
+	ManifoldGpuPackage *getPManifoldPkg() { return mpNarrowPhase->getPManifoldPkg(); }
 
 	void setGravity(float gravity) { mGravity = gravity; }
 	void setMaxCapacity(const int maxCapacity) { mMaxCapacity = maxCapacity; } // Need error checking
 
-	bool isFull() { return mBodyContainer.size() >= mMaxCapacity; }
+	bool isFull() { return static_cast<size_t>(mBodies.size()) >= mMaxCapacity; }
 
 private:
+	// Where a CCD body gets to over the step, and its velocity once there
+	void computeCcdMotion(int rigidBodyIdx, glm::vec3 &displacement, glm::vec3 &velocity) const;
+
+	// Fraction of the displacement the CCD body, moved by the offset, travels before it hits something, 1 if it
+	//  doesn't. The other dynamic bodies start from where the elapsed fraction of the step took them, and move on
+	//  over the sweep time. On a hit, the normal points at what was hit.
+	float sweepCcdBody( int rigidBodyIdx, glm::vec3 const &offset, float elapsedFraction,
+						glm::vec3 const &displacement, float sweepDt, glm::vec3 &hitNormal, bool &isDynamicHit ) const;
+
+	// The tasks of detectCollisions, of updateGravityTest and of updateMultipleBoxes, the first ones depending on the
+	//  given task. Return their last task, for what comes next.
+	int addCollisionTasks(P3::TaskGraph &, int dependencyIdx);
+	int addDynamicsTasks(P3::TaskGraph &, int dependencyIdx);
+	int addMultipleBoxesTasks(P3::TaskGraph &, int dependencyIdx);
+
+	bool saveSnapshot(std::string const &path, uint64_t checkpointId) const;
+	void addManifoldCache(P3::SnapshotWriter &) const;
+	void loadManifoldCache(P3::SnapshotView const &);
+
+	// Keeps what the deltas are compared against
+	void captureCheckpointBase(uint64_t checkpointId);
+
+	// Copies every component of a body to another index, the one there is overwritten
+	void moveBody(int fromBodyIdx, int toBodyIdx);
+
 	//---------------- Constant physics quantities ----------------//
 	float mGravity{ 0.001f }, mAirDrag{ 2.0f };
 	size_t mMaxCapacity{ cMaxObjectCount };
 
 	//------------------------- Entity list -------------------------//
-	std::vector<int> mBodyContainer;
-	int mUniqueID = 0u;
+	P3::SparseSet mBodies; // Handle of each body index, and back
 
 	//----------------------- Component list -----------------------//
-	std::vector<LinearTransform> mRigidLinearTransformContainer;
-	std::vector<AngularTransform> mRigidAngularTransformContainer;
-	std::vector<LinearTransform> mStaticLinearTransformContainer;
-	std::vector<AngularTransform> mStaticAngularTransformContainer;
+	std::vector<LinearTransform> mLinearTransformContainer; // Indexed by body, whether static, kinematic or dynamic
+	std::vector<AngularTransform> mAngularTransformContainer;
 	std::vector<P3MeshCollider> mMeshColliderContainer;
 	std::vector<P3BoxCollider> mBoxColliderContainer;
 	std::vector<glm::mat4> mBoxColliderCtmContainer;
+	std::vector<P3::TriangleMeshCollider> mTriangleMeshColliderContainer;
+	std::vector<int> mTriangleMeshBodyIndices;
+	std::vector<int> mCcdRigidBodyIndices;
+	bool mIsSpeculativeContactEnabled = false;
+
+	//----------------------- Fixed timestep -----------------------//
+	float mFixedDt = 1.0f / 60.0f;
+	int mMaxCatchUpSteps = 4;
+	float mAccumulatedTime = 0.0f;
+	std::vector<glm::vec3> mPreviousPositions; // Before the last step, for the interpolation
+	std::vector<glm::quat> mPreviousOrientations;
+
+	//------------------------ Checkpoints ------------------------//
+	uint64_t mCheckpointBaseId = 0u; // 0 until there is a base
+	std::vector<LinearTransform> mCheckpointLinearTransforms; // As of the base
+	std::vector<AngularTransform> mCheckpointAngularTransforms;
+	std::vector<uint32_t> mCheckpointBodySlots;
+	std::vector<uint32_t> mCheckpointBodyGenerations;
 
 	//----------------- Data package optimized for the GPU -----------------//
 	LinearTransformGpuPackage mLinearTransformPkg; // For rigid and kinematic bodies
-	ManifoldGpuPackage *mpManifoldPkg;
-
-	//----------------- Map of index to rigid body -----------------//
-	// @reference: https://austinmorlan.com/posts/entity_component_system/
-	//std::unordered_map<int, int> mEntityToIndexMap;
-	//std::unordered_map<int, int> mIndexToEntityMap;
+	ManifoldGpuPackage *mpManifoldPkg = nullptr;
+
+	//------------------- Per step, kept for their storage -------------------//
+	std::vector<glm::vec3> mSweeps; // Per box, for speculative contacts
+	std::vector<int> mDynamicBoxIndices;
+	std::vector<float> mStepFractions; // Per body, for CCD
+	std::vector<glm::vec3> mCcdDisplacements; // Per CCD body
+	std::vector<glm::vec3> mCcdVelocities;
+
+	// Built on the first step that needs them, the tasks read the time step of the current one
+	P3::TaskGraph mStepGraph;
+	P3::TaskGraph mCollisionGraph;
+	P3::TaskGraph mDynamicsGraph;
+	P3::TaskGraph mMultipleBoxesStepGraph;
+	P3::TaskGraph mMultipleBoxesGraph;
+	float mStepDt = 0.0f;
 
 	//--------------------- Physics pipeline ---------------------//
 	// Order of operations for each timestep: Collision -> apply forces -> solve constraints -> update positions
-	P3OpenGLComputeBroadPhase mGpuBroadPhase;
 	P3::CpuBroadPhase mCpuBroadPhase;
-
-	P3OpenGLComputeNarrowPhase mGpuNarrowPhase;
 	P3::CpuNarrowPhase mCpuNarrowPhase;
-
 	P3ConstraintSolver mConstraintSolver; // Produces forces to make sure things don't phase past each other
-	P3OpenGLComputeSolver mOglConstraintSolver;
+
+	// The stages that run, the CPU ones above unless others were set
+	P3::Backends mBackends;
+	P3::BroadPhaseBackend *mpBroadPhase = &mCpuBroadPhase;
+	P3::NarrowPhaseBackend *mpNarrowPhase = &mCpuNarrowPhase;
+	P3::SolverBackend *mpSolver = &mConstraintSolver;
+
+	P3Integrator mIntegrator; // Applies the forces, then the final velocities
 };
 
 #endif // P3_DYNAMICS_WORLD_H
@@ -1,6 +1,7 @@
 #include "P3Epa.h"
 
 #include "P3Collider.h"
+#include "P3FrameArena.h"
 #include "P3Simplex.h"
 
 /**
@@ -13,9 +14,9 @@
  */
 void P3Epa(P3Collider const &colliderA, P3Collider const &colliderB, P3Simplex &gjkSimplex)
 {
-	std::vector<SupportPoint> vertices;
-	std::vector<TriangleSimplex> triangles;
-	std::vector<EdgeSimplex> directedEdges;
+	P3::FrameVector<SupportPoint> vertices;
+	P3::FrameVector<TriangleSimplex> triangles;
+	P3::FrameVector<EdgeSimplex> directedEdges;
 
 	// Blow up simplex to tetrahedron (in the case that the simplex returned
 	//  by the gjk doesn't have 4 support points) - however, the current
@@ -0,0 +1,92 @@
+#include "P3FrameArena.h"
+
+#include <new>
+
+namespace
+{
+// Enough for the scratch data of a few hundred boxes before the first merge
+constexpr size_t cDefaultFrameArenaCapacity = 1u << 20;
+
+size_t alignOffset(size_t offset, size_t alignment)
+{
+	return (offset + alignment - 1u) & ~(alignment - 1u);
+}
+}
+
+P3::FrameArena::FrameArena(size_t capacity)
+	: mCapacity(capacity ? capacity : cDefaultFrameArenaCapacity)
+{
+	mpBlock.reset(new unsigned char[mCapacity]);
+}
+
+void *P3::FrameArena::allocate(size_t size, size_t alignment)
+{
+	// new[] aligns for any fundamental type, so offsets aligned within the block are aligned in memory
+	size_t offset = alignOffset(mOffset, alignment);
+	if (offset + size <= mCapacity)
+	{
+		mOffset = offset + size;
+		return mpBlock.get() + offset;
+	}
+
+	mOverflowBlocks.emplace_back(new unsigned char[size]);
+	mOverflowSize += size;
+
+	return mOverflowBlocks.back().get();
+}
+
+void P3::FrameArena::reset()
+{
+	mOffset = 0u;
+
+	if (mOverflowBlocks.empty())
+		return;
+
+	// Headroom, so a step slightly bigger than this one doesn't overflow again
+	mCapacity = 2u * (mCapacity + mOverflowSize);
+	mpBlock.reset(new unsigned char[mCapacity]);
+
+	mOverflowBlocks.clear();
+	mOverflowSize = 0u;
+}
+
+P3::FrameArena &P3::getFrameArena()
+{
+	thread_local FrameArena frameArena;
+	return frameArena;
+}
+
+P3::FrameArenaScope::~FrameArenaScope()
+{
+	Node *pNode = mpFirstNode;
+	while (pNode)
+	{
+		// The node is in the arena, it may be gone once that is reset
+		FrameArena &arena = *pNode->pArena;
+		pNode = pNode->pNext;
+
+		std::lock_guard<std::mutex> lock(arena.mScopeMutex);
+		if (!--arena.mScopeCount)
+			arena.reset();
+	}
+}
+
+void P3::FrameArenaScope::add()
+{
+	FrameArena &arena = getFrameArena();
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	for (Node *pNode = mpFirstNode; pNode; pNode = pNode->pNext)
+	{
+		if (pNode->pArena == &arena)
+			return;
+	}
+
+	{
+		std::lock_guard<std::mutex> arenaLock(arena.mScopeMutex);
+		++arena.mScopeCount;
+	}
+
+	mpFirstNode = new (arena.allocate(sizeof(Node), alignof(Node))) Node{ &arena, mpFirstNode };
+}
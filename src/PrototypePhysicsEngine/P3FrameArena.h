@@ -0,0 +1,126 @@
+/**
+ * Linear allocator for the scratch data of a step. Allocating bumps an offset into a block kept from step to step,
+ *  freeing does nothing, and the whole arena is reset at once when the step is done. Once the block is big enough
+ *  for the largest step so far, stepping doesn't go through the heap at all.
+ *
+ * Each thread has an arena of its own, so the stages running on the job system allocate without locking. What is
+ *  allocated from them must not outlive the run of the job system: only locals, never members or anything returned
+ *  to the caller. A run resets the arenas it allocated from once it's done, each one as soon as no other run still
+ *  uses it, so the runs of two worlds stepping at the same time don't free each other's data.
+ */
+
+#pragma once
+
+#ifndef P3_FRAME_ARENA_H
+#define P3_FRAME_ARENA_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace P3
+{
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t capacity = 0u);
+
+	FrameArena(FrameArena const &) = delete;
+	FrameArena &operator=(FrameArena const &) = delete;
+
+	void *allocate(size_t size, size_t alignment);
+
+	// Frees everything at once. What didn't fit in the block this step goes to blocks of its own meanwhile, they
+	//  are merged into a bigger block here so the next steps fit.
+	void reset();
+
+	size_t getCapacity() const { return mCapacity; }
+
+private:
+	friend class FrameArenaScope;
+
+	std::unique_ptr<unsigned char[]> mpBlock;
+	size_t mCapacity;
+	size_t mOffset = 0u;
+
+	std::vector<std::unique_ptr<unsigned char[]>> mOverflowBlocks;
+	size_t mOverflowSize = 0u;
+
+	// Runs with allocations in the arena, it's reset when the last one is done
+	std::mutex mScopeMutex;
+	int mScopeCount = 0;
+};
+
+// The arena of the calling thread
+FrameArena &getFrameArena();
+
+// The arenas a run of the job system allocated from, reset on destruction unless another run still uses them
+class FrameArenaScope
+{
+public:
+	FrameArenaScope() {}
+	~FrameArenaScope();
+
+	FrameArenaScope(FrameArenaScope const &) = delete;
+	FrameArenaScope &operator=(FrameArenaScope const &) = delete;
+
+	// Adds the arena of the calling thread, before it allocates for the run. Adding it again does nothing.
+	void add();
+
+private:
+	// Allocated from the arena they point to, so adding doesn't go through the heap
+	struct Node
+	{
+		FrameArena *pArena;
+		Node *pNext;
+	};
+
+	std::mutex mMutex;
+	Node *mpFirstNode = nullptr;
+};
+
+// For standard containers, allocates from the arena of the thread that constructs it. The threads of a loop on the
+//  job system must each fill containers of their own, not grow one shared with the others.
+template<typename T>
+class FrameAllocator
+{
+public:
+	using value_type = T;
+
+	FrameAllocator() : mpArena(&getFrameArena()) {}
+
+	template<typename U>
+	FrameAllocator(FrameAllocator<U> const &other) : mpArena(other.mpArena) {}
+
+	T *allocate(size_t count) { return static_cast<T *>(mpArena->allocate(count * sizeof(T), alignof(T))); }
+	void deallocate(T *, size_t) {}
+
+	template<typename U>
+	bool operator==(FrameAllocator<U> const &other) const { return mpArena == other.mpArena; }
+
+	template<typename U>
+	bool operator!=(FrameAllocator<U> const &other) const { return mpArena != other.mpArena; }
+
+private:
+	template<typename U>
+	friend class FrameAllocator;
+
+	FrameArena *mpArena;
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+using FrameUnorderedMap = std::unordered_map<Key, Value, Hash, std::equal_to<Key>, FrameAllocator<std::pair<Key const, Value>>>;
+
+template<typename Key, typename Hash = std::hash<Key>>
+using FrameUnorderedSet = std::unordered_set<Key, Hash, std::equal_to<Key>, FrameAllocator<Key>>;
+}
+
+#endif // P3_FRAME_ARENA_H
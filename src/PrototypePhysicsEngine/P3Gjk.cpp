@@ -3,6 +3,9 @@
 #include "P3Collider.h"
 #include "P3Simplex.h"
 
+#include <algorithm>
+#include <limits>
+
 #define SAME_DIRECTION(a, b) glm::dot(a, b) > 0.0001f
 
 bool checkLine(P3Simplex &gjkSimplex, glm::vec3 &direction)
@@ -151,4 +154,184 @@ bool P3Gjk(P3Collider const &colliderA, P3Collider const &colliderB, P3Simplex &
 		if (nextSimplex(gjkSimplex, direction))
 			return true;
 	}
+}
+
+namespace
+{
+constexpr int cGjkDistanceMaxIterations = 32;
+constexpr float cGjkDistanceTolerance = 0.000001f; // Relative to the squared distance
+
+// Closest point to the origin on segment ab. The simplex is reduced to the vertices that span it.
+glm::vec3 closestPointOnLine(glm::vec3 (&simplex)[4], int &size)
+{
+	glm::vec3 a = simplex[0], b = simplex[1];
+	glm::vec3 ab = b - a;
+
+	float t = glm::dot(-a, ab);
+	if (t <= 0.0f)
+	{
+		size = 1;
+		return a;
+	}
+
+	float denom = glm::dot(ab, ab);
+	if (t >= denom)
+	{
+		simplex[0] = b;
+		size = 1;
+		return b;
+	}
+
+	return a + (t / denom) * ab;
+}
+
+// Ericson's ClosestPtPointTriangle, with the origin as the query point
+glm::vec3 closestPointOnTriangle(glm::vec3 (&simplex)[4], int &size)
+{
+	glm::vec3 a = simplex[0], b = simplex[1], c = simplex[2];
+	glm::vec3 ab = b - a, ac = c - a, ap = -a;
+
+	float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f)
+	{
+		size = 1;
+		return a;
+	}
+
+	glm::vec3 bp = -b;
+	float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3)
+	{
+		simplex[0] = b;
+		size = 1;
+		return b;
+	}
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+	{
+		size = 2;
+		return a + (d1 / (d1 - d3)) * ab;
+	}
+
+	glm::vec3 cp = -c;
+	float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6)
+	{
+		simplex[0] = c;
+		size = 1;
+		return c;
+	}
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+	{
+		simplex[1] = c;
+		size = 2;
+		return a + (d2 / (d2 - d6)) * ac;
+	}
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+	{
+		simplex[0] = c;
+		size = 2;
+		return b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+	}
+
+	float denom = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Is the origin on the other side of face abc than d
+bool isOriginOutsideFace(glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c, glm::vec3 const &d)
+{
+	glm::vec3 normal = glm::cross(b - a, c - a);
+	float signOrigin = glm::dot(-a, normal);
+	float signD = glm::dot(d - a, normal);
+
+	return signOrigin * signD <= 0.0f; // A flat tetrahedron has no inside, so every face counts
+}
+
+// Closest point on the tetrahedron is on one of the faces the origin is outside of. If there are none, the
+//  origin is inside and the size is set to 4.
+glm::vec3 closestPointOnTetrahedron(glm::vec3 (&simplex)[4], int &size)
+{
+	static const int faces[4][4] = { { 0, 1, 2, 3 }, { 0, 2, 3, 1 }, { 0, 3, 1, 2 }, { 1, 3, 2, 0 } };
+
+	glm::vec3 closestPoint(0.0f);
+	glm::vec3 closestSimplex[4];
+	float minDistanceSq = std::numeric_limits<float>::max();
+	int closestSize = 4;
+
+	for (int i = 0; i < 4; ++i)
+	{
+		glm::vec3 const &a = simplex[faces[i][0]];
+		glm::vec3 const &b = simplex[faces[i][1]];
+		glm::vec3 const &c = simplex[faces[i][2]];
+
+		if (!isOriginOutsideFace(a, b, c, simplex[faces[i][3]])) continue;
+
+		glm::vec3 faceSimplex[4] = { a, b, c, glm::vec3(0.0f) };
+		int faceSize = 3;
+		glm::vec3 point = closestPointOnTriangle(faceSimplex, faceSize);
+		float distanceSq = glm::dot(point, point);
+
+		if (distanceSq < minDistanceSq)
+		{
+			minDistanceSq = distanceSq;
+			closestPoint = point;
+			closestSize = faceSize;
+			std::copy(faceSimplex, faceSimplex + 4, closestSimplex);
+		}
+	}
+
+	if (closestSize < 4)
+		std::copy(closestSimplex, closestSimplex + 4, simplex);
+
+	size = closestSize;
+	return closestPoint;
+}
+}
+
+float P3GjkDistance(P3Collider const &colliderA, P3Collider const &colliderB, glm::vec3 &separatingAxis)
+{
+	glm::vec3 simplex[4];
+	int size = 1;
+
+	simplex[0] = SupportPoint(colliderA, colliderB, glm::vec3(1.0f, 0.0f, 0.0f)).mMinkowskiDiffPoint;
+	glm::vec3 closestPoint = simplex[0];
+
+	for (int i = 0; i < cGjkDistanceMaxIterations; ++i)
+	{
+		float distanceSq = glm::dot(closestPoint, closestPoint);
+
+		// Origin is on the Minkowski difference, so the colliders touch
+		if (distanceSq <= cGjkDistanceTolerance)
+			return 0.0f;
+
+		glm::vec3 supportPoint = SupportPoint(colliderA, colliderB, -closestPoint).mMinkowskiDiffPoint;
+
+		// The new support point can't get any closer to the origin than the current closest point
+		if (distanceSq - glm::dot(closestPoint, supportPoint) <= cGjkDistanceTolerance * distanceSq)
+			break;
+
+		simplex[size++] = supportPoint;
+
+		switch (size)
+		{
+		case 2: closestPoint = closestPointOnLine(simplex, size); break;
+		case 3: closestPoint = closestPointOnTriangle(simplex, size); break;
+		case 4: closestPoint = closestPointOnTetrahedron(simplex, size); break;
+		}
+
+		if (size == 4)
+			return 0.0f;
+	}
+
+	// The closest point of A - B points from B to A
+	float distance = glm::length(closestPoint);
+	separatingAxis = -closestPoint / distance;
+
+	return distance;
 }
\ No newline at end of file
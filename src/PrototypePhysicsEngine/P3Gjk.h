@@ -3,6 +3,8 @@
 #ifndef P3_GJK_H
 #define P3_GJK_H
 
+#include <glm/vec3.hpp>
+
 class P3Collider;
 class P3Simplex;
 
@@ -11,4 +13,12 @@ class P3Simplex;
  */
 bool P3Gjk(P3Collider const &, P3Collider const &, P3Simplex &);
 
+/**
+ * Distance between 2 convex colliders, 0 if they overlap. The separating axis is set to the
+ *  direction from the closest point of A to the closest point of B, normalized.
+ *
+ * Reference: Christer Ericson, "Real-Time Collision Detection", ch 5.1 and 9.5
+ */
+float P3GjkDistance(P3Collider const &, P3Collider const &, glm::vec3 &);
+
 #endif // P3_GJK_H
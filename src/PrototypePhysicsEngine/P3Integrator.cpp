@@ -1 +1,169 @@
 #include "P3Integrator.h"
+
+#include <algorithm>
+
+#include "P3Collider.h"
+#include "P3JobSystem.h"
+#include "P3Simd.h"
+#include "P3Transform.h"
+
+namespace
+{
+constexpr int cLaneCount = P3::cSimdLaneCount;
+constexpr int cBlocksPerTask = 32;
+
+// Up to 8 bodies, structure of arrays
+struct BodyLanes
+{
+	float positions[3][cLaneCount];
+	float velocities[3][cLaneCount];
+	float angularVelocities[3][cLaneCount];
+	float orientations[4][cLaneCount];
+	float fractions[cLaneCount];
+	float rotations[3][3][cLaneCount]; // Columns, written by integrateLanes
+};
+
+namespace ScalarKernel
+{
+using namespace P3::Scalar;
+#include "P3IntegratorKernel.inl"
+}
+
+#ifdef P3_SIMD_AVX2
+P3_AVX2_BEGIN
+
+namespace Avx2Kernel
+{
+using namespace P3::Avx2;
+#include "P3IntegratorKernel.inl"
+}
+
+P3_AVX2_END
+#endif
+
+void integrateLanes(BodyLanes &lanes, float dt)
+{
+#ifdef P3_SIMD_AVX2
+	if (P3::hasAvx2())
+	{
+		Avx2Kernel::integrateLanes(lanes, dt);
+		return;
+	}
+#endif
+
+	ScalarKernel::integrateLanes(lanes, dt);
+}
+
+void packLane(float (&dst)[3][cLaneCount], int lane, glm::vec3 const &v)
+{
+	dst[0][lane] = v.x;
+	dst[1][lane] = v.y;
+	dst[2][lane] = v.z;
+}
+
+glm::vec3 unpackLane(float const (&src)[3][cLaneCount], int lane)
+{
+	return glm::vec3(src[0][lane], src[1][lane], src[2][lane]);
+}
+
+// Up to 8 bodies starting at firstBodyIdx
+void integrateBlock( int firstBodyIdx,
+					 std::vector<LinearTransform> &linearTransformContainer,
+					 std::vector<AngularTransform> &angularTransformContainer,
+					 std::vector<float> const &stepFractions,
+					 float dt,
+					 std::vector<glm::mat4> &worldTransforms,
+					 std::vector<P3BoxCollider> &boxColliders )
+{
+	int bodyCount = static_cast<int>(linearTransformContainer.size());
+	int laneCount = std::min(cLaneCount, bodyCount - firstBodyIdx);
+
+	// Unused lanes get a unit quaternion, so the normalization has nothing to divide by 0
+	BodyLanes lanes = {};
+	std::fill(lanes.orientations[0], lanes.orientations[0] + cLaneCount, 1.0f);
+
+	for (int lane = 0; lane < laneCount; ++lane)
+	{
+		LinearTransform const &linearTransform = linearTransformContainer[firstBodyIdx + lane];
+		AngularTransform const &angularTransform = angularTransformContainer[firstBodyIdx + lane];
+
+		packLane(lanes.positions, lane, glm::vec3(linearTransform.position));
+		packLane(lanes.velocities, lane, glm::vec3(linearTransform.velocity));
+		packLane(lanes.angularVelocities, lane, glm::vec3(angularTransform.angularVelocity));
+		lanes.orientations[0][lane] = angularTransform.orientation.w;
+		lanes.orientations[1][lane] = angularTransform.orientation.x;
+		lanes.orientations[2][lane] = angularTransform.orientation.y;
+		lanes.orientations[3][lane] = angularTransform.orientation.z;
+		lanes.fractions[lane] = stepFractions[firstBodyIdx + lane];
+	}
+
+	integrateLanes(lanes, dt);
+
+	int colliderLaneCount = std::max(0, std::min(laneCount, static_cast<int>(boxColliders.size()) - firstBodyIdx));
+
+	for (int lane = 0; lane < laneCount; ++lane)
+	{
+		int bodyIdx = firstBodyIdx + lane;
+		LinearTransform &linearTransform = linearTransformContainer[bodyIdx];
+		if (linearTransform.flags & cStaticBodyFlag)
+			continue;
+
+		glm::vec3 bodyPosition = unpackLane(lanes.positions, lane);
+		linearTransform.position = glm::vec4(bodyPosition, linearTransform.position.w);
+		angularTransformContainer[bodyIdx].orientation = glm::quat( lanes.orientations[0][lane], lanes.orientations[1][lane],
+																	lanes.orientations[2][lane], lanes.orientations[3][lane] );
+
+		if (lane >= colliderLaneCount)
+			continue;
+
+		worldTransforms[bodyIdx] = glm::mat4( glm::vec4(unpackLane(lanes.rotations[0], lane), 0.0f),
+											  glm::vec4(unpackLane(lanes.rotations[1], lane), 0.0f),
+											  glm::vec4(unpackLane(lanes.rotations[2], lane), 0.0f),
+											  glm::vec4(bodyPosition, 1.0f) );
+
+		glm::mat4 const &model = worldTransforms[bodyIdx];
+		P3BoxCollider &boxCollider = boxColliders[bodyIdx];
+		for (int i = 0; i < cBoxColliderVertCount; ++i)
+		{
+			glm::vec4 const &v = boxCollider.mInstanceVertices[i];
+			boxCollider.mVertices[i] = model[0] * v.x + model[1] * v.y + model[2] * v.z + model[3] * v.w;
+			boxCollider.mVertices[i].w = 1.0f;
+		}
+	}
+}
+}
+
+void P3Integrator::integrateVelocities(std::vector<LinearTransform> &linearTransformContainer, glm::vec3 const &gravity, float dt)
+{
+	glm::vec4 deltaVelocity(gravity * dt, 0.0f);
+
+	for (LinearTransform &linearTransform : linearTransformContainer)
+	{
+		if (isDynamicBody(linearTransform.flags))
+			linearTransform.velocity += deltaVelocity;
+	}
+}
+
+void P3Integrator::integratePositions( std::vector<LinearTransform> &linearTransformContainer,
+									   std::vector<AngularTransform> &angularTransformContainer,
+									   std::vector<float> const &stepFractions,
+									   float dt,
+									   std::vector<glm::mat4> &worldTransforms,
+									   std::vector<P3BoxCollider> &boxColliders )
+{
+	int blockCount = (static_cast<int>(linearTransformContainer.size()) + cLaneCount - 1) / cLaneCount;
+
+	P3::getJobSystem().parallelFor(blockCount, cBlocksPerTask, [&](int begin, int end)
+	{
+		for (int blockIdx = begin; blockIdx < end; ++blockIdx)
+		{
+			integrateBlock( blockIdx * cLaneCount,
+							linearTransformContainer,
+							angularTransformContainer,
+							stepFractions,
+							dt,
+							worldTransforms,
+							boxColliders );
+		}
+	});
+}
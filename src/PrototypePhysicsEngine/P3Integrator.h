@@ -3,9 +3,35 @@
 #ifndef P3_INTEGRATOR
 #define P3_INTEGRATOR
 
+#include <glm/glm.hpp>
+#include <vector>
+
+
+struct AngularTransform;
+struct LinearTransform;
+struct P3BoxCollider;
+
+/**
+ * Moves the bodies over a step, before and after the solver. Static bodies are left alone.
+ *
+ * The positions are integrated 8 bodies at a time, one per SIMD lane: their positions, velocities,
+ *  orientations and angular velocities are transposed into structure of arrays, advanced, and the rotation
+ *  matrices built from the results. The world transforms and box colliders are refreshed in the same pass,
+ *  while the bodies are still in cache. Blocks of bodies are spread over the job system.
+ */
 class P3Integrator
 {
+public:
+	void integrateVelocities(std::vector<LinearTransform> &, glm::vec3 const &gravity, float dt);
 
+	// Each body advances by its step fraction of dt, 1 unless CCD already moved it. Box collider i is body i,
+	//  bodies past the last box collider only get their transforms integrated.
+	void integratePositions( std::vector<LinearTransform> &,
+							 std::vector<AngularTransform> &,
+							 std::vector<float> const &stepFractions,
+							 float dt,
+							 std::vector<glm::mat4> &worldTransforms,
+							 std::vector<P3BoxCollider> & );
 };
 
-#endif // P3_INTEGRATOR
\ No newline at end of file
+#endif // P3_INTEGRATOR
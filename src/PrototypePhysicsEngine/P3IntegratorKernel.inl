@@ -0,0 +1,47 @@
+// The SIMD part of the integration, included once per instruction set by P3Integrator.cpp, see P3Simd.h.
+//  Not a header on its own, so no include guard.
+
+struct QuatX8
+{
+	Float8 w, x, y, z;
+};
+
+void integrateLanes(BodyLanes &lanes, float dt)
+{
+	Vec3x8 position = load(lanes.positions) + load(lanes.velocities) * (load(lanes.fractions) * splat(dt));
+
+	// Same as addScaledVector with dt / 2, then glm::normalize
+	Vec3x8 halfRotation = load(lanes.angularVelocities) * splat(dt / 2.0f) * splat(0.5f);
+	QuatX8 q = { load(lanes.orientations[0]),
+				 load(lanes.orientations[1]) + halfRotation.x,
+				 load(lanes.orientations[2]) + halfRotation.y,
+				 load(lanes.orientations[3]) + halfRotation.z };
+
+	Float8 inverseLength = splat(1.0f) / sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+	q = { q.w * inverseLength, q.x * inverseLength, q.y * inverseLength, q.z * inverseLength };
+
+	// Columns of the rotation matrix, as glm::mat3_cast builds them
+	Float8 one = splat(1.0f);
+	Float8 two = splat(2.0f);
+	Float8 xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	Float8 xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	Float8 wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+	Vec3x8 rotation[3] =
+	{
+		{ one - two * (yy + zz), two * (xy + wz), two * (xz - wy) },
+		{ two * (xy - wz), one - two * (xx + zz), two * (yz + wx) },
+		{ two * (xz + wy), two * (yz - wx), one - two * (xx + yy) }
+	};
+
+	store(lanes.positions, position);
+	store(lanes.orientations[0], q.w);
+	store(lanes.orientations[1], q.x);
+	store(lanes.orientations[2], q.y);
+	store(lanes.orientations[3], q.z);
+
+	for (int column = 0; column < 3; ++column)
+	{
+		store(lanes.rotations[column], rotation[column]);
+	}
+}
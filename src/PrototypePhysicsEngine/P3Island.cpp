@@ -0,0 +1,180 @@
+#include "P3Island.h"
+
+#include <utility>
+
+#include "P3FrameArena.h"
+#include "P3NarrowPhaseCommon.h"
+
+namespace
+{
+int findRoot(P3::FrameVector<int> &parents, int bodyIdx)
+{
+	// Path halving, every other node on the way points to its grandparent afterwards
+	while (parents[bodyIdx] != bodyIdx)
+	{
+		parents[bodyIdx] = parents[parents[bodyIdx]];
+		bodyIdx = parents[bodyIdx];
+	}
+
+	return bodyIdx;
+}
+
+void unite(P3::FrameVector<int> &parents, P3::FrameVector<int> &sizes, int bodyIdxA, int bodyIdxB)
+{
+	int rootA = findRoot(parents, bodyIdxA);
+	int rootB = findRoot(parents, bodyIdxB);
+
+	if (rootA == rootB)
+		return;
+
+	// Union by size keeps the trees shallow
+	if (sizes[rootA] < sizes[rootB])
+		std::swap(rootA, rootB);
+
+	parents[rootB] = rootA;
+	sizes[rootA] += sizes[rootB];
+}
+}
+
+namespace P3
+{
+void buildIslands(ManifoldGpuPackage const &manifoldPkg, std::vector<SolverBody> const &solverBodies, IslandSet &islandSet)
+{
+	int bodyCount = static_cast<int>(solverBodies.size());
+
+	P3::FrameVector<int> parents(bodyCount), sizes(bodyCount, 1);
+	for (int i = 0; i < bodyCount; ++i)
+	{
+		parents[i] = i;
+	}
+
+	for (int i = 0; i < manifoldPkg.misc.x; ++i)
+	{
+		int referenceBoxIdx = manifoldPkg.manifolds[i].contactBoxIndicesAndContactCount.x;
+		int incidentBoxIdx  = manifoldPkg.manifolds[i].contactBoxIndicesAndContactCount.y;
+
+		if (solverBodies[referenceBoxIdx].isDynamic() && solverBodies[incidentBoxIdx].isDynamic())
+			unite(parents, sizes, referenceBoxIdx, incidentBoxIdx);
+	}
+
+	// Number the islands in order of their first body, then count what goes in each of them
+	P3::FrameVector<int> bodyIslandIndices(bodyCount, -1);
+	islandSet.firstBodyIndices.assign(1, 0);
+
+	for (int i = 0; i < bodyCount; ++i)
+	{
+		if (!solverBodies[i].isDynamic())
+			continue;
+
+		int root = findRoot(parents, i);
+		if (bodyIslandIndices[root] < 0)
+		{
+			bodyIslandIndices[root] = islandSet.getIslandCount();
+			islandSet.firstBodyIndices.push_back(0);
+		}
+
+		bodyIslandIndices[i] = bodyIslandIndices[root];
+		++islandSet.firstBodyIndices[bodyIslandIndices[i] + 1];
+	}
+
+	int islandCount = islandSet.getIslandCount();
+	P3::FrameVector<int> manifoldIslandIndices(manifoldPkg.misc.x, -1);
+	islandSet.firstManifoldIndices.assign(islandCount + 1, 0);
+
+	for (int i = 0; i < manifoldPkg.misc.x; ++i)
+	{
+		int referenceBoxIdx = manifoldPkg.manifolds[i].contactBoxIndicesAndContactCount.x;
+		int incidentBoxIdx  = manifoldPkg.manifolds[i].contactBoxIndicesAndContactCount.y;
+
+		if (solverBodies[referenceBoxIdx].isDynamic())
+			manifoldIslandIndices[i] = bodyIslandIndices[referenceBoxIdx];
+		else if (solverBodies[incidentBoxIdx].isDynamic())
+			manifoldIslandIndices[i] = bodyIslandIndices[incidentBoxIdx];
+		else
+			continue;
+
+		++islandSet.firstManifoldIndices[manifoldIslandIndices[i] + 1];
+	}
+
+	for (int i = 0; i < islandCount; ++i)
+	{
+		islandSet.firstBodyIndices[i + 1] += islandSet.firstBodyIndices[i];
+		islandSet.firstManifoldIndices[i + 1] += islandSet.firstManifoldIndices[i];
+	}
+
+	// Counting sort, stable so everything stays in its original order within an island
+	P3::FrameVector<int> nextBodySlots(islandSet.firstBodyIndices.begin(), islandSet.firstBodyIndices.end() - 1);
+	islandSet.bodyIndices.resize(islandSet.firstBodyIndices.back());
+	for (int i = 0; i < bodyCount; ++i)
+	{
+		if (bodyIslandIndices[i] >= 0)
+			islandSet.bodyIndices[nextBodySlots[bodyIslandIndices[i]]++] = i;
+	}
+
+	P3::FrameVector<int> nextManifoldSlots(islandSet.firstManifoldIndices.begin(), islandSet.firstManifoldIndices.end() - 1);
+	islandSet.manifoldIndices.resize(islandSet.firstManifoldIndices.back());
+	for (int i = 0; i < manifoldPkg.misc.x; ++i)
+	{
+		if (manifoldIslandIndices[i] >= 0)
+			islandSet.manifoldIndices[nextManifoldSlots[manifoldIslandIndices[i]]++] = i;
+	}
+}
+
+void computeBodyLayers(ManifoldGpuPackage const &manifoldPkg, std::vector<SolverBody> const &solverBodies, std::vector<int> &bodyLayers)
+{
+	int bodyCount = static_cast<int>(solverBodies.size());
+
+	// Contact graph as adjacency lists, all in one array
+	P3::FrameVector<int> firstNeighborIndices(bodyCount + 1, 0);
+	for (int i = 0; i < manifoldPkg.misc.x; ++i)
+	{
+		++firstNeighborIndices[manifoldPkg.manifolds[i].contactBoxIndicesAndContactCount.x + 1];
+		++firstNeighborIndices[manifoldPkg.manifolds[i].contactBoxIndicesAndContactCount.y + 1];
+	}
+
+	for (int i = 0; i < bodyCount; ++i)
+	{
+		firstNeighborIndices[i + 1] += firstNeighborIndices[i];
+	}
+
+	P3::FrameVector<int> nextNeighborSlots(firstNeighborIndices.begin(), firstNeighborIndices.end() - 1);
+	P3::FrameVector<int> neighbors(firstNeighborIndices.back());
+	for (int i = 0; i < manifoldPkg.misc.x; ++i)
+	{
+		int referenceBoxIdx = manifoldPkg.manifolds[i].contactBoxIndicesAndContactCount.x;
+		int incidentBoxIdx  = manifoldPkg.manifolds[i].contactBoxIndicesAndContactCount.y;
+
+		neighbors[nextNeighborSlots[referenceBoxIdx]++] = incidentBoxIdx;
+		neighbors[nextNeighborSlots[incidentBoxIdx]++] = referenceBoxIdx;
+	}
+
+	// Every static and kinematic body starts the search
+	P3::FrameVector<int> queue;
+	queue.reserve(bodyCount);
+	bodyLayers.assign(bodyCount, cUnsupportedBodyLayer);
+
+	for (int i = 0; i < bodyCount; ++i)
+	{
+		if (!solverBodies[i].isDynamic())
+		{
+			bodyLayers[i] = 0;
+			queue.push_back(i);
+		}
+	}
+
+	// The queue grows as the search goes, so its size is read on every pass
+	for (int queueIdx = 0; queueIdx < static_cast<int>(queue.size()); ++queueIdx)
+	{
+		int bodyIdx = queue[queueIdx];
+		for (int i = firstNeighborIndices[bodyIdx]; i < firstNeighborIndices[bodyIdx + 1]; ++i)
+		{
+			int neighborIdx = neighbors[i];
+			if (bodyLayers[neighborIdx] == cUnsupportedBodyLayer)
+			{
+				bodyLayers[neighborIdx] = bodyLayers[bodyIdx] + 1;
+				queue.push_back(neighborIdx);
+			}
+		}
+	}
+}
+}
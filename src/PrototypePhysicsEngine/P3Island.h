@@ -0,0 +1,48 @@
+/**
+ * Islands are groups of rigid bodies connected through contacts. Nothing that happens in one island can
+ *  affect another within a step, so each of them can be solved on its own thread, and later put to sleep or
+ *  given its own iteration count. Static bodies never move, so they don't connect the piles resting on them.
+ *
+ * Built with union-find over the body pairs of the manifolds.
+ */
+
+#pragma once
+
+#ifndef P3_ISLAND_H
+#define P3_ISLAND_H
+
+#include <vector>
+
+#include "P3SolverBody.h"
+
+struct ManifoldGpuPackage;
+
+namespace P3
+{
+struct IslandSet
+{
+	// Grouped by island, the manifolds of an island keep the order of the manifold package
+	std::vector<int> bodyIndices;
+	std::vector<int> manifoldIndices;
+
+	// Where each island starts in the lists above, with one past the end for the last island
+	std::vector<int> firstBodyIndices;
+	std::vector<int> firstManifoldIndices;
+
+	int getIslandCount() const { return static_cast<int>(firstBodyIndices.size()) - 1; }
+	int getBodyCount(int islandIdx) const { return firstBodyIndices[islandIdx + 1] - firstBodyIndices[islandIdx]; }
+	int getManifoldCount(int islandIdx) const { return firstManifoldIndices[islandIdx + 1] - firstManifoldIndices[islandIdx]; }
+};
+
+// Every dynamic body ends up in exactly one island, bodies without contacts in islands of their own. Static and
+//  kinematic bodies are in none. Manifolds between 2 of them have nothing to solve and are left out.
+void buildIslands(ManifoldGpuPackage const &, std::vector<SolverBody> const &, IslandSet &);
+
+constexpr int cUnsupportedBodyLayer = 0x7fffffff;
+
+// How many contacts away from a static or kinematic body each body is, breadth first. 0 for those bodies
+//  themselves, 1 for what rests on them and so on. Piles that touch nothing static get cUnsupportedBodyLayer.
+void computeBodyLayers(ManifoldGpuPackage const &, std::vector<SolverBody> const &, std::vector<int> &bodyLayers);
+}
+
+#endif // P3_ISLAND_H
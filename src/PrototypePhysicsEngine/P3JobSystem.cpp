@@ -0,0 +1,409 @@
+#include "P3JobSystem.h"
+
+#include <algorithm>
+
+#include "P3FrameArena.h"
+
+namespace
+{
+// Tries before an idle worker goes to sleep. The solver runs many short loops back to back, the workers are
+//  better off waiting for the next one than being woken up for it.
+constexpr int cSpinCount = 64;
+
+// Jobs a queue starts with
+constexpr size_t cMinQueueCapacity = 64u;
+
+// Which queue is the calling thread's, 0 for threads that aren't workers
+thread_local P3::JobSystem const *tpJobSystem = nullptr;
+thread_local unsigned int tQueueIdx = 0u;
+
+// The frame arenas of the run the calling thread works for, nullptr outside of runs
+thread_local P3::FrameArenaScope *tpFrameArenaScope = nullptr;
+
+struct ParallelFor
+{
+	void (*pInvokeRange)(void const *, int, int);
+	void const *pFunc;
+	P3::FrameArenaScope *pFrameArenaScope;
+	int count;
+	int grainSize;
+	std::atomic<int> nextBegin;
+	std::atomic<int> pendingJobCount;
+};
+
+void runRanges(ParallelFor &loop)
+{
+	while (true)
+	{
+		int begin = loop.nextBegin.fetch_add(loop.grainSize);
+		if (begin >= loop.count)
+			return;
+
+		loop.pInvokeRange(loop.pFunc, begin, std::min(begin + loop.grainSize, loop.count));
+	}
+}
+
+void runParallelForJob(void *pData)
+{
+	ParallelFor &loop = *static_cast<ParallelFor *>(pData);
+
+	// Allocates for the run the loop is part of, if any
+	P3::FrameArenaScope *pPreviousScope = tpFrameArenaScope;
+	tpFrameArenaScope = loop.pFrameArenaScope;
+	if (tpFrameArenaScope)
+		tpFrameArenaScope->add();
+
+	runRanges(loop);
+
+	tpFrameArenaScope = pPreviousScope;
+	loop.pendingJobCount.fetch_sub(1);
+}
+}
+
+struct P3::JobSystem::GraphRun
+{
+	explicit GraphRun(int taskCount) : dependencyCounts(taskCount) {}
+
+	// From the calling thread's frame arena, sized up front so other threads never grow them
+	JobSystem *pJobSystem;
+	TaskGraph const *pGraph;
+	FrameArenaScope *pFrameArenaScope;
+	FrameVector<std::atomic<int>> dependencyCounts;
+	FrameVector<TaskJob> taskJobs;
+	std::atomic<int> pendingTaskCount;
+
+	// Ready tasks that only the calling thread may run
+	std::mutex boundTaskMutex;
+	FrameVector<int> boundTaskIndices;
+	std::atomic<int> boundTaskCount;
+};
+
+int P3::TaskGraph::addTask(std::function<void()> const &func, std::initializer_list<int> dependencies, bool isBoundToCallingThread)
+{
+	int taskIdx = size();
+	mTasks.push_back(Task{ func, std::vector<int>(), 0, isBoundToCallingThread });
+
+	for (int dependencyIdx : dependencies)
+	{
+		if (dependencyIdx < 0)
+			continue;
+
+		mTasks[dependencyIdx].dependents.push_back(taskIdx);
+		++mTasks[taskIdx].dependencyCount;
+	}
+
+	return taskIdx;
+}
+
+P3::JobSystem::JobSystem(unsigned int threadCount)
+{
+	startWorkers(threadCount);
+}
+
+P3::JobSystem::~JobSystem()
+{
+	stopWorkers();
+}
+
+void P3::JobSystem::setThreadCount(unsigned int threadCount)
+{
+	stopWorkers();
+	startWorkers(threadCount);
+}
+
+void P3::JobSystem::startWorkers(unsigned int threadCount)
+{
+	if (!threadCount)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	mQueues.clear();
+	for (unsigned int i = 0u; i < threadCount; ++i)
+	{
+		mQueues.emplace_back(new Queue());
+	}
+
+	mIsStopping = false;
+	for (unsigned int i = 1u; i < threadCount; ++i)
+	{
+		mWorkers.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+}
+
+void P3::JobSystem::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mIsStopping = true;
+	}
+
+	mJobAvailable.notify_all();
+
+	for (std::thread &worker : mWorkers)
+	{
+		worker.join();
+	}
+
+	mWorkers.clear();
+}
+
+void P3::JobSystem::workerLoop(unsigned int queueIdx)
+{
+	tpJobSystem = this;
+	tQueueIdx = queueIdx;
+
+	while (true)
+	{
+		Job job;
+		bool hasJob = false;
+
+		for (int i = 0; i < cSpinCount && !hasJob; ++i)
+		{
+			hasJob = tryPop(job);
+			if (!hasJob)
+				std::this_thread::yield();
+		}
+
+		if (hasJob)
+		{
+			job.pFunc(job.pData);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mSleepMutex);
+		++mSleepingWorkerCount;
+		mJobAvailable.wait(lock, [this] { return mIsStopping || mQueuedJobCount.load() > 0; });
+		--mSleepingWorkerCount;
+
+		if (mIsStopping)
+			return;
+	}
+}
+
+unsigned int P3::JobSystem::getQueueIdx() const
+{
+	return tpJobSystem == this ? tQueueIdx : 0u;
+}
+
+void P3::JobSystem::push(Job const &job)
+{
+	Queue &queue = *mQueues[getQueueIdx()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		size_t capacity = queue.jobs.size();
+		if (queue.count == capacity)
+		{
+			std::vector<Job> jobs(std::max(2u * capacity, cMinQueueCapacity));
+			for (size_t i = 0u; i < queue.count; ++i)
+			{
+				jobs[i] = queue.jobs[(queue.first + i) % capacity];
+			}
+
+			queue.jobs.swap(jobs);
+			queue.first = 0u;
+			capacity = queue.jobs.size();
+		}
+
+		queue.jobs[(queue.first + queue.count) % capacity] = job;
+		++queue.count;
+	}
+
+	++mQueuedJobCount;
+
+	// Going through the mutex, a worker can't be between checking for jobs and falling asleep, and miss this one
+	if (mSleepingWorkerCount.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mSleepMutex);
+		}
+
+		mJobAvailable.notify_one();
+	}
+}
+
+bool P3::JobSystem::tryPop(Job &job)
+{
+	if (mQueuedJobCount.load() <= 0)
+		return false;
+
+	unsigned int queueCount = static_cast<unsigned int>(mQueues.size());
+	unsigned int ownQueueIdx = getQueueIdx();
+
+	// The newest of its own jobs first, then the oldest of someone else's
+	for (unsigned int i = 0u; i < queueCount; ++i)
+	{
+		Queue &queue = *mQueues[(ownQueueIdx + i) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.count)
+			continue;
+
+		size_t capacity = queue.jobs.size();
+		if (!i)
+		{
+			job = queue.jobs[(queue.first + queue.count - 1u) % capacity];
+		}
+		else
+		{
+			job = queue.jobs[queue.first];
+			queue.first = (queue.first + 1u) % capacity;
+		}
+
+		--queue.count;
+
+		--mQueuedJobCount;
+		return true;
+	}
+
+	return false;
+}
+
+void P3::JobSystem::waitFor(std::atomic<int> const &pendingCount)
+{
+	while (pendingCount.load() > 0)
+	{
+		Job job;
+		if (tryPop(job))
+			job.pFunc(job.pData);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void P3::JobSystem::parallelFor(int count, int grainSize, void (*pInvokeRange)(void const *, int, int), void const *pFunc)
+{
+	if (count <= 0)
+		return;
+
+	grainSize = std::max(1, grainSize);
+	int rangeCount = (count - 1) / grainSize + 1;
+
+	// Queuing jobs isn't free, a single range is quicker on this thread alone
+	if (mWorkers.empty() || rangeCount == 1)
+	{
+		pInvokeRange(pFunc, 0, count);
+		return;
+	}
+
+	ParallelFor loop;
+	loop.pInvokeRange = pInvokeRange;
+	loop.pFunc = pFunc;
+	loop.pFrameArenaScope = tpFrameArenaScope;
+	loop.count = count;
+	loop.grainSize = grainSize;
+	loop.nextBegin = 0;
+
+	// One job per thread that could help, each one takes ranges until there are none left
+	int jobCount = std::min(rangeCount - 1, static_cast<int>(mWorkers.size()));
+	loop.pendingJobCount = jobCount;
+
+	for (int i = 0; i < jobCount; ++i)
+	{
+		push({ &runParallelForJob, &loop });
+	}
+
+	runRanges(loop);
+
+	// Jobs still queued point to the loop, they must all have run before it goes out of scope
+	waitFor(loop.pendingJobCount);
+}
+
+void P3::JobSystem::run(TaskGraph const &graph)
+{
+	int taskCount = graph.size();
+	if (!taskCount)
+		return;
+
+	// Before the graph run, which is allocated from the calling thread's arena and must be gone before that's reset
+	FrameArenaScope frameArenaScope;
+	FrameArenaScope *pPreviousScope = tpFrameArenaScope;
+	tpFrameArenaScope = &frameArenaScope;
+	frameArenaScope.add();
+
+	GraphRun graphRun(taskCount);
+	graphRun.pJobSystem = this;
+	graphRun.pGraph = &graph;
+	graphRun.pFrameArenaScope = &frameArenaScope;
+	graphRun.taskJobs.reserve(taskCount);
+	graphRun.pendingTaskCount = taskCount;
+	graphRun.boundTaskIndices.reserve(taskCount);
+	graphRun.boundTaskCount = 0;
+
+	for (int taskIdx = 0; taskIdx < taskCount; ++taskIdx)
+	{
+		graphRun.dependencyCounts[taskIdx] = graph.mTasks[taskIdx].dependencyCount;
+		graphRun.taskJobs.push_back({ &graphRun, taskIdx });
+	}
+
+	for (int taskIdx = 0; taskIdx < taskCount; ++taskIdx)
+	{
+		if (!graph.mTasks[taskIdx].dependencyCount)
+			schedule(graphRun, taskIdx);
+	}
+
+	while (graphRun.pendingTaskCount.load() > 0)
+	{
+		int boundTaskIdx = -1;
+		if (graphRun.boundTaskCount.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(graphRun.boundTaskMutex);
+			boundTaskIdx = graphRun.boundTaskIndices.back();
+			graphRun.boundTaskIndices.pop_back();
+			--graphRun.boundTaskCount;
+		}
+
+		Job job;
+		if (boundTaskIdx >= 0)
+			runTaskJob(&graphRun.taskJobs[boundTaskIdx]);
+		else if (tryPop(job))
+			job.pFunc(job.pData);
+		else
+			std::this_thread::yield();
+	}
+
+	tpFrameArenaScope = pPreviousScope;
+}
+
+void P3::JobSystem::schedule(GraphRun &graphRun, int taskIdx)
+{
+	if (graphRun.pGraph->mTasks[taskIdx].isBoundToCallingThread)
+	{
+		std::lock_guard<std::mutex> lock(graphRun.boundTaskMutex);
+		graphRun.boundTaskIndices.push_back(taskIdx);
+		++graphRun.boundTaskCount;
+	}
+	else
+	{
+		push({ &runTaskJob, &graphRun.taskJobs[taskIdx] });
+	}
+}
+
+void P3::JobSystem::runTaskJob(void *pData)
+{
+	TaskJob const &taskJob = *static_cast<TaskJob *>(pData);
+	GraphRun &graphRun = *taskJob.pRun;
+	TaskGraph::Task const &task = graphRun.pGraph->mTasks[taskJob.taskIdx];
+
+	FrameArenaScope *pPreviousScope = tpFrameArenaScope;
+	tpFrameArenaScope = graphRun.pFrameArenaScope;
+	tpFrameArenaScope->add();
+
+	task.func();
+
+	tpFrameArenaScope = pPreviousScope;
+
+	for (int dependentIdx : task.dependents)
+	{
+		if (graphRun.dependencyCounts[dependentIdx].fetch_sub(1) == 1)
+			graphRun.pJobSystem->schedule(graphRun, dependentIdx);
+	}
+
+	// Last, the graph may be gone as soon as this reaches 0
+	graphRun.pendingTaskCount.fetch_sub(1);
+}
+
+P3::JobSystem &P3::getJobSystem()
+{
+	static JobSystem jobSystem;
+	return jobSystem;
+}
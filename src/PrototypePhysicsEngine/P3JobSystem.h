@@ -0,0 +1,141 @@
+/**
+ * Work-stealing job system shared by every stage of the CPU pipeline, so they don't each keep a pool of threads
+ *  competing for the same cores. Each thread has its own queue: it pushes and pops at the back, the newest and
+ *  cache-hot jobs first, and idle threads steal from the front of the others' queues, the oldest and usually
+ *  biggest jobs. A thread that waits on its jobs runs other jobs meanwhile, so jobs can wait on jobs of their own.
+ *
+ * A step is a TaskGraph, each task starting once its dependencies are done, and the tasks split their loops
+ *  further with parallelFor. The calling thread always takes part, so n threads means n - 1 workers.
+ */
+
+#pragma once
+
+#ifndef P3_JOB_SYSTEM_H
+#define P3_JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace P3
+{
+class TaskGraph
+{
+public:
+	// Dependencies are indices returned by earlier calls, negative ones are skipped. Tasks bound to the calling thread only run on the thread
+	//  that runs the graph, e.g. anything making GL calls.
+	int addTask( std::function<void()> const &func,
+				 std::initializer_list<int> dependencies = {},
+				 bool isBoundToCallingThread = false );
+
+	int size() const { return static_cast<int>(mTasks.size()); }
+	void clear() { mTasks.clear(); }
+
+private:
+	friend class JobSystem;
+
+	struct Task
+	{
+		std::function<void()> func;
+		std::vector<int> dependents;
+		int dependencyCount;
+		bool isBoundToCallingThread;
+	};
+
+	std::vector<Task> mTasks;
+};
+
+class JobSystem
+{
+public:
+	// 0 means one thread per hardware thread
+	explicit JobSystem(unsigned int threadCount = 0u);
+	~JobSystem();
+
+	JobSystem(JobSystem const &) = delete;
+	JobSystem &operator=(JobSystem const &) = delete;
+
+	// Replaces the workers, only while nothing runs on them
+	void setThreadCount(unsigned int threadCount);
+	unsigned int getThreadCount() const { return static_cast<unsigned int>(mWorkers.size()) + 1u; }
+
+	// Splits [0, count) into ranges of grainSize and calls func(begin, end) on them from any thread.
+	//  Returns once all the ranges are done. The function is only referenced, never copied, so nothing is allocated
+	//  whatever it captures.
+	template<typename Func>
+	void parallelFor(int count, int grainSize, Func const &func)
+	{
+		parallelFor(count, grainSize, &invokeRange<Func>, &func);
+	}
+
+	// Returns once every task of the graph has run, and the frame arenas it allocated from are reset
+	void run(TaskGraph const &);
+
+private:
+	// A function and what it works on, nothing is allocated to queue one
+	struct Job
+	{
+		void (*pFunc)(void *);
+		void *pData;
+	};
+
+	// Ring buffer, it only grows so queuing doesn't allocate once it's big enough
+	struct Queue
+	{
+		std::mutex mutex;
+		std::vector<Job> jobs;
+		size_t first = 0u;
+		size_t count = 0u;
+	};
+
+	template<typename Func>
+	static void invokeRange(void const *pFunc, int begin, int end)
+	{
+		(*static_cast<Func const *>(pFunc))(begin, end);
+	}
+
+	void parallelFor(int count, int grainSize, void (*pInvokeRange)(void const *, int, int), void const *pFunc);
+
+	void startWorkers(unsigned int threadCount);
+	void stopWorkers();
+	void workerLoop(unsigned int queueIdx);
+
+	void push(Job const &);
+	bool tryPop(Job &);
+
+	// Runs jobs, any of them, until the count drops to 0
+	void waitFor(std::atomic<int> const &pendingCount);
+
+	unsigned int getQueueIdx() const;
+
+	// A graph being run, each task a job of its own
+	struct GraphRun;
+	struct TaskJob
+	{
+		GraphRun *pRun;
+		int taskIdx;
+	};
+
+	void schedule(GraphRun &, int taskIdx);
+	static void runTaskJob(void *);
+
+	std::vector<std::thread> mWorkers;
+	std::vector<std::unique_ptr<Queue>> mQueues; // Queue 0 is shared by the threads that aren't workers
+
+	std::atomic<int> mQueuedJobCount{ 0 };
+	std::atomic<int> mSleepingWorkerCount{ 0 };
+	std::mutex mSleepMutex;
+	std::condition_variable mJobAvailable;
+	bool mIsStopping = false;
+};
+
+// The one every stage runs on. Its thread count can be changed between steps.
+JobSystem &getJobSystem();
+}
+
+#endif // P3_JOB_SYSTEM_H
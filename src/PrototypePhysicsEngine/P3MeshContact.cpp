@@ -0,0 +1,502 @@
+#include "P3MeshContact.h"
+
+#include <cstdint>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#include "P3BroadPhaseCommon.h"
+#include "P3FrameArena.h"
+#include "P3NarrowPhaseCommon.h"
+#include "P3Sat.h"
+#include "P3TriangleMeshCollider.h"
+
+constexpr int cMaxClipVertCount = 16;
+constexpr float cMeshEpsilon = 0.0001f;
+constexpr float cMeshPersistentThresholdSq_Contact = 0.25f; // Same as the box-box one in P3Sat
+
+// Edge axes have to be clearly better than the face axes to be picked, face contacts are a lot more stable
+constexpr float cRelativeTolerance = 0.95f;
+constexpr float cAbsoluteTolerance = 0.01f;
+
+namespace
+{
+struct OrientedBox
+{
+	glm::vec3 center{ 0.0f };
+	glm::vec3 axes[3]{};
+	float halfExtents[3]{};
+};
+
+enum class AxisType
+{
+	TriangleFace,
+	BoxFace,
+	Edge
+};
+
+struct AxisQuery
+{
+	AxisType type = AxisType::TriangleFace;
+	int boxAxisIdx = -1;
+	int triangleEdgeIdx = -1;
+	float separation = std::numeric_limits<float>::lowest();
+	glm::vec3 axis{ 0.0f }; // Points from the triangle to the box
+};
+
+// See cInstanceVertices for the vertex layout of a box collider
+OrientedBox getOrientedBox(glm::vec4 const *box)
+{
+	OrientedBox orientedBox;
+	orientedBox.center = 0.5f * (glm::vec3(box[5]) + glm::vec3(box[3]));
+
+	glm::vec3 edges[3] = { glm::vec3(box[1] - box[0]), glm::vec3(box[0] - box[3]), glm::vec3(box[0] - box[4]) };
+
+	for (int i = 0; i < 3; ++i)
+	{
+		float length = glm::length(edges[i]);
+		orientedBox.halfExtents[i] = 0.5f * length;
+		orientedBox.axes[i] = edges[i] / length;
+	}
+
+	return orientedBox;
+}
+
+Aabb getAabb(glm::vec4 const *box)
+{
+	Aabb aabb(box[0], box[0]);
+
+	for (int i = 1; i < cBoxColliderVertCount; ++i)
+	{
+		aabb.mMinCoord = glm::min(aabb.mMinCoord, box[i]);
+		aabb.mMaxCoord = glm::max(aabb.mMaxCoord, box[i]);
+	}
+
+	return aabb;
+}
+
+// @return: false if the axis separates the box and the triangle
+bool testAxis( OrientedBox const &box, glm::vec3 const *triangle, glm::vec3 const &triangleCentroid, glm::vec3 axis,
+			   float &separation, glm::vec3 &orientedAxis )
+{
+	if (glm::dot(axis, box.center - triangleCentroid) < 0.0f)
+		axis = -axis;
+
+	float boxRadius = 0.0f;
+	for (int i = 0; i < 3; ++i)
+	{
+		boxRadius += box.halfExtents[i] * glm::abs(glm::dot(box.axes[i], axis));
+	}
+
+	float boxProj = glm::dot(box.center, axis);
+	float triangleProjs[3] = { glm::dot(triangle[0], axis), glm::dot(triangle[1], axis), glm::dot(triangle[2], axis) };
+	float triangleMin = glm::min(triangleProjs[0], glm::min(triangleProjs[1], triangleProjs[2]));
+	float triangleMax = glm::max(triangleProjs[0], glm::max(triangleProjs[1], triangleProjs[2]));
+
+	if (boxProj - boxRadius - triangleMax > cMeshEpsilon || triangleMin - boxProj - boxRadius > cMeshEpsilon)
+		return false;
+
+	separation   = boxProj - boxRadius - triangleMax;
+	orientedAxis = axis;
+
+	return true;
+}
+
+// @return: false if there's a separating axis
+bool queryAxes(OrientedBox const &box, glm::vec3 const *triangle, unsigned char activeEdges, AxisQuery &bestQuery)
+{
+	glm::vec3 centroid = (triangle[0] + triangle[1] + triangle[2]) / 3.0f;
+	glm::vec3 triangleEdges[3] = { triangle[1] - triangle[0], triangle[2] - triangle[1], triangle[0] - triangle[2] };
+	float separation = 0.0f;
+	glm::vec3 axis{ 0.0f };
+
+	// Triangle face
+	if (!testAxis(box, triangle, centroid, glm::normalize(glm::cross(triangleEdges[0], triangleEdges[1])), separation, axis))
+		return false;
+
+	bestQuery.type       = AxisType::TriangleFace;
+	bestQuery.separation = separation;
+	bestQuery.axis       = axis;
+
+	// Box faces
+	for (int i = 0; i < 3; ++i)
+	{
+		if (!testAxis(box, triangle, centroid, box.axes[i], separation, axis))
+			return false;
+
+		if (separation > bestQuery.separation)
+		{
+			bestQuery.type       = AxisType::BoxFace;
+			bestQuery.boxAxisIdx = i;
+			bestQuery.separation = separation;
+			bestQuery.axis       = axis;
+		}
+	}
+
+	// Box edges x triangle edges. Internal edges still have to be tested for separation, they just can't be picked.
+	AxisQuery edgeQuery;
+	edgeQuery.type = AxisType::Edge;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			glm::vec3 crossAxis = glm::cross(box.axes[i], triangleEdges[j]);
+			float lengthSq = glm::dot(crossAxis, crossAxis);
+
+			// Parallel edges, already covered by the face axes
+			if (lengthSq <= cMeshEpsilon * glm::dot(triangleEdges[j], triangleEdges[j])) continue;
+
+			if (!testAxis(box, triangle, centroid, crossAxis / glm::sqrt(lengthSq), separation, axis))
+				return false;
+
+			if ((activeEdges & (1 << j)) && separation > edgeQuery.separation)
+			{
+				edgeQuery.boxAxisIdx      = i;
+				edgeQuery.triangleEdgeIdx = j;
+				edgeQuery.separation      = separation;
+				edgeQuery.axis            = axis;
+			}
+		}
+	}
+
+	if (edgeQuery.boxAxisIdx > -1 && edgeQuery.separation > cRelativeTolerance * bestQuery.separation + cAbsoluteTolerance)
+		bestQuery = edgeQuery;
+
+	return true;
+}
+
+// Sutherland-Hodgman against a single plane, keeps whatever is behind the plane.
+// @return: number of vertices of the clipped polygon
+int clipPolygon( glm::vec3 const *inPolygon, int inCount,
+				 glm::vec3 const &planePoint, glm::vec3 const &planeNormal,
+				 glm::vec3 *outPolygon )
+{
+	int outCount = 0;
+
+	if (!inCount) return outCount;
+
+	glm::vec3 startVert = inPolygon[inCount - 1];
+	float startSignedDist = glm::dot(planeNormal, startVert - planePoint);
+
+	for (int i = 0; i < inCount && outCount < cMaxClipVertCount - 1; ++i)
+	{
+		glm::vec3 endVert = inPolygon[i];
+		float endSignedDist = glm::dot(planeNormal, endVert - planePoint);
+
+		if ((startSignedDist <= 0.0f) != (endSignedDist <= 0.0f))
+		{
+			float lerpRatio = startSignedDist / (startSignedDist - endSignedDist);
+			outPolygon[outCount++] = glm::mix(startVert, endVert, lerpRatio);
+		}
+
+		if (endSignedDist <= 0.0f)
+		{
+			outPolygon[outCount++] = endVert;
+		}
+
+		startVert       = endVert;
+		startSignedDist = endSignedDist;
+	}
+
+	return outCount;
+}
+
+// Clipping at a corner of the clip region can output the same vertex twice
+bool containsPoint(Contact const *contacts, int contactCount, glm::vec3 const &point)
+{
+	for (int i = 0; i < contactCount; ++i)
+	{
+		glm::vec3 r = glm::vec3(contacts[i].position) - point;
+
+		if (glm::dot(r, r) <= cMeshEpsilon * cMeshEpsilon) return true;
+	}
+
+	return false;
+}
+
+// The incident face of the box gets clipped by the side planes of the triangle
+int createTriangleFaceContacts(OrientedBox const &box, glm::vec3 const *triangle, glm::vec3 const &normal, Contact *contacts)
+{
+	int incidentAxisIdx = 0;
+	float largestAbsDot = -1.0f;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		float absDot = glm::abs(glm::dot(box.axes[i], normal));
+
+		if (absDot > largestAbsDot)
+		{
+			largestAbsDot   = absDot;
+			incidentAxisIdx = i;
+		}
+	}
+
+	float faceSign = glm::dot(box.axes[incidentAxisIdx], normal) > 0.0f ? -1.0f : 1.0f;
+	glm::vec3 faceCenter = box.center + faceSign * box.halfExtents[incidentAxisIdx] * box.axes[incidentAxisIdx];
+	glm::vec3 u = box.halfExtents[(incidentAxisIdx + 1) % 3] * box.axes[(incidentAxisIdx + 1) % 3];
+	glm::vec3 v = box.halfExtents[(incidentAxisIdx + 2) % 3] * box.axes[(incidentAxisIdx + 2) % 3];
+
+	glm::vec3 polygon[cMaxClipVertCount] = { faceCenter + u + v, faceCenter - u + v, faceCenter - u - v, faceCenter + u - v };
+	glm::vec3 clippedPolygon[cMaxClipVertCount];
+	int vertCount = 4;
+
+	// Side planes of the triangle, facing outward regardless of the winding
+	glm::vec3 windingNormal = glm::cross(triangle[1] - triangle[0], triangle[2] - triangle[0]);
+
+	for (int edgeIdx = 0; edgeIdx < 3; ++edgeIdx)
+	{
+		glm::vec3 const &start = triangle[edgeIdx];
+		glm::vec3 const &end   = triangle[(edgeIdx + 1) % 3];
+
+		vertCount = clipPolygon(polygon, vertCount, start, glm::normalize(glm::cross(end - start, windingNormal)), clippedPolygon);
+
+		for (int i = 0; i < vertCount; ++i)
+		{
+			polygon[i] = clippedPolygon[i];
+		}
+	}
+
+	int contactCount = 0;
+
+	for (int i = 0; i < vertCount; ++i)
+	{
+		float separation = glm::dot(normal, polygon[i] - triangle[0]);
+
+		if (separation <= 0.0f && !containsPoint(contacts, contactCount, polygon[i] - separation * normal))
+		{
+			contacts[contactCount].position     = glm::vec4(polygon[i] - separation * normal, 1.0f);
+			contacts[contactCount].separation.w = separation;
+			++contactCount;
+		}
+	}
+
+	return contactCount;
+}
+
+// The triangle gets clipped by the side planes of the box face looking at it
+int createBoxFaceContacts(OrientedBox const &box, glm::vec3 const *triangle, int axisIdx, glm::vec3 const &axis, Contact *contacts)
+{
+	glm::vec3 referenceNormal = -axis;
+	glm::vec3 faceCenter = box.center + box.halfExtents[axisIdx] * referenceNormal;
+
+	glm::vec3 polygon[cMaxClipVertCount] = { triangle[0], triangle[1], triangle[2] };
+	glm::vec3 clippedPolygon[cMaxClipVertCount];
+	int vertCount = 3;
+
+	for (int k = 1; k < 3; ++k)
+	{
+		glm::vec3 const &sideAxis = box.axes[(axisIdx + k) % 3];
+		float halfExtent = box.halfExtents[(axisIdx + k) % 3];
+
+		for (float sideSign : { 1.0f, -1.0f })
+		{
+			vertCount = clipPolygon(polygon, vertCount, box.center + sideSign * halfExtent * sideAxis, sideSign * sideAxis, clippedPolygon);
+
+			for (int i = 0; i < vertCount; ++i)
+			{
+				polygon[i] = clippedPolygon[i];
+			}
+		}
+	}
+
+	int contactCount = 0;
+
+	for (int i = 0; i < vertCount; ++i)
+	{
+		float separation = glm::dot(referenceNormal, polygon[i] - faceCenter);
+
+		if (separation <= 0.0f && !containsPoint(contacts, contactCount, polygon[i] - separation * referenceNormal))
+		{
+			contacts[contactCount].position     = glm::vec4(polygon[i] - separation * referenceNormal, 1.0f);
+			contacts[contactCount].separation.w = separation;
+			++contactCount;
+		}
+	}
+
+	return contactCount;
+}
+
+// @reference: Real-Time Collision Detection by Christer Ericson, 5.1.9. Neither segment is degenerate here.
+void getClosestPoints( glm::vec3 const &startA, glm::vec3 const &endA,
+					   glm::vec3 const &startB, glm::vec3 const &endB,
+					   glm::vec3 &closestPointA, glm::vec3 &closestPointB )
+{
+	glm::vec3 dirA = endA - startA;
+	glm::vec3 dirB = endB - startB;
+	glm::vec3 r = startA - startB;
+	float a = glm::dot(dirA, dirA);
+	float e = glm::dot(dirB, dirB);
+	float f = glm::dot(dirB, r);
+	float c = glm::dot(dirA, r);
+	float b = glm::dot(dirA, dirB);
+	float denom = a * e - b * b;
+	float s = 0.0f;
+
+	if (denom > cMeshEpsilon)
+		s = glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f);
+
+	float t = (b * s + f) / e;
+
+	if (t < 0.0f)
+	{
+		t = 0.0f;
+		s = glm::clamp(-c / a, 0.0f, 1.0f);
+	}
+	else if (t > 1.0f)
+	{
+		t = 1.0f;
+		s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+	}
+
+	closestPointA = startA + s * dirA;
+	closestPointB = startB + t * dirB;
+}
+
+int createEdgeContact(OrientedBox const &box, glm::vec3 const *triangle, AxisQuery const &query, Contact *contacts)
+{
+	// The box edge parallel to the chosen box axis that reaches the deepest toward the triangle
+	glm::vec3 edgeCenter = box.center;
+
+	for (int k = 1; k < 3; ++k)
+	{
+		glm::vec3 const &sideAxis = box.axes[(query.boxAxisIdx + k) % 3];
+		edgeCenter += (glm::dot(sideAxis, query.axis) > 0.0f ? -1.0f : 1.0f) * box.halfExtents[(query.boxAxisIdx + k) % 3] * sideAxis;
+	}
+
+	glm::vec3 halfEdge = box.halfExtents[query.boxAxisIdx] * box.axes[query.boxAxisIdx];
+	glm::vec3 closestPointBox{ 0.0f };
+	glm::vec3 closestPointTriangle{ 0.0f };
+
+	getClosestPoints( edgeCenter - halfEdge, edgeCenter + halfEdge,
+					  triangle[query.triangleEdgeIdx], triangle[(query.triangleEdgeIdx + 1) % 3],
+					  closestPointBox, closestPointTriangle );
+
+	// Same as the box-box edge contact, the point in the middle of the 2 closest points
+	contacts[0].position     = glm::vec4(0.5f * (closestPointBox + closestPointTriangle), 1.0f);
+	contacts[0].separation.w = query.separation;
+
+	return 1;
+}
+
+bool collideBoxTriangle(OrientedBox const &box, glm::vec3 const *triangle, unsigned char activeEdges, WorkingManifold &manifold)
+{
+	AxisQuery query;
+	if (!queryAxes(box, triangle, activeEdges, query)) return false;
+
+	// Only touching, e.g. a neighbouring triangle meeting the box at a single edge or vertex
+	if (query.separation >= 0.0f) return false;
+
+	int contactCount = 0;
+
+	switch (query.type)
+	{
+	case AxisType::TriangleFace:
+		contactCount = createTriangleFaceContacts(box, triangle, query.axis, manifold.contacts);
+		break;
+	case AxisType::BoxFace:
+		contactCount = createBoxFaceContacts(box, triangle, query.boxAxisIdx, query.axis, manifold.contacts);
+		break;
+	case AxisType::Edge:
+		contactCount = createEdgeContact(box, triangle, query, manifold.contacts);
+		break;
+	}
+
+	if (!contactCount) return false;
+
+	manifold.contactBoxIndicesAndContactCount.z = contactCount;
+	manifold.contactNormal = glm::vec4(query.axis, query.separation);
+
+	if (contactCount > cMaxManifoldContactCount)
+	{
+		P3::reduceContactPoints(manifold);
+	}
+
+	return true;
+}
+
+// Body indices get 16 bits each, 32 bits are left for the triangle. The world has to stay under 65536 bodies.
+uint64_t getManifoldKey(glm::ivec4 const &contactBoxIndicesAndContactCount)
+{
+	return (uint64_t(contactBoxIndicesAndContactCount.x & 0xFFFF) << 48)
+		 | (uint64_t(contactBoxIndicesAndContactCount.y & 0xFFFF) << 32)
+		 | uint64_t(uint32_t(contactBoxIndicesAndContactCount.w));
+}
+
+void warmStart(WorkingManifold &manifold, Manifold const &oldManifold, Contact const *oldContacts)
+{
+	for (int i = 0; i < manifold.contactBoxIndicesAndContactCount.z; ++i)
+	{
+		Contact &contact = manifold.contacts[i];
+
+		for (int j = 0; j < oldManifold.contactBoxIndicesAndContactCount.z; ++j)
+		{
+			Contact const &oldContact = oldContacts[j];
+			glm::vec3 r = glm::vec3(contact.position) - glm::vec3(oldContact.position);
+
+			if (glm::dot(r, r) <= cMeshPersistentThresholdSq_Contact)
+			{
+				contact.normalTangentBiasImpulses = oldContact.normalTangentBiasImpulses;
+				break;
+			}
+		}
+	}
+}
+}
+
+void P3::collideTriangleMeshes( ManifoldGpuPackage *pFrontManifoldPkg,
+								ManifoldGpuPackage const *pBackManifoldPkg,
+								BoxColliderGpuPackage const &boxColliderPkg,
+								std::vector<int> const &dynamicBoxIndices,
+								std::vector<TriangleMeshCollider> const &meshColliders,
+								std::vector<int> const &meshBodyIndices )
+{
+	// Box-triangle manifolds aren't carried over by the box-box validation, warm start them from last step here
+	P3::FrameUnorderedMap<uint64_t, int> oldManifoldMap;
+
+	for (int i = 0; i < pBackManifoldPkg->misc.x; ++i)
+	{
+		glm::ivec4 const &oldIndices = pBackManifoldPkg->manifolds[i].contactBoxIndicesAndContactCount;
+
+		if (oldIndices.w)
+			oldManifoldMap[getManifoldKey(oldIndices)] = i;
+	}
+
+	for (size_t meshIdx = 0; meshIdx < meshColliders.size(); ++meshIdx)
+	{
+		TriangleMeshCollider const &meshCollider = meshColliders[meshIdx];
+		int meshBodyIdx = meshBodyIndices[meshIdx];
+
+		for (int boxIdx : dynamicBoxIndices)
+		{
+			OrientedBox box = getOrientedBox(boxColliderPkg[boxIdx]);
+
+			meshCollider.query(getAabb(boxColliderPkg[boxIdx]), [&](int triangleIdx)
+				{
+					glm::vec3 triangle[3] =
+					{
+						meshCollider.getVertex(triangleIdx, 0),
+						meshCollider.getVertex(triangleIdx, 1),
+						meshCollider.getVertex(triangleIdx, 2)
+					};
+
+					WorkingManifold manifold;
+					if (!collideBoxTriangle(box, triangle, meshCollider.getActiveEdges(triangleIdx), manifold)) return;
+
+					manifold.contactBoxIndicesAndContactCount.x = meshBodyIdx;
+					manifold.contactBoxIndicesAndContactCount.y = boxIdx;
+					manifold.contactBoxIndicesAndContactCount.w = triangleIdx + 1;
+
+					auto oldManifoldIter = oldManifoldMap.find(getManifoldKey(manifold.contactBoxIndicesAndContactCount));
+					if (oldManifoldIter != oldManifoldMap.end())
+					{
+						Manifold const &oldManifold = pBackManifoldPkg->manifolds[oldManifoldIter->second];
+						warmStart(manifold, oldManifold, pBackManifoldPkg->getContacts(oldManifold));
+					}
+
+					pFrontManifoldPkg->add(manifold);
+				}
+			);
+		}
+	}
+}
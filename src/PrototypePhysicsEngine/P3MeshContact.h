@@ -0,0 +1,34 @@
+/**
+ * Contact generation between the rigid box colliders and the static triangle meshes. Each box
+ *  queries the BVH of every mesh with its Aabb, then runs a box-triangle SAT (13 axes) against the
+ *  overlapping triangles only.
+ *
+ * One manifold per (box, triangle) pair, appended after the box-box manifolds. The mesh is always
+ *  the reference body and the contact normal points from the triangle to the box. The w component of
+ *  contactBoxIndicesAndContactCount stores triangleIdx + 1, so it stays 0 for box-box manifolds.
+ *
+ * Triangles are treated as double-sided.
+ */
+
+#pragma once
+
+#ifndef P3_MESH_CONTACT_H
+#define P3_MESH_CONTACT_H
+
+#include <vector>
+
+struct BoxColliderGpuPackage;
+struct ManifoldGpuPackage;
+
+namespace P3
+{
+class TriangleMeshCollider;
+
+// Box collider i is assumed to be body i, and mesh k is body meshBodyIndices[k]. Only the listed boxes are tested,
+//  the ones that can move, as a static box resting on a mesh has nothing to solve.
+void collideTriangleMeshes( ManifoldGpuPackage *, ManifoldGpuPackage const *,
+							BoxColliderGpuPackage const &, std::vector<int> const &dynamicBoxIndices,
+							std::vector<TriangleMeshCollider> const &, std::vector<int> const &meshBodyIndices );
+}
+
+#endif // P3_MESH_CONTACT_H
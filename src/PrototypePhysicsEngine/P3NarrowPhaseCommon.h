@@ -3,6 +3,10 @@
 #ifndef P3_NARROW_PHASE_COMMON_H
 #define P3_NARROW_PHASE_COMMON_H
 
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
 #include "P3Common.h"
 
 // Heavily based on the definition of Contact from Box2D Lite
@@ -17,7 +21,87 @@ struct Contact
 	glm::vec4 normalTangentMassesBias{};   // x = normal mass, y = tangent mass 1, z = tangent mass 2, w = bias factor
 };
 
+// Only the header, the contacts are in the contact pool of the package it belongs to
 struct Manifold
+{
+	glm::ivec4 contactBoxIndicesAndContactCount{}; // x = refBoxIdx, y = incidentBoxIdx, z = contact count
+	glm::vec4 contactNormal{}; // w stores the penetration depth.
+	glm::vec4 contactTangents[2]{};
+	glm::vec4 frictionRestitution{};
+	int firstContactIdx = 0;
+};
+
+// A manifold being built, with room for every contact the clipping can find. They are reduced before it's stored.
+struct WorkingManifold : Manifold
+{
+	Contact contacts[cMaxContactPointCount];
+};
+
+// The manifolds, and the contacts of all of them packed in one pool, so each manifold only takes the contacts it has.
+//  Both arrays grow to the biggest step so far and are never shrunk, the counts are in misc.
+struct ManifoldGpuPackage
+{
+	glm::ivec4 misc{}; // x = manifold count, y = contact count
+	std::vector<Manifold> manifolds;
+	std::vector<Contact> contacts;
+
+	Contact *getContacts(Manifold const &manifold) { return contacts.data() + manifold.firstContactIdx; }
+	Contact const *getContacts(Manifold const &manifold) const { return contacts.data() + manifold.firstContactIdx; }
+
+	void clear() { misc = glm::ivec4(0); }
+
+	// Its contacts go to the end of the pool. Returns the index of the stored manifold.
+	int add(WorkingManifold const &workingManifold)
+	{
+		int contactCount = workingManifold.contactBoxIndicesAndContactCount.z;
+		assert(contactCount <= cMaxManifoldContactCount);
+
+		int manifoldIdx = misc.x++;
+		if (static_cast<int>(manifolds.size()) < misc.x)
+			manifolds.resize(misc.x);
+
+		if (static_cast<int>(contacts.size()) < misc.y + contactCount)
+			contacts.resize(misc.y + contactCount);
+
+		Manifold &manifold = manifolds[manifoldIdx];
+		manifold = workingManifold;
+		manifold.firstContactIdx = misc.y;
+
+		std::copy(workingManifold.contacts, workingManifold.contacts + contactCount, contacts.begin() + misc.y);
+		misc.y += contactCount;
+
+		return manifoldIdx;
+	}
+
+	// Drops the manifolds of a removed body. Their contacts are left unused in the pool until the next clear().
+	void removeBody(int bodyIdx)
+	{
+		int keptCount = 0;
+		for (int manifoldIdx = 0; manifoldIdx < misc.x; ++manifoldIdx)
+		{
+			glm::ivec4 const &indices = manifolds[manifoldIdx].contactBoxIndicesAndContactCount;
+			if (indices.x != bodyIdx && indices.y != bodyIdx)
+				manifolds[keptCount++] = manifolds[manifoldIdx];
+		}
+
+		misc.x = keptCount;
+	}
+
+	// For a body given another index, the one it moves to must be free
+	void moveBody(int fromBodyIdx, int toBodyIdx)
+	{
+		for (int manifoldIdx = 0; manifoldIdx < misc.x; ++manifoldIdx)
+		{
+			glm::ivec4 &indices = manifolds[manifoldIdx].contactBoxIndicesAndContactCount;
+			if (indices.x == fromBodyIdx) indices.x = toBodyIdx;
+			if (indices.y == fromBodyIdx) indices.y = toBodyIdx;
+		}
+	}
+};
+
+// The layout sat.comp and solver.comp work on. The buffer is mapped as is, so every manifold keeps fixed slots for
+//  its contacts here. The OpenGL backend copies it to a ManifoldGpuPackage for the rest of the world.
+struct GpuManifold
 {
 	glm::ivec4 contactBoxIndicesAndContactCount{}; // x = refBoxIdx, y = incidentBoxIdx, z = contact count
 	Contact contacts[cMaxContactPointCount];
@@ -26,10 +110,10 @@ struct Manifold
 	glm::vec4 frictionRestitution{};
 };
 
-struct ManifoldGpuPackage // To be replaced by the struct below
+struct ManifoldGpuBuffer
 {
 	glm::ivec4 misc{};
-	Manifold manifolds[cMaxColliderCount];
+	GpuManifold manifolds[cMaxColliderCount];
 };
 
 // Let's make this more data driven, meaning it doesn't make any physical sense but it's easy to move/map data around.
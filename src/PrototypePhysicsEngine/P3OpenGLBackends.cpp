@@ -0,0 +1,162 @@
+#include "P3OpenGLBackends.h"
+
+#include <algorithm>
+
+#include "P3NarrowPhaseCommon.h"
+#include "P3OpenGLComputeBroadPhase.h"
+#include "P3OpenGLComputeNarrowPhase.h"
+#include "P3OpenGLComputeSolver.h"
+
+namespace
+{
+class OpenGLBroadPhase : public P3::BroadPhaseBackend
+{
+public:
+	void init() override { mBroadPhase.init(); }
+
+	// The context is only current on the thread that created it
+	bool isBoundToCallingThread() const override { return true; }
+
+	// No speculative contacts, the sweeps are ignored
+	CollisionPairGpuPackage const *step( std::vector<P3BoxCollider> const &boxColliders,
+										 std::vector<glm::vec3> const & ) override
+	{
+		mBroadPhase.betterStep(boxColliders);
+		copyCollisionPairs(*mBroadPhase.getPCollisionPairPkg());
+
+		return &mCollisionPairPkg;
+	}
+
+	CollisionPairGpuPackage const *getPCollisionPairPkg() const override { return &mCollisionPairPkg; }
+
+	P3OpenGLComputeBroadPhase &get() { return mBroadPhase; }
+
+private:
+	// The shaders count every pair they find, the ones past the end of the buffer are lost. The narrow phase
+	//  reads the buffer itself, the copy is for the rest of the world.
+	void copyCollisionPairs(CollisionPairGpuBuffer const &gpuBuffer)
+	{
+		int maxPairCount = static_cast<int>(sizeof(gpuBuffer.collisionPairs) / sizeof(gpuBuffer.collisionPairs[0]));
+		int pairCount = std::min(gpuBuffer.misc.x, maxPairCount);
+
+		mCollisionPairPkg.clear();
+		for (int pairIdx = 0; pairIdx < pairCount; ++pairIdx)
+		{
+			mCollisionPairPkg.add(gpuBuffer[pairIdx].x, gpuBuffer[pairIdx].y);
+		}
+
+		mCollisionPairPkg.misc.y = gpuBuffer.misc.x - pairCount;
+	}
+
+	P3OpenGLComputeBroadPhase mBroadPhase;
+	CollisionPairGpuPackage mCollisionPairPkg;
+};
+
+class OpenGLNarrowPhase : public P3::NarrowPhaseBackend
+{
+public:
+	explicit OpenGLNarrowPhase(OpenGLBroadPhase &broadPhase) : mBroadPhase(broadPhase) {}
+
+	// After the broad phase, it reads the colliders and the pairs from its buffers
+	void init() override
+	{
+		mNarrowPhase.init(mBroadPhase.get().getBoxCollidersID(), mBroadPhase.get().getCollisionPairsID());
+	}
+
+	bool isBoundToCallingThread() const override { return true; }
+
+	// The colliders and the pairs are on the GPU already
+	ManifoldGpuPackage *step( std::vector<P3BoxCollider> const &,
+							  CollisionPairGpuPackage const *,
+							  std::vector<glm::vec3> const & ) override
+	{
+		mNarrowPhase.step();
+		copyManifolds(*mNarrowPhase.getPManifoldPkg());
+
+		return &mManifoldPkg;
+	}
+
+	ManifoldGpuPackage *getPManifoldPkg() override { return &mManifoldPkg; }
+
+	void swapBuffers() override { mNarrowPhase.swapBuffers(); }
+
+	// The manifolds are on the GPU in the layout of the shaders, they are dropped rather than remapped
+	void onBodyRemoved(int) override
+	{
+		mNarrowPhase.reset();
+		mManifoldPkg.clear();
+	}
+
+	void onBodyMoved(int, int) override {}
+
+	P3OpenGLComputeNarrowPhase &get() { return mNarrowPhase; }
+
+private:
+	// The shaders keep fixed slots for the contacts of each manifold, the rest of the world reads them packed. The
+	//  solver works on the mapped buffer itself, so the impulses it writes back aren't in the copy.
+	void copyManifolds(ManifoldGpuBuffer const &gpuBuffer)
+	{
+		mManifoldPkg.clear();
+
+		for (int manifoldIdx = 0; manifoldIdx < gpuBuffer.misc.x; ++manifoldIdx)
+		{
+			GpuManifold const &gpuManifold = gpuBuffer.manifolds[manifoldIdx];
+
+			WorkingManifold manifold;
+			manifold.contactBoxIndicesAndContactCount = gpuManifold.contactBoxIndicesAndContactCount;
+			manifold.contactNormal = gpuManifold.contactNormal;
+			manifold.contactTangents[0] = gpuManifold.contactTangents[0];
+			manifold.contactTangents[1] = gpuManifold.contactTangents[1];
+			manifold.frictionRestitution = gpuManifold.frictionRestitution;
+			std::copy(gpuManifold.contacts, gpuManifold.contacts + gpuManifold.contactBoxIndicesAndContactCount.z, manifold.contacts);
+
+			mManifoldPkg.add(manifold);
+		}
+	}
+
+	OpenGLBroadPhase &mBroadPhase;
+	P3OpenGLComputeNarrowPhase mNarrowPhase;
+	ManifoldGpuPackage mManifoldPkg;
+};
+
+class OpenGLSolver : public P3::SolverBackend
+{
+public:
+	explicit OpenGLSolver(OpenGLNarrowPhase &narrowPhase) : mNarrowPhase(narrowPhase) {}
+
+	// After the narrow phase, it solves the manifolds in its buffer
+	void init() override { mSolver.init(mNarrowPhase.get().getManifoldBufferID()); }
+
+	bool isBoundToCallingThread() const override { return true; }
+
+	bool isApplyingGravity() const override { return false; }
+
+	void solve( ManifoldGpuPackage &manifoldPkg,
+				std::vector<LinearTransform> &linearTransforms,
+				std::vector<AngularTransform> &angularTransforms,
+				float dt ) override
+	{
+		mSolver.step(manifoldPkg.misc.x, linearTransforms, angularTransforms, dt);
+	}
+
+	void setIterationBounds(P3::IterationBounds const &bounds) override { mSolver.setIterationBounds(bounds); }
+	void setResidualTolerance(float tolerance) override { mSolver.setResidualTolerance(tolerance); }
+
+private:
+	OpenGLNarrowPhase &mNarrowPhase;
+	P3OpenGLComputeSolver mSolver;
+};
+}
+
+P3::Backends P3::createOpenGLBackends()
+{
+	std::unique_ptr<OpenGLBroadPhase> pBroadPhase(new OpenGLBroadPhase());
+	std::unique_ptr<OpenGLNarrowPhase> pNarrowPhase(new OpenGLNarrowPhase(*pBroadPhase));
+
+	Backends backends;
+	backends.pSolver.reset(new OpenGLSolver(*pNarrowPhase));
+	backends.pNarrowPhase = std::move(pNarrowPhase);
+	backends.pBroadPhase = std::move(pBroadPhase);
+
+	return backends;
+}
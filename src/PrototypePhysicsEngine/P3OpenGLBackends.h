@@ -0,0 +1,20 @@
+/**
+ * The OpenGL compute shader stages, behind the backend interfaces. Only these need a GL context, current from
+ *  the world's init() on, and only the libraries linking them need the GL loader.
+ */
+
+#pragma once
+
+#ifndef P3_OPENGL_BACKENDS_H
+#define P3_OPENGL_BACKENDS_H
+
+#include "P3PhysicsBackend.h"
+
+namespace P3
+{
+// All 3 stages on the GPU. They share their buffers, so they only work together. There are no box-triangle
+//  contacts, and snapshots have no contact cache, the manifolds stay in GPU memory.
+Backends createOpenGLBackends();
+}
+
+#endif // P3_OPENGL_BACKENDS_H
@@ -47,13 +47,13 @@ GLuint P3OpenGLComputeBroadPhase::initGpuBuffers()
 						| GL_MAP_COHERENT_BIT;  // Writes are automatically visible to GPU
 
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSsboIDs[P3_BOX_COLLIDERS]);
-	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(BoxColliderGpuPackage), nullptr, mapFlags);
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(BoxColliderGpuBuffer), nullptr, mapFlags);
 
 	// Keep it mapped until end of program
-	mpBoxColliderPkg = static_cast<BoxColliderGpuPackage *>(glMapBufferRange(
+	mpBoxColliderPkg = static_cast<BoxColliderGpuBuffer *>(glMapBufferRange(
 		GL_SHADER_STORAGE_BUFFER,
 		0,
-		sizeof(BoxColliderGpuPackage),
+		sizeof(BoxColliderGpuBuffer),
 		mapFlags
 	));
 
@@ -66,12 +66,12 @@ GLuint P3OpenGLComputeBroadPhase::initGpuBuffers()
 			 | GL_MAP_COHERENT_BIT;
 
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSsboIDs[P3_COLLISION_PAIRS]);
-	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(CollisionPairGpuPackage), nullptr, mapFlags);
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(CollisionPairGpuBuffer), nullptr, mapFlags);
 
-	mpCollisionPairPkg = static_cast<CollisionPairGpuPackage *>(glMapBufferRange(
+	mpCollisionPairPkg = static_cast<CollisionPairGpuBuffer *>(glMapBufferRange(
 		GL_SHADER_STORAGE_BUFFER,
 		0,
-		sizeof(CollisionPairGpuPackage),
+		sizeof(CollisionPairGpuBuffer),
 		mapFlags
 	));
 
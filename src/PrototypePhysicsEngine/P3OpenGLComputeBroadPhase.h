@@ -28,7 +28,7 @@ public:
 	GLuint getBoxCollidersID() const { return mSsboIDs[P3_BOX_COLLIDERS]; };
 	GLuint getCollisionPairsID() const { return mSsboIDs[P3_COLLISION_PAIRS]; }
 
-	CollisionPairGpuPackage const *getPCollisionPairPkg() const { return mpCollisionPairPkg; }
+	CollisionPairGpuBuffer const *getPCollisionPairPkg() const { return mpCollisionPairPkg; }
 
 	void reset();
 
@@ -77,8 +77,8 @@ private:
 	//--------------------------------- CPU data ---------------------------------//
 	AtomicCounter mAtomicCounters[3]; // Triple buffering let's go
 	AabbGpuPackage mAabbCpuData;
-	BoxColliderGpuPackage *mpBoxColliderPkg = nullptr; // Data streaming to GPU
-	CollisionPairGpuPackage *mpCollisionPairPkg = nullptr;
+	BoxColliderGpuBuffer *mpBoxColliderPkg = nullptr; // Data streaming to GPU
+	CollisionPairGpuBuffer *mpCollisionPairPkg = nullptr;
 };
 
 #endif // P3_OPENGL_COMPUTE_BROAD_PHASE_H
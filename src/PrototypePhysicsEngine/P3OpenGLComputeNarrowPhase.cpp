@@ -31,28 +31,41 @@ void P3OpenGLComputeNarrowPhase::initGpuBuffers()
 						| GL_MAP_COHERENT_BIT;
 
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSsboIDs[Buffer::MANIFOLD_FRONT]);
-	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(ManifoldGpuPackage), nullptr, mapFlags);
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(ManifoldGpuBuffer), nullptr, mapFlags);
 
 	// The pointer prob is pointing to pinned memory.
-	mpManifoldPkg[0] = static_cast<ManifoldGpuPackage *>(glMapBufferRange(
+	mpManifoldPkg[0] = static_cast<ManifoldGpuBuffer *>(glMapBufferRange(
 		GL_SHADER_STORAGE_BUFFER,
 		0,
-		sizeof(ManifoldGpuPackage),
+		sizeof(ManifoldGpuBuffer),
 		mapFlags
 	));
 
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSsboIDs[Buffer::MANIFOLD_BACK]);
-	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(ManifoldGpuPackage), nullptr, mapFlags);
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(ManifoldGpuBuffer), nullptr, mapFlags);
 
 	// The pointer prob is pointing to pinned memory.
-	mpManifoldPkg[1] = static_cast<ManifoldGpuPackage *>(glMapBufferRange(
+	mpManifoldPkg[1] = static_cast<ManifoldGpuBuffer *>(glMapBufferRange(
 		GL_SHADER_STORAGE_BUFFER,
 		0,
-		sizeof(ManifoldGpuPackage),
+		sizeof(ManifoldGpuBuffer),
 		mapFlags
 	));
 }
 
+void P3OpenGLComputeNarrowPhase::reset()
+{
+	// The buffers are mapped read only, so their manifold counts are zeroed from the GL side
+	for (Buffer buffer : { Buffer::MANIFOLD_FRONT, Buffer::MANIFOLD_BACK })
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSsboIDs[buffer]);
+		glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_RGBA32I, 0, sizeof(glm::ivec4), GL_RGBA_INTEGER, GL_INT, nullptr);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0u);
+	glFinish();
+}
+
 void P3OpenGLComputeNarrowPhase::step()
 {
 	GLuint currProgID = mComputeProgIDs[ComputeShader::SAT];
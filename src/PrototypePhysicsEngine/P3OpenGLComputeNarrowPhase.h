@@ -14,7 +14,7 @@ constexpr uint16_t cNarrowPhaseComputeProgramCount = 1u;
 constexpr GLsizei cNarrowPhaseSsboCount = 2u;
 
 struct BoundingVolume;
-struct ManifoldGpuPackage;
+struct ManifoldGpuBuffer;
 
 class P3OpenGLComputeNarrowPhase
 {
@@ -23,8 +23,8 @@ public:
 
 	void step();
 
-	ManifoldGpuPackage *getPManifoldPkg() { return mpManifoldPkg[mFrontBufferIdx]; }
-	ManifoldGpuPackage *getPBackManifoldPkg() { return mpManifoldPkg[!mFrontBufferIdx]; }
+	ManifoldGpuBuffer *getPManifoldPkg() { return mpManifoldPkg[mFrontBufferIdx]; }
+	ManifoldGpuBuffer *getPBackManifoldPkg() { return mpManifoldPkg[!mFrontBufferIdx]; }
 	
 	// Only call this if you know what you are doing
 	void swapBuffers()
@@ -38,6 +38,7 @@ public:
 
 	GLuint getManifoldBufferID() { return mSsboIDs[Buffer::MANIFOLD_FRONT]; }
 
+	// Drops the manifolds of both buffers, nothing is warm started from them
 	void reset();
 
 	~P3OpenGLComputeNarrowPhase()
@@ -72,7 +73,7 @@ private:
 	std::unordered_map<Buffer, GLuint> mSsboIDs{};
 
 	AtomicCounter mAtomicCounter{};
-	ManifoldGpuPackage *mpManifoldPkg[2]; // Stores the results from last physics tick
+	ManifoldGpuBuffer *mpManifoldPkg[2]; // Stores the results from last physics tick
 
 	int mFrontBufferIdx = 0;
 };
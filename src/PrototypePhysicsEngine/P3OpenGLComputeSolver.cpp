@@ -1,11 +1,11 @@
 #include "P3OpenGLComputeSolver.h"
 
+#include <cstring>
+
 #include "ComputeProgram.h"
 #include "P3NarrowPhaseCommon.h"
 #include "OpenGLUtils.h"
 
-constexpr int cIterationCount = 5;
-
 void P3OpenGLComputeSolver::init(GLuint manifoldBuffersID)
 {
 	mManifoldsID = manifoldBuffersID;
@@ -17,41 +17,33 @@ void P3OpenGLComputeSolver::init(GLuint manifoldBuffersID)
 
 	GLbitfield createFlags = mapFlags | GL_DYNAMIC_STORAGE_BIT;
 
-	glGenBuffers(4, mTransformBufferIDs);
+	glGenBuffers(2, mTransformBufferIDs);
 
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTransformBufferIDs[0]);
 	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(LinearTransform) * cMaxObjectCount, nullptr, createFlags);
-	mpRigidLinearTransforms = static_cast<LinearTransform *>(glMapBufferRange(
+	mpLinearTransforms = static_cast<LinearTransform *>(glMapBufferRange(
 		GL_SHADER_STORAGE_BUFFER,
 		0,
-		sizeof(LinearTransform) * 512,
+		sizeof(LinearTransform) * cMaxObjectCount,
 		mapFlags
 	));
 	
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTransformBufferIDs[1]);
 	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(AngularTransform) * cMaxObjectCount, nullptr, createFlags);
-	mpRigidAngularTransforms = static_cast<AngularTransform *>(glMapBufferRange(
-		GL_SHADER_STORAGE_BUFFER,
-		0,
-		sizeof(AngularTransform) * 512,
-		mapFlags
-	));
-
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTransformBufferIDs[2]);
-	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(LinearTransform) * cMaxObjectCount, nullptr, createFlags);
-	mpStaticLinearTransforms = static_cast<LinearTransform *>(glMapBufferRange(
+	mpAngularTransforms = static_cast<AngularTransform *>(glMapBufferRange(
 		GL_SHADER_STORAGE_BUFFER,
 		0,
-		sizeof(LinearTransform) * 512,
+		sizeof(AngularTransform) * cMaxObjectCount,
 		mapFlags
 	));
 
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTransformBufferIDs[3]);
-	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(AngularTransform) * cMaxObjectCount, nullptr, createFlags);
-	mpStaticAngularTransforms = static_cast<AngularTransform *>(glMapBufferRange(
+	glGenBuffers(1, &mResidualBufferID);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mResidualBufferID);
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), nullptr, createFlags);
+	mpMaxResidualBits = static_cast<GLuint *>(glMapBufferRange(
 		GL_SHADER_STORAGE_BUFFER,
 		0,
-		sizeof(AngularTransform) * 512,
+		sizeof(GLuint),
 		mapFlags
 	));
 
@@ -59,20 +51,14 @@ void P3OpenGLComputeSolver::init(GLuint manifoldBuffersID)
 
 	mDtUniformLoc = glGetUniformLocation(mSolverComputeID, "dt");
 	mManifoldIdxUniformLoc = glGetUniformLocation(mSolverComputeID, "manifoldIdx");
-	mRigidLinearSizeUniformLoc   = glGetUniformLocation(mSolverComputeID, "rigidLinearSize");
-	mRigidAngularSizeUniformLoc  = glGetUniformLocation(mSolverComputeID, "rigidAngularSize");
-	mStaticLinearSizeUniformLoc  = glGetUniformLocation(mSolverComputeID, "staticLinearSize");
-	mStaticAngularSizeUniformLoc = glGetUniformLocation(mSolverComputeID, "staticAngularSize");
 
 	mPreStepSubroutineIdx = glGetSubroutineIndex(mSolverComputeID, GL_COMPUTE_SHADER, "preStep");
 	mIterativeSolveSubroutineIdx = glGetSubroutineIndex(mSolverComputeID, GL_COMPUTE_SHADER, "iterativeSolve");
 };
 
 void P3OpenGLComputeSolver::step( int manifoldPkgSize,
-								  std::vector<LinearTransform> &rigidLinearTransformContainer,
-								  std::vector<AngularTransform> &rigidAngularTransformContainer,
-								  std::vector<LinearTransform> &staticLinearTransformContainer,
-								  std::vector<AngularTransform> &staticAngularTransformContainer,
+								  std::vector<LinearTransform> &linearTransformContainer,
+								  std::vector<AngularTransform> &angularTransformContainer,
 								  float dt)
 {
 	glUseProgram(mSolverComputeID);
@@ -81,44 +67,22 @@ void P3OpenGLComputeSolver::step( int manifoldPkgSize,
 	glBufferSubData(
 		GL_SHADER_STORAGE_BUFFER,
 		0,
-		sizeof(LinearTransform) * rigidLinearTransformContainer.size(),
-		rigidLinearTransformContainer.data()
+		sizeof(LinearTransform) * linearTransformContainer.size(),
+		linearTransformContainer.data()
 	);
 
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTransformBufferIDs[1]);
 	glBufferSubData(
 		GL_SHADER_STORAGE_BUFFER,
 		0,
-		sizeof(AngularTransform) * rigidAngularTransformContainer.size(),
-		rigidAngularTransformContainer.data()
-	);
-
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTransformBufferIDs[2]);
-	glBufferSubData(
-		GL_SHADER_STORAGE_BUFFER,
-		0,
-		sizeof(LinearTransform) * staticLinearTransformContainer.size(),
-		staticLinearTransformContainer.data()
-	);
-
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTransformBufferIDs[3]);
-	glBufferSubData(
-		GL_SHADER_STORAGE_BUFFER,
-		0,
-		sizeof(AngularTransform) * staticAngularTransformContainer.size(),
-		staticAngularTransformContainer.data()
+		sizeof(AngularTransform) * angularTransformContainer.size(),
+		angularTransformContainer.data()
 	);
 
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mManifoldsID);
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mTransformBufferIDs[0]);
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mTransformBufferIDs[1]);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, mTransformBufferIDs[2]);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, mTransformBufferIDs[3]);
-
-	glUniform1ui(mRigidLinearSizeUniformLoc, rigidLinearTransformContainer.size());
-	glUniform1ui(mRigidAngularSizeUniformLoc, rigidAngularTransformContainer.size());
-	glUniform1ui(mStaticLinearSizeUniformLoc, staticLinearTransformContainer.size());
-	glUniform1ui(mStaticAngularSizeUniformLoc, staticAngularTransformContainer.size());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, mResidualBufferID);
 
 	glUniform1f(mDtUniformLoc, dt);
 
@@ -131,8 +95,10 @@ void P3OpenGLComputeSolver::step( int manifoldPkgSize,
 		glFlush();
 	}
 
-	for (int i = 0; i < cIterationCount; ++i)
+	for (mLastIterationCount = 0; mLastIterationCount < mIterationBounds.maxIterationCount; )
 	{
+		*mpMaxResidualBits = 0u;
+
 		for (int j = 0; j < manifoldPkgSize; ++j)
 		{
 			glUniform1ui(mManifoldIdxUniformLoc, j);
@@ -140,25 +106,28 @@ void P3OpenGLComputeSolver::step( int manifoldPkgSize,
 			glDispatchCompute(1, 1, 1);
 			glFlush();
 		}
-	}
 
-	for (int i = 0; i < rigidLinearTransformContainer.size(); ++i)
-	{
-		rigidLinearTransformContainer[i] = mpRigidLinearTransforms[i];
-	}
+		if (++mLastIterationCount < mIterationBounds.minIterationCount)
+			continue;
 
-	for (int j = 0; j < rigidAngularTransformContainer.size(); ++j)
-	{
-		rigidAngularTransformContainer[j] = mpRigidAngularTransforms[j];
+		// Reading the residual back means waiting for the iteration to finish
+		glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+		oglutils::wait(oglutils::lock());
+
+		float residual = 0.0f;
+		std::memcpy(&residual, mpMaxResidualBits, sizeof(float));
+
+		if (residual <= mResidualTolerance)
+			break;
 	}
 
-	for (int k = 0; k < staticLinearTransformContainer.size(); ++k)
+	for (int i = 0; i < linearTransformContainer.size(); ++i)
 	{
-		staticLinearTransformContainer[k] = mpStaticLinearTransforms[k];
+		linearTransformContainer[i] = mpLinearTransforms[i];
 	}
 
-	for (int l = 0; l < staticAngularTransformContainer.size(); ++l)
+	for (int j = 0; j < angularTransformContainer.size(); ++j)
 	{
-		staticAngularTransformContainer[l] = mpStaticAngularTransforms[l];
+		angularTransformContainer[j] = mpAngularTransforms[j];
 	}
 }
\ No newline at end of file
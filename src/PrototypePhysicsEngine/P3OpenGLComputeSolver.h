@@ -17,28 +17,33 @@ class P3OpenGLComputeSolver
 public:
 	void init(GLuint);
 
+	// The manifolds index the transforms directly, static bodies included
 	void step( int,
-			   std::vector<LinearTransform> &,
-			   std::vector<AngularTransform> &,
 			   std::vector<LinearTransform> &,
 			   std::vector<AngularTransform> &,
 			   float );
 
+	// Same meaning as in P3ConstraintSolver. Checking the residual waits on the GPU once per iteration, past the min.
+	void setIterationBounds(P3::IterationBounds const &bounds) { mIterationBounds = bounds; }
+	void setResidualTolerance(float tolerance) { mResidualTolerance = tolerance; }
+
+	int getLastIterationCount() const { return mLastIterationCount; }
+
 private:
 	GLuint mManifoldsID = 0u;
-	GLuint mTransformBufferIDs[4];
+	GLuint mTransformBufferIDs[2];
+	GLuint mResidualBufferID = 0u;
+
+	LinearTransform *mpLinearTransforms;
+	AngularTransform *mpAngularTransforms;
+	GLuint *mpMaxResidualBits; // Bits of a positive float, so the shader can atomicMax them as uints
 
-	LinearTransform *mpRigidLinearTransforms;
-	AngularTransform *mpRigidAngularTransforms;
-	LinearTransform *mpStaticLinearTransforms;
-	AngularTransform *mpStaticAngularTransforms;
+	P3::IterationBounds mIterationBounds{ 1, 5 };
+	float mResidualTolerance = 1e-4f;
+	int mLastIterationCount = 0;
 	
 	GLuint mDtUniformLoc = 0u;
 	GLuint mManifoldIdxUniformLoc = 0u;
-	GLuint mRigidLinearSizeUniformLoc   = 0u;
-	GLuint mRigidAngularSizeUniformLoc  = 0u;
-	GLuint mStaticLinearSizeUniformLoc  = 0u;
-	GLuint mStaticAngularSizeUniformLoc = 0u;
 
 	GLuint mPreStepSubroutineIdx = 0u;
 	GLuint mIterativeSolveSubroutineIdx = 0u;
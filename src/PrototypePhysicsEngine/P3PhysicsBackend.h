@@ -0,0 +1,121 @@
+/**
+ * The stages of the pipeline the world can run on different hardware. The world steps them through these
+ *  interfaces and owns whichever ones it is given, so the choice is made at runtime instead of at compile time.
+ *  The CPU stages implement them directly and are the default, the OpenGL ones are in P3OpenGLBackends.h, which
+ *  is the only part that needs a GL context.
+ */
+
+#pragma once
+
+#ifndef P3_PHYSICS_BACKEND_H
+#define P3_PHYSICS_BACKEND_H
+
+#include <memory>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "P3Common.h"
+
+struct P3BoxCollider;
+struct CollisionPairGpuPackage;
+struct ManifoldGpuPackage;
+struct LinearTransform;
+struct AngularTransform;
+
+namespace P3
+{
+class TriangleMeshCollider;
+
+class BroadPhaseBackend
+{
+public:
+	virtual ~BroadPhaseBackend() {}
+
+	virtual void init() = 0;
+
+	// The world steps each stage as a task on the job system, see P3JobSystem.h. Stages that must stay on the
+	//  thread stepping the world, e.g. because they make GL calls, return true.
+	virtual bool isBoundToCallingThread() const { return false; }
+
+	// Sweeps are the displacements of the boxes over the coming step, for speculative contacts. May be ignored.
+	virtual CollisionPairGpuPackage const *step( std::vector<P3BoxCollider> const &,
+												 std::vector<glm::vec3> const &sweeps ) = 0;
+
+	virtual CollisionPairGpuPackage const *getPCollisionPairPkg() const = 0;
+};
+
+class NarrowPhaseBackend
+{
+public:
+	virtual ~NarrowPhaseBackend() {}
+
+	virtual void init() = 0;
+
+	// See BroadPhaseBackend
+	virtual bool isBoundToCallingThread() const { return false; }
+
+	// The pairs come from the broad phase of the same step
+	virtual ManifoldGpuPackage *step( std::vector<P3BoxCollider> const &,
+									  CollisionPairGpuPackage const *,
+									  std::vector<glm::vec3> const &sweeps ) = 0;
+
+	// After step(), the manifolds of the given dynamic boxes against the triangle meshes, with the body index of
+	//  each mesh, are appended after the box-box ones. Backends without box-triangle contacts keep the box-box
+	//  manifolds as they are.
+	virtual ManifoldGpuPackage *stepTriangleMeshes( std::vector<int> const &,
+													std::vector<TriangleMeshCollider> const &,
+													std::vector<int> const & )
+	{
+		return getPManifoldPkg();
+	}
+
+	virtual ManifoldGpuPackage *getPManifoldPkg() = 0;
+
+	// The manifolds the next step warm starts from, once the buffers are swapped. nullptr when they don't live in
+	//  host memory, snapshots then leave the contact cache out.
+	virtual ManifoldGpuPackage *getPWarmStartCache() { return nullptr; }
+
+	// Removing a body moves others to new indices, see P3DynamicsWorld::removeBody. The manifolds kept from the
+	//  last step must follow, or the next step warm starts contacts between the wrong bodies: the removed body's
+	//  are dropped first, then each move renames a body to an index that is free by then.
+	virtual void onBodyRemoved(int bodyIdx) = 0;
+	virtual void onBodyMoved(int fromBodyIdx, int toBodyIdx) = 0;
+
+	virtual void swapBuffers() = 0;
+};
+
+class SolverBackend
+{
+public:
+	virtual ~SolverBackend() {}
+
+	virtual void init() = 0;
+
+	// See BroadPhaseBackend
+	virtual bool isBoundToCallingThread() const { return false; }
+
+	// When true, solve() applies gravity itself and the world must not integrate it beforehand
+	virtual bool isApplyingGravity() const = 0;
+
+	// The manifolds index the transforms directly, static bodies included
+	virtual void solve( ManifoldGpuPackage &,
+						std::vector<LinearTransform> &,
+						std::vector<AngularTransform> &,
+						float dt ) = 0;
+
+	virtual void setIterationBounds(IterationBounds const &) = 0;
+	virtual void setResidualTolerance(float) = 0;
+};
+
+// Any stage left empty stays on the CPU. The stages of one backend may rely on each other, e.g. the OpenGL narrow
+//  phase reads the pairs its broad phase left on the GPU, so they are meant to be swapped in together.
+struct Backends
+{
+	std::unique_ptr<BroadPhaseBackend> pBroadPhase;
+	std::unique_ptr<NarrowPhaseBackend> pNarrowPhase;
+	std::unique_ptr<SolverBackend> pSolver;
+};
+}
+
+#endif // P3_PHYSICS_BACKEND_H
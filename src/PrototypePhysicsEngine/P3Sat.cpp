@@ -1,12 +1,15 @@
 #include "P3Sat.h"
 
 #include <array>
+#include <cassert>
 #include <limits>
-#include <unordered_set>
+#include <vector>
 
 #include <glm/gtx/hash.hpp>
 
 #include "P3BroadPhaseCommon.h"
+#include "P3FrameArena.h"
+#include "P3JobSystem.h"
 #include "P3NarrowPhaseCommon.h"
 
 constexpr int cVertCountPerEdge  =  2;
@@ -17,6 +20,7 @@ constexpr int cColliderVertCount =  8;
 constexpr float cEpsilon = 0.0001f;
 constexpr float cPersistentThresholdSq_Manifold = 0.5f;
 constexpr float cPersistentThresholdSq_Contact  = 0.25f;
+constexpr int cCollisionPairsPerTask = 64;
 
 using BoxCollider = glm::vec4 const *; // A constant array
 using ColliderFaceNormals = std::array<std::array<glm::vec3, cColliderFaceCount>, cMaxColliderCount>;
@@ -223,7 +227,7 @@ int getIncidentFaceIdx(BoxCollider incidentBox, glm::vec3 const &referenceNormal
 }
 
 // Filter out bad contact points - if this function is called, it's assumed that there are more than 4 contact points.
-void reduceContactPoints(Manifold &manifold)
+void P3::reduceContactPoints(WorkingManifold &manifold)
 {
 	// First contact point - query a support point in normal of contact plane
 	int firstContactIdx     = -1;
@@ -306,17 +310,28 @@ void reduceContactPoints(Manifold &manifold)
 	assert(fourthContactIdx > -1);
 	glm::vec3 d = manifold.contacts[fourthContactIdx].position;
 
-	// The w component could be anything really.
-	manifold.contacts[0].position = glm::vec4(a, 1.0f);
-	manifold.contacts[1].position = glm::vec4(b, 1.0f);
-	manifold.contacts[2].position = glm::vec4(c, 1.0f);
-	manifold.contacts[3].position = glm::vec4(d, 1.0f);
-	manifold.contactBoxIndicesAndContactCount.z = 4;
+	// Keep the whole contacts, not just the positions, so separations and warm started impulses survive.
+	Contact reducedContacts[cMaxManifoldContactCount] =
+	{
+		manifold.contacts[firstContactIdx],
+		manifold.contacts[secondContactIdx],
+		manifold.contacts[thirdContactIdx],
+		manifold.contacts[fourthContactIdx]
+	};
+
+	for (int m = 0; m < cMaxManifoldContactCount; ++m)
+	{
+		manifold.contacts[m] = reducedContacts[m];
+	}
+
+	manifold.contactBoxIndicesAndContactCount.z = cMaxManifoldContactCount;
 }
 
-Manifold createFaceContact( FaceQuery const &faceQueryA, FaceQuery const &faceQueryB,
-							BoxCollider boxA, BoxCollider boxB,
-							int boxAIdx, int boxBIdx )
+// A positive speculative margin also keeps the incident vertices that are above the reference face, but within the
+//  margin. Their separation is stored in the contacts, for the solver to only engage them if the gap closes this step.
+WorkingManifold createFaceContact( FaceQuery const &faceQueryA, FaceQuery const &faceQueryB,
+								   BoxCollider boxA, BoxCollider boxB,
+								   int boxAIdx, int boxBIdx, float speculativeMargin )
 {
 	int referenceBoxIdx = -1;
 	int incidentBoxIdx  = -1;
@@ -328,8 +343,10 @@ Manifold createFaceContact( FaceQuery const &faceQueryA, FaceQuery const &faceQu
 	constexpr float cAxisBias = 0.4f;
 
 	// Identify reference plane, then incident face
-	// Apply a bias to prefer a certain axis of penetration, i.e the rigid body feature
-	if (cAxisBias * faceQueryA.largestDist > faceQueryB.largestDist)
+	// Apply a bias to prefer a certain axis of penetration, i.e the rigid body feature. When the boxes are apart,
+	//  the separating axis is simply the one with the largest distance.
+	bool isSeparated = faceQueryA.largestDist > 0.0f || faceQueryB.largestDist > 0.0f;
+	if (isSeparated ? faceQueryA.largestDist >= faceQueryB.largestDist : cAxisBias * faceQueryA.largestDist > faceQueryB.largestDist)
 	{
 		referencePlane  = getPlane(boxA, faceQueryA.faceIdx);
 		referenceBoxIdx = boxAIdx;
@@ -366,10 +383,21 @@ Manifold createFaceContact( FaceQuery const &faceQueryA, FaceQuery const &faceQu
 	// TODO: Need some sort of way to keep track of what points already got clipped out. If it already got clipped
 	//  by a plane, then it wouldn't be considered to be clipped again.
 	// Also, there might be duplicates, i.e store the vert that's already stored.
-	std::unordered_set<glm::vec3> includedVertSet; // Oh yea, this is big brain time.
-	std::unordered_set<glm::vec3> clippedVertSet;
+	P3::FrameUnorderedMap<glm::vec3, float> includedVertMap; // Oh yea, this is big brain time. Maps to the separation.
+	P3::FrameUnorderedSet<glm::vec3> clippedVertSet;
 	constexpr int actualIndices[4] = { 1, 2, 3, 0 };
 
+	// Penetrating vertices only, unless speculative
+	float const includedSeparation = speculativeMargin > 0.0f ? speculativeMargin : -cEpsilon;
+	auto includeVert = [&](glm::vec3 const &vert)
+	{
+		float separation = getSignedDist(vert, referencePlane);
+		if (separation <= includedSeparation)
+		{
+			includedVertMap.emplace(projectPointOntoPlane(vert, referencePlane), separation);
+		}
+	};
+
 	// Iterate over all the faces of the reference box
 	for (int faceIdx = 0; faceIdx < cColliderFaceCount; ++faceIdx)
 	{
@@ -398,29 +426,19 @@ Manifold createFaceContact( FaceQuery const &faceQueryA, FaceQuery const &faceQu
 					projPointOntoRefPlane = projectPointOntoPlane(startVert, referencePlane);
 					clippedVertSet.insert(projPointOntoRefPlane);
 
-					if (getSignedDist(endVert, referencePlane) <= -cEpsilon)
-					{
-						projPointOntoRefPlane = projectPointOntoPlane(endVert, referencePlane);
-						includedVertSet.insert(projPointOntoRefPlane);
-					}
+					includeVert(endVert);
 
 					lerpRatio = startSignedDist / (startSignedDist - endSignedDist);
 					lerpIntersectPoint = glm::mix(startVert, endVert, lerpRatio);
 
-					if (getSignedDist(lerpIntersectPoint, referencePlane) <= -cEpsilon)
-					{
-						projPointOntoRefPlane = projectPointOntoPlane(lerpIntersectPoint, referencePlane);
-						includedVertSet.insert(projPointOntoRefPlane);
-					}
+					includeVert(lerpIntersectPoint);
 				}
 
 				// Both start and end vertices are on the negative side, store only the end vert because start vert already got
 				//  stored from the previous iteration.
-				else if (   startSignedDist < -cEpsilon && endSignedDist < -cEpsilon
-						 && getSignedDist(endVert, referencePlane) <= -cEpsilon )
+				else if (startSignedDist < -cEpsilon && endSignedDist < -cEpsilon)
 				{
-					projPointOntoRefPlane = projectPointOntoPlane(endVert, referencePlane);
-					includedVertSet.insert(projPointOntoRefPlane);
+					includeVert(endVert);
 				}
 
 				// If start vert is on the negative side, and end vert is on the positive side, only lerp the intersection,
@@ -433,11 +451,7 @@ Manifold createFaceContact( FaceQuery const &faceQueryA, FaceQuery const &faceQu
 					lerpRatio = startSignedDist / (startSignedDist - endSignedDist);
 					lerpIntersectPoint = glm::mix(startVert, endVert, lerpRatio);
 
-					if (getSignedDist(lerpIntersectPoint, referencePlane) <= -cEpsilon)
-					{
-						projPointOntoRefPlane = projectPointOntoPlane(lerpIntersectPoint, referencePlane);
-						includedVertSet.insert(projPointOntoRefPlane);
-					}
+					includeVert(lerpIntersectPoint);
 				}
 
 				startVert = endVert;
@@ -446,15 +460,16 @@ Manifold createFaceContact( FaceQuery const &faceQueryA, FaceQuery const &faceQu
 	}
 
 	int contactPointCount = 0;
-	Manifold manifold;
+	WorkingManifold manifold;
 
 	// Process the clipped and included sets. Once the vert got clipped, game over.
 	// Iterate through the included set, check if it's got clip in the clipped set; if not, store it as contact point
-	for (glm::vec3 const &potContactPoint : includedVertSet)
+	for (auto const &potContactPoint : includedVertMap)
 	{
-		if (contactPointCount < cMaxContactPointCount && clippedVertSet.find(potContactPoint) == clippedVertSet.end())
+		if (contactPointCount < cMaxContactPointCount && clippedVertSet.find(potContactPoint.first) == clippedVertSet.end())
 		{
-			manifold.contacts[contactPointCount++].position = glm::vec4(potContactPoint, 1.0f);
+			manifold.contacts[contactPointCount].position = glm::vec4(potContactPoint.first, 1.0f);
+			manifold.contacts[contactPointCount++].separation.w = potContactPoint.second;
 		}
 	}
 
@@ -463,17 +478,17 @@ Manifold createFaceContact( FaceQuery const &faceQueryA, FaceQuery const &faceQu
 	manifold.contactBoxIndicesAndContactCount.z = contactPointCount;
 	manifold.contactNormal = glm::vec4(referencePlane.normal, referenceSeparation);
 
-	if (contactPointCount > 4)
+	if (contactPointCount > cMaxManifoldContactCount)
 	{
-		reduceContactPoints(manifold);
+		P3::reduceContactPoints(manifold);
 	}
 
 	return manifold;
 }
 
-Manifold createEdgeContact(EdgeQuery edgeQuery, int boxAIdx, int boxBIdx)
+WorkingManifold createEdgeContact(EdgeQuery edgeQuery, int boxAIdx, int boxBIdx)
 {
-	Manifold manifold;
+	WorkingManifold manifold;
 
 	float s = 0, t = 0;
 
@@ -523,25 +538,33 @@ glm::vec3 getCOM(BoxCollider boxCollider)
 	return 0.5f * (boxCollider[5] + boxCollider[3]);
 }
 
-// @return: number of valid manifolds
-int validateOldManifold( ManifoldGpuPackage *pFrontManifoldPkg,
-						 ManifoldGpuPackage *pBackManifoldPkg,
-						 BoxColliderGpuPackage const &boxColliderPkg )
+// The manifolds of last step that still hold, with the contacts that still do. Speculative contacts are dropped, their
+//  separation is from before the bodies moved, the narrow phase finds them again with the one they have now.
+void validateOldManifold( P3::FrameVector<WorkingManifold> &validManifolds,
+						  ManifoldGpuPackage const *pBackManifoldPkg,
+						  BoxColliderGpuPackage const &boxColliderPkg )
 {
-	static int frameCount = 0;
-
-	int availableIdx = 0;
+	validManifolds.reserve(pBackManifoldPkg->misc.x);
 
 	for (int manifoldIdx = 0; manifoldIdx < pBackManifoldPkg->misc.x; ++manifoldIdx)
 	{
-		Manifold manifold = pBackManifoldPkg->manifolds[manifoldIdx];
+		Manifold const &oldManifold = pBackManifoldPkg->manifolds[manifoldIdx];
+		Contact const *oldContacts = pBackManifoldPkg->getContacts(oldManifold);
+
+		// Box-triangle manifolds are regenerated every step, see P3MeshContact
+		if (oldManifold.contactBoxIndicesAndContactCount.w) continue;
+
+		WorkingManifold manifold;
+		static_cast<Manifold &>(manifold) = oldManifold;
 
 		int validContactCount = 0;
-		Contact validContacts[4];
+		Contact validContacts[cMaxManifoldContactCount];
 
 		for (int contactIdx = 0; contactIdx < manifold.contactBoxIndicesAndContactCount.z; ++contactIdx)
 		{
-			Contact contact = manifold.contacts[contactIdx];
+			Contact contact = oldContacts[contactIdx];
+
+			if (contact.separation.w > 0.0f) continue;
 
 			BoxCollider referenceBox = boxColliderPkg[manifold.contactBoxIndicesAndContactCount.x];
 			BoxCollider incidentBox  = boxColliderPkg[manifold.contactBoxIndicesAndContactCount.y];
@@ -575,52 +598,59 @@ int validateOldManifold( ManifoldGpuPackage *pFrontManifoldPkg,
 
 			manifold.contactBoxIndicesAndContactCount.z = validContactCount;
 
-			pFrontManifoldPkg->manifolds[availableIdx++] = manifold;
+			validManifolds.push_back(manifold);
 		}
 	}
-
-	return availableIdx;
 }
 
-bool validateNewManifold( ManifoldGpuPackage *pFrontManifoldPkg,
-						  Manifold const &newManifold,
-						  int validManifoldCount)
+// False when the pair already has a manifold from last step, the new contacts are merged into it instead
+bool validateNewManifold( P3::FrameVector<WorkingManifold> &validManifolds,
+						  WorkingManifold const &newManifold )
 {
-	assert(validManifoldCount <= cMaxObjectCount);
-
-	// Find any existing manifold - potential data race here
-	for (int i = 0; i < validManifoldCount; ++i)
+	for (WorkingManifold &currentCheckingManifold : validManifolds)
 	{
-		Manifold &currentCheckingManifold = pFrontManifoldPkg->manifolds[i];
-
 		// Assume each manifold is unique
 		if (   newManifold.contactBoxIndicesAndContactCount.x == currentCheckingManifold.contactBoxIndicesAndContactCount.x
 			&& newManifold.contactBoxIndicesAndContactCount.y == currentCheckingManifold.contactBoxIndicesAndContactCount.y )
 		{
 			int currentCheckingManifoldContactCount = currentCheckingManifold.contactBoxIndicesAndContactCount.z;
 
-			// Should the separation distance be updated?
+			// The normal and the depth are the ones found this step
 			currentCheckingManifold.contactNormal = newManifold.contactNormal;
 
 			for (int j = 0; j < newManifold.contactBoxIndicesAndContactCount.z; ++j)
 			{
 				Contact const &newContact = newManifold.contacts[j];
+				Contact *pExistingContact = nullptr;
 
 				for (int l = 0; l < currentCheckingManifoldContactCount; ++l)
 				{
-					Contact const &existingContact = currentCheckingManifold.contacts[l];
+					Contact &existingContact = currentCheckingManifold.contacts[l];
 
 					glm::vec3 r = glm::vec3(newContact.position) - glm::vec3(existingContact.position);
 
 					// Proximity check
-					if (dot(r, r) > cPersistentThresholdSq_Contact)
+					if (dot(r, r) <= cPersistentThresholdSq_Contact)
 					{
-						currentCheckingManifold.contacts[currentCheckingManifold.contactBoxIndicesAndContactCount.z++] = newContact;
+						pExistingContact = &existingContact;
+						break;
+					}
+				}
 
-						if (currentCheckingManifold.contactBoxIndicesAndContactCount.z > 4)
-						{
-							reduceContactPoints(currentCheckingManifold);
-						}
+				// A contact found again takes the fresh point and separation, and keeps its impulses to warm start
+				if (pExistingContact)
+				{
+					glm::vec4 impulses = pExistingContact->normalTangentBiasImpulses;
+					*pExistingContact = newContact;
+					pExistingContact->normalTangentBiasImpulses = impulses;
+				}
+				else
+				{
+					currentCheckingManifold.contacts[currentCheckingManifold.contactBoxIndicesAndContactCount.z++] = newContact;
+
+					if (currentCheckingManifold.contactBoxIndicesAndContactCount.z > cMaxManifoldContactCount)
+					{
+						P3::reduceContactPoints(currentCheckingManifold);
 					}
 				}
 			}
@@ -637,60 +667,85 @@ bool validateNewManifold( ManifoldGpuPackage *pFrontManifoldPkg,
 void P3::sat( ManifoldGpuPackage *pFrontManifoldPkg,
 			  ManifoldGpuPackage *pBackManifoldPkg,
 			  BoxColliderGpuPackage const &boxColliderPkg,
-			  const CollisionPairGpuPackage *pCollisionPairPkg )
+			  const CollisionPairGpuPackage *pCollisionPairPkg,
+			  std::vector<glm::vec3> const &sweeps )
 {
-	int availableIdx = validateOldManifold(pFrontManifoldPkg, pBackManifoldPkg, boxColliderPkg);
-	int validManifoldCount = availableIdx;
-	int boxAIdx = -1;
-	int boxBIdx = -1;
-	BoxCollider boxA = nullptr;
-	BoxCollider boxB = nullptr;
+	P3::FrameVector<WorkingManifold> validManifolds;
+	validateOldManifold(validManifolds, pBackManifoldPkg, boxColliderPkg);
+
+	int collisionPairCount = pCollisionPairPkg->misc.x;
 	constexpr float cQueryBias = 0.5f;
 
-	for (int collisionPairIdx = 0; collisionPairIdx < pCollisionPairPkg->misc.x; ++collisionPairIdx)
+	// The pairs are tested in parallel, each into its own slot, a contact count of 0 when they don't touch.
+	//  They are merged with the persistent manifolds after, in pair order, same as testing them one by one.
+	P3::FrameVector<WorkingManifold> newManifolds(collisionPairCount);
+
+	getJobSystem().parallelFor(collisionPairCount, cCollisionPairsPerTask, [&](int begin, int end)
 	{
-		boxAIdx = pCollisionPairPkg->collisionPairs[collisionPairIdx].x;
-		boxBIdx = pCollisionPairPkg->collisionPairs[collisionPairIdx].y;
-		boxA = boxColliderPkg[boxAIdx];
-		boxB = boxColliderPkg[boxBIdx];
-
-		// Look at faces of A
-		FaceQuery faceQueryA = queryFaceDirections(boxA, boxB);
-		if (faceQueryA.largestDist > cEpsilon) continue; // We have found a separating axis. No overlap.
-
-		FaceQuery faceQueryB = queryFaceDirections(boxB, boxA); // Look at faces of B
-		if (faceQueryB.largestDist > cEpsilon) continue;
-
-		//EdgeQuery edgeQuery = queryEdgeDirections(boxA, boxB); // Look at edges of A and B
-		//// TODO: This is stupidly hacky, don't leave this like this.
-		//if (edgeQuery.largestDist > cEpsilon) edgeQuery.largestDist = -edgeQuery.largestDist;
-
-		//if (edgeQuery.largestDist > cEpsilon) continue;
-
-		// If we get to here, there's no separating axis, the 2 boxes must overlap.
-		// Remember that at this point, largestFaceADist, largestFaceBDist, and edgeLargestDist
-		//  are all negative, so whichever is the least negative is the minimum penetration distance.
-		// Find the closest feature type
-		Manifold manifold;
-
-		// Apply a bias to prefer face contact over edge contact in the case when the separations returned
-		//  from the face query and edge query are the same.
-		//if (   cQueryBias * faceQueryA.largestDist > edgeQuery.largestDist
-		//	&& cQueryBias * faceQueryB.largestDist > edgeQuery.largestDist )
-		//{
-		//	manifold = createFaceContact(faceQueryA, faceQueryB, boxA, boxB, boxAIdx, boxBIdx);
-		//}
-		//else
-		//{
-		//	manifold = createEdgeContact(edgeQuery, boxAIdx, boxBIdx);
-		//}
-		manifold = createFaceContact(faceQueryA, faceQueryB, boxA, boxB, boxAIdx, boxBIdx);
-
-		if (validateNewManifold(pFrontManifoldPkg, manifold, validManifoldCount))
+		for (int collisionPairIdx = begin; collisionPairIdx < end; ++collisionPairIdx)
 		{
-			pFrontManifoldPkg->manifolds[availableIdx++] = manifold;
+			int boxAIdx = pCollisionPairPkg->collisionPairs[collisionPairIdx].x;
+			int boxBIdx = pCollisionPairPkg->collisionPairs[collisionPairIdx].y;
+			BoxCollider boxA = boxColliderPkg[boxAIdx];
+			BoxCollider boxB = boxColliderPkg[boxBIdx];
+
+			// Pairs that are apart, but could close the gap this step, still get a speculative manifold
+			glm::vec3 sweepA = boxAIdx < static_cast<int>(sweeps.size()) ? sweeps[boxAIdx] : glm::vec3(0.0f);
+			glm::vec3 sweepB = boxBIdx < static_cast<int>(sweeps.size()) ? sweeps[boxBIdx] : glm::vec3(0.0f);
+			float speculativeMargin = glm::length(sweepA - sweepB);
+			float maxSeparation = std::max(cEpsilon, speculativeMargin);
+
+			// Look at faces of A
+			FaceQuery faceQueryA = queryFaceDirections(boxA, boxB);
+			if (faceQueryA.largestDist > maxSeparation) continue; // We have found a separating axis. No overlap.
+
+			FaceQuery faceQueryB = queryFaceDirections(boxB, boxA); // Look at faces of B
+			if (faceQueryB.largestDist > maxSeparation) continue;
+
+			//EdgeQuery edgeQuery = queryEdgeDirections(boxA, boxB); // Look at edges of A and B
+			//// TODO: This is stupidly hacky, don't leave this like this.
+			//if (edgeQuery.largestDist > cEpsilon) edgeQuery.largestDist = -edgeQuery.largestDist;
+
+			//if (edgeQuery.largestDist > cEpsilon) continue;
+
+			// If we get to here, there's no separating axis, the 2 boxes must overlap.
+			// Remember that at this point, largestFaceADist, largestFaceBDist, and edgeLargestDist
+			//  are all negative, so whichever is the least negative is the minimum penetration distance.
+			// Find the closest feature type
+			WorkingManifold &manifold = newManifolds[collisionPairIdx];
+
+			// Apply a bias to prefer face contact over edge contact in the case when the separations returned
+			//  from the face query and edge query are the same.
+			//if (   cQueryBias * faceQueryA.largestDist > edgeQuery.largestDist
+			//	&& cQueryBias * faceQueryB.largestDist > edgeQuery.largestDist )
+			//{
+			//	manifold = createFaceContact(faceQueryA, faceQueryB, boxA, boxB, boxAIdx, boxBIdx);
+			//}
+			//else
+			//{
+			//	manifold = createEdgeContact(edgeQuery, boxAIdx, boxBIdx);
+			//}
+			manifold = createFaceContact(faceQueryA, faceQueryB, boxA, boxB, boxAIdx, boxBIdx, speculativeMargin);
 		}
+	});
+
+	for (WorkingManifold &manifold : newManifolds)
+	{
+		if (manifold.contactBoxIndicesAndContactCount.z && !validateNewManifold(validManifolds, manifold))
+			manifold.contactBoxIndicesAndContactCount.z = 0;
+	}
+
+	// Packed only now, the manifolds from last step can still gain contacts until here
+	pFrontManifoldPkg->clear();
+
+	for (WorkingManifold const &manifold : validManifolds)
+	{
+		pFrontManifoldPkg->add(manifold);
 	}
 
-	pFrontManifoldPkg->misc.x = availableIdx;
+	for (WorkingManifold const &manifold : newManifolds)
+	{
+		if (manifold.contactBoxIndicesAndContactCount.z)
+			pFrontManifoldPkg->add(manifold);
+	}
 }
@@ -3,8 +3,12 @@
 #ifndef P3_SAT_H
 #define P3_SAT_H
 
+#include <glm/vec3.hpp>
+#include <vector>
+
 struct BoxColliderGpuPackage;
 struct CollisionPairGpuPackage;
+struct WorkingManifold;
 struct ManifoldGpuPackage;
 
 /**
@@ -12,7 +16,13 @@ struct ManifoldGpuPackage;
  */
 namespace P3
 {
-void sat(ManifoldGpuPackage *, ManifoldGpuPackage *, BoxColliderGpuPackage const &, const CollisionPairGpuPackage *);
+// Sweep i is the displacement of box i over the coming step, boxes past the end of it don't move. Pairs that are
+//  apart by less than their relative sweep get speculative contacts, with a positive Contact::separation.
+void sat( ManifoldGpuPackage *, ManifoldGpuPackage *, BoxColliderGpuPackage const &, const CollisionPairGpuPackage *,
+		  std::vector<glm::vec3> const & = std::vector<glm::vec3>() );
+
+// Reduce a manifold with more than 4 contact points down to the 4 that span the largest area
+void reduceContactPoints(WorkingManifold &);
 }
 
 #endif // P3_SAT_H
@@ -0,0 +1,35 @@
+#include "P3Simd.h"
+
+#if defined(P3_SIMD_AVX2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+bool queryAvx2()
+{
+#if defined(P3_SIMD_AVX2) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+
+	// AVX, and the OS saves the YMM registers
+	__cpuid(info, 1);
+	bool isAvxEnabled = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6u) == 6u;
+
+	__cpuidex(info, 7, 0);
+	return isAvxEnabled && (info[1] & (1 << 5));
+#elif defined(P3_SIMD_AVX2)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+}
+
+bool P3::hasAvx2()
+{
+	static bool const isSupported = queryAvx2();
+	return isSupported;
+}
@@ -0,0 +1,137 @@
+/**
+ * 8 wide floats for the batched kernels, one lane per contact, body or triangle. In P3::Avx2 each one is
+ *  a __m256, in P3::Scalar the same code loops over 8 floats, so the kernels are written once for both: they
+ *  are .inl files included once for each, see P3Integrator.cpp.
+ *
+ * No file is built with AVX2 as a whole: the inline functions of glm or the standard library it shares with the
+ *  rest of the module could end up as AVX2 code the linker keeps for everyone. With P3_USE_AVX2, only the
+ *  functions defined between P3_AVX2_BEGIN and P3_AVX2_END are, and the kernels check hasAvx2() before calling
+ *  them, so the module still runs on any x86 CPU.
+ */
+
+#pragma once
+
+#ifndef P3_SIMD_H
+#define P3_SIMD_H
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(P3_USE_AVX2) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define P3_SIMD_AVX2
+#include <immintrin.h>
+#endif
+
+// Functions defined in between are built for AVX2. MSVC compiles the intrinsics anywhere, it needs nothing.
+#if defined(__clang__)
+#define P3_AVX2_BEGIN _Pragma("clang attribute push (__attribute__((target(\"avx2\"))), apply_to = function)")
+#define P3_AVX2_END _Pragma("clang attribute pop")
+#elif defined(__GNUC__)
+#define P3_AVX2_BEGIN _Pragma("GCC push_options") _Pragma("GCC target(\"avx2\")")
+#define P3_AVX2_END _Pragma("GCC pop_options")
+#else
+#define P3_AVX2_BEGIN
+#define P3_AVX2_END
+#endif
+
+namespace P3
+{
+constexpr int cSimdLaneCount = 8;
+
+// Whether the AVX2 kernels are built and this CPU can run them
+bool hasAvx2();
+
+// Any CPU runs these
+namespace Scalar
+{
+struct Float8
+{
+	float f[cSimdLaneCount];
+};
+
+inline Float8 load(float const *p)
+{
+	Float8 a;
+	for (int lane = 0; lane < cSimdLaneCount; ++lane) a.f[lane] = p[lane];
+	return a;
+}
+
+inline void store(float *p, Float8 a)
+{
+	for (int lane = 0; lane < cSimdLaneCount; ++lane) p[lane] = a.f[lane];
+}
+
+inline Float8 splat(float s)
+{
+	Float8 a;
+	for (int lane = 0; lane < cSimdLaneCount; ++lane) a.f[lane] = s;
+	return a;
+}
+
+#define P3_FLOAT8_OP(name, expr) \
+	inline Float8 name(Float8 a, Float8 b) \
+	{ \
+		Float8 c; \
+		for (int lane = 0; lane < cSimdLaneCount; ++lane) c.f[lane] = (expr); \
+		return c; \
+	}
+
+P3_FLOAT8_OP(operator+, a.f[lane] + b.f[lane])
+P3_FLOAT8_OP(operator-, a.f[lane] - b.f[lane])
+P3_FLOAT8_OP(operator*, a.f[lane] * b.f[lane])
+P3_FLOAT8_OP(operator/, a.f[lane] / b.f[lane])
+P3_FLOAT8_OP(min, a.f[lane] < b.f[lane] ? a.f[lane] : b.f[lane])
+P3_FLOAT8_OP(max, a.f[lane] > b.f[lane] ? a.f[lane] : b.f[lane])
+
+#undef P3_FLOAT8_OP
+
+inline Float8 abs(Float8 a)
+{
+	for (int lane = 0; lane < cSimdLaneCount; ++lane) a.f[lane] = a.f[lane] < 0.0f ? -a.f[lane] : a.f[lane];
+	return a;
+}
+
+inline Float8 sqrt(Float8 a)
+{
+	for (int lane = 0; lane < cSimdLaneCount; ++lane) a.f[lane] = std::sqrt(a.f[lane]);
+	return a;
+}
+
+#include "P3SimdVec.inl"
+}
+}
+
+#ifdef P3_SIMD_AVX2
+P3_AVX2_BEGIN
+
+namespace P3
+{
+// Only called once hasAvx2() said so
+namespace Avx2
+{
+struct Float8
+{
+	__m256 m;
+};
+
+inline Float8 load(float const *p) { return { _mm256_loadu_ps(p) }; }
+inline void store(float *p, Float8 a) { _mm256_storeu_ps(p, a.m); }
+inline Float8 splat(float a) { return { _mm256_set1_ps(a) }; }
+
+inline Float8 operator+(Float8 a, Float8 b) { return { _mm256_add_ps(a.m, b.m) }; }
+inline Float8 operator-(Float8 a, Float8 b) { return { _mm256_sub_ps(a.m, b.m) }; }
+inline Float8 operator*(Float8 a, Float8 b) { return { _mm256_mul_ps(a.m, b.m) }; }
+inline Float8 operator/(Float8 a, Float8 b) { return { _mm256_div_ps(a.m, b.m) }; }
+inline Float8 min(Float8 a, Float8 b) { return { _mm256_min_ps(a.m, b.m) }; }
+inline Float8 max(Float8 a, Float8 b) { return { _mm256_max_ps(a.m, b.m) }; }
+inline Float8 abs(Float8 a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.m) }; }
+inline Float8 sqrt(Float8 a) { return { _mm256_sqrt_ps(a.m) }; }
+
+#include "P3SimdVec.inl"
+}
+}
+
+P3_AVX2_END
+#endif
+
+#endif // P3_SIMD_H
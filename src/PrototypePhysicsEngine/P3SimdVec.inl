@@ -0,0 +1,38 @@
+// What the kernels build on top of Float8, included in each of P3::Scalar and P3::Avx2 by P3Simd.h. Not a header
+//  on its own, so no include guard.
+
+inline float reduceMax(Float8 a)
+{
+	float lanes[cSimdLaneCount];
+	store(lanes, a);
+	return *std::max_element(lanes, lanes + cSimdLaneCount);
+}
+
+struct Vec3x8
+{
+	Float8 x, y, z;
+};
+
+inline Vec3x8 load(float const (&p)[3][cSimdLaneCount]) { return { load(p[0]), load(p[1]), load(p[2]) }; }
+
+inline void store(float (&p)[3][cSimdLaneCount], Vec3x8 const &a)
+{
+	store(p[0], a.x);
+	store(p[1], a.y);
+	store(p[2], a.z);
+}
+
+inline Vec3x8 operator+(Vec3x8 const &a, Vec3x8 const &b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Vec3x8 operator-(Vec3x8 const &a, Vec3x8 const &b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Vec3x8 operator*(Vec3x8 const &a, Float8 s) { return { a.x * s, a.y * s, a.z * s }; }
+
+// Same operation order as glm
+inline Vec3x8 cross(Vec3x8 const &a, Vec3x8 const &b)
+{
+	return { a.y * b.z - b.y * a.z, a.z * b.x - b.z * a.x, a.x * b.y - b.x * a.y };
+}
+
+inline Float8 dot(Vec3x8 const &a, Vec3x8 const &b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
@@ -0,0 +1,214 @@
+#include "P3Snapshot.h"
+
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace
+{
+uint64_t alignUp(uint64_t offset)
+{
+	return (offset + P3::cSnapshotAlignment - 1u) / P3::cSnapshotAlignment * P3::cSnapshotAlignment;
+}
+}
+
+void P3::SnapshotWriter::addSection(SnapshotSection section, void const *pData, size_t elementSize, size_t elementCount)
+{
+	PendingSection &pendingSection = mSections[static_cast<int>(section)];
+	pendingSection.pData = pData;
+	pendingSection.elementSize = elementSize;
+	pendingSection.elementCount = elementCount;
+}
+
+bool P3::SnapshotWriter::writeFile(std::string const &path) const
+{
+	SnapshotHeader header{};
+	header.magic = cSnapshotMagic;
+	header.version = cSnapshotVersion;
+
+	uint64_t offset = alignUp(sizeof(SnapshotHeader));
+	for (int i = 0; i < cSnapshotSectionCount; ++i)
+	{
+		SnapshotSectionEntry &entry = header.sections[i];
+		entry.offset = offset;
+		entry.elementSize = mSections[i].elementSize;
+		entry.elementCount = mSections[i].elementCount;
+
+		offset = alignUp(offset + entry.elementSize * entry.elementCount);
+	}
+
+	header.totalSize = offset;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	static char const padding[cSnapshotAlignment] = {};
+	uint64_t writtenSize = 0u;
+
+	auto writePaddedTo = [&](uint64_t sectionOffset)
+	{
+		file.write(padding, static_cast<std::streamsize>(sectionOffset - writtenSize));
+		writtenSize = sectionOffset;
+	};
+
+	file.write(reinterpret_cast<char const *>(&header), sizeof(SnapshotHeader));
+	writtenSize = sizeof(SnapshotHeader);
+
+	for (int i = 0; i < cSnapshotSectionCount; ++i)
+	{
+		SnapshotSectionEntry const &entry = header.sections[i];
+		writePaddedTo(entry.offset);
+
+		uint64_t byteCount = entry.elementSize * entry.elementCount;
+		if (byteCount)
+			file.write(static_cast<char const *>(mSections[i].pData), static_cast<std::streamsize>(byteCount));
+
+		writtenSize += byteCount;
+	}
+
+	writePaddedTo(header.totalSize);
+
+	return static_cast<bool>(file);
+}
+
+bool P3::SnapshotView::open(void const *pData, size_t size)
+{
+	mpData = nullptr;
+	mpHeader = nullptr;
+
+	if (!pData || size < sizeof(SnapshotHeader))
+		return false;
+
+	SnapshotHeader const *pHeader = static_cast<SnapshotHeader const *>(pData);
+	if (pHeader->magic != cSnapshotMagic || pHeader->version != cSnapshotVersion || pHeader->totalSize > size)
+		return false;
+
+	for (SnapshotSectionEntry const &entry : pHeader->sections)
+	{
+		if (entry.offset % cSnapshotAlignment || entry.offset + entry.elementSize * entry.elementCount > pHeader->totalSize)
+			return false;
+	}
+
+	mpData = static_cast<unsigned char const *>(pData);
+	mpHeader = pHeader;
+
+	return true;
+}
+
+void const *P3::SnapshotView::getSection(SnapshotSection section, size_t elementSize, size_t &elementCount) const
+{
+	elementCount = 0u;
+	if (!mpHeader)
+		return nullptr;
+
+	SnapshotSectionEntry const &entry = mpHeader->sections[static_cast<int>(section)];
+	if (!entry.elementCount || entry.elementSize != elementSize)
+		return nullptr;
+
+	elementCount = static_cast<size_t>(entry.elementCount);
+	return mpData + entry.offset;
+}
+
+#ifdef _WIN32
+bool P3::MappedFile::open(std::string const &path)
+{
+	close();
+
+	HANDLE fileHandle = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+									 FILE_ATTRIBUTE_NORMAL, nullptr );
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || !fileSize.QuadPart)
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mappingHandle)
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	mpData = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!mpData)
+	{
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	mFileHandle = fileHandle;
+	mMappingHandle = mappingHandle;
+	mSize = static_cast<size_t>(fileSize.QuadPart);
+
+	return true;
+}
+
+void P3::MappedFile::close()
+{
+	if (mpData)
+		UnmapViewOfFile(mpData);
+	if (mMappingHandle)
+		CloseHandle(mMappingHandle);
+	if (mFileHandle)
+		CloseHandle(mFileHandle);
+
+	mpData = nullptr;
+	mMappingHandle = nullptr;
+	mFileHandle = nullptr;
+	mSize = 0u;
+}
+#else
+bool P3::MappedFile::open(std::string const &path)
+{
+	close();
+
+	int fileDescriptor = ::open(path.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+		return false;
+
+	struct stat fileStatus;
+	if (fstat(fileDescriptor, &fileStatus) || !fileStatus.st_size)
+	{
+		::close(fileDescriptor);
+		return false;
+	}
+
+	void *pData = mmap(nullptr, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+
+	// The mapping holds its own reference to the file
+	::close(fileDescriptor);
+
+	if (pData == MAP_FAILED)
+		return false;
+
+	mpData = pData;
+	mSize = static_cast<size_t>(fileStatus.st_size);
+
+	return true;
+}
+
+void P3::MappedFile::close()
+{
+	if (mpData)
+		munmap(const_cast<void *>(mpData), mSize);
+
+	mpData = nullptr;
+	mSize = 0u;
+}
+#endif // _WIN32
@@ -0,0 +1,148 @@
+/**
+ * Binary world snapshots. A header, then one section per component array, each a plain copy of the array in
+ *  memory, 64 byte aligned in the file. A mapped snapshot can then be used as is: loading is one bulk copy per
+ *  section, with no parsing and no per-body work, instead of rebuilding the scene body by body.
+ *
+ * The arrays are stored with the layout of the build that wrote them, so each section also records the size
+ *  of its elements. A snapshot from a build with another layout, or from another version of the format, is
+ *  rejected instead of read wrong. Only meant to be read back by the same build, not as an interchange format.
+ *
+ * Checkpoints use the same format. A base is a full snapshot, and a delta only holds the transforms of the
+ *  bodies that changed since its base, plus the contact cache.
+ */
+
+#pragma once
+
+#ifndef P3_SNAPSHOT_H
+#define P3_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace P3
+{
+constexpr uint32_t cSnapshotMagic = 0x4e533350u; // "P3SN"
+constexpr uint32_t cSnapshotVersion = 3u;
+constexpr size_t cSnapshotAlignment = 64u;
+
+enum class SnapshotSection : uint32_t
+{
+	LINEAR_TRANSFORMS,
+	ANGULAR_TRANSFORMS,
+	BODY_SLOTS,              // The handle slot of each body index
+	BODY_SLOT_GENERATIONS,   // And the generation of each slot, removed bodies included
+	BOX_COLLIDERS,
+	BOX_COLLIDER_CTMS,
+	CCD_BODY_INDICES,
+	TRIANGLE_MESH_BODY_INDICES,
+	TRIANGLE_MESH_FIRST_VERTICES,  // Where each mesh starts in the arrays below, one past the end for the last mesh
+	TRIANGLE_MESH_FIRST_TRIANGLES,
+	TRIANGLE_MESH_VERTICES,
+	TRIANGLE_MESH_TRIANGLES,
+	MANIFOLD_MISC,           // The contact cache, i.e. the manifolds of the last step, for warm starting
+	MANIFOLDS,
+	MANIFOLD_CONTACTS,       // The contact pool the manifolds above index into
+	CHECKPOINT_ID,           // A base checkpoint's own id, or the id of the base a delta applies to
+	DELTA_BODY_INDICES,      // In a delta, the bodies whose transforms follow, in the same order
+	COUNT
+};
+
+constexpr int cSnapshotSectionCount = static_cast<int>(SnapshotSection::COUNT);
+
+struct SnapshotSectionEntry
+{
+	uint64_t offset;      // From the start of the snapshot
+	uint64_t elementSize;
+	uint64_t elementCount;
+};
+
+struct SnapshotHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t totalSize;
+	SnapshotSectionEntry sections[cSnapshotSectionCount];
+};
+
+// Sections are added in any order, then written out in one go
+class SnapshotWriter
+{
+public:
+	template<typename T>
+	void addSection(SnapshotSection section, T const *pElements, size_t elementCount)
+	{
+		addSection(section, pElements, sizeof(T), elementCount);
+	}
+
+	template<typename T>
+	void addSection(SnapshotSection section, std::vector<T> const &elements)
+	{
+		addSection(section, elements.data(), sizeof(T), elements.size());
+	}
+
+	bool writeFile(std::string const &path) const;
+
+private:
+	void addSection(SnapshotSection, void const *, size_t elementSize, size_t elementCount);
+
+	struct PendingSection
+	{
+		void const *pData = nullptr;
+		size_t elementSize = 0u;
+		size_t elementCount = 0u;
+	};
+
+	PendingSection mSections[cSnapshotSectionCount];
+};
+
+// A snapshot already in memory, e.g. mapped. Nothing is copied, the sections point into the given memory,
+//  which must outlive the view.
+class SnapshotView
+{
+public:
+	// False if the memory doesn't hold a complete snapshot of this version
+	bool open(void const *pData, size_t size);
+
+	// nullptr with a count of 0 if the section is missing, or if its elements aren't sizeof(T) in this build
+	template<typename T>
+	T const *getSection(SnapshotSection section, size_t &elementCount) const
+	{
+		return static_cast<T const *>(getSection(section, sizeof(T), elementCount));
+	}
+
+private:
+	void const *getSection(SnapshotSection, size_t elementSize, size_t &elementCount) const;
+
+	unsigned char const *mpData = nullptr;
+	SnapshotHeader const *mpHeader = nullptr;
+};
+
+// Read-only mapping of a whole file, mmap or MapViewOfFile
+class MappedFile
+{
+public:
+	MappedFile() {}
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+	~MappedFile() { close(); }
+
+	bool open(std::string const &path);
+	void close();
+
+	void const *getData() const { return mpData; }
+	size_t getSize() const { return mSize; }
+
+private:
+	void const *mpData = nullptr;
+	size_t mSize = 0u;
+
+#ifdef _WIN32
+	void *mFileHandle = nullptr;
+	void *mMappingHandle = nullptr;
+#endif // _WIN32
+};
+}
+
+#endif // P3_SNAPSHOT_H
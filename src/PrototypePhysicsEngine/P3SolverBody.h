@@ -0,0 +1,73 @@
+/**
+ * What the contact solver needs of a body, and nothing else, in one 64 byte block. The solver gathers
+ *  every body into a dense array of these once per step, iterates on it, then scatters the velocities
+ *  back to the transforms. The inverse inertia is rotated into world space during the gather, so the
+ *  iterations never touch the orientation or the 4x4 matrices of AngularTransform.
+ */
+
+#pragma once
+
+#ifndef P3_SOLVER_BODY_H
+#define P3_SOLVER_BODY_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "P3Common.h"
+
+namespace P3
+{
+// Only the upper triangle, an inertia tensor is always symmetric
+struct SymmetricMat3
+{
+	float xx, yy, zz;
+	float xy, xz, yz;
+
+	glm::vec3 operator*(glm::vec3 const &v) const
+	{
+		return glm::vec3( xx * v.x + xy * v.y + xz * v.z,
+						  xy * v.x + yy * v.y + yz * v.z,
+						  xz * v.x + yz * v.y + zz * v.z );
+	}
+};
+
+// R I R^T, the body space inverse inertia as seen from the world
+inline SymmetricMat3 computeWorldInverseInertia(glm::mat3 const &localInverseInertia, glm::quat const &orientation)
+{
+	glm::mat3 rotation = glm::mat3_cast(orientation);
+	glm::mat3 world = rotation * localInverseInertia * glm::transpose(rotation);
+
+	return { world[0][0], world[1][1], world[2][2], world[1][0], world[2][0], world[2][1] };
+}
+
+struct SolverBody
+{
+	glm::vec3 linearVelocity;
+	float inverseMass;
+	glm::vec3 angularVelocity;
+	SymmetricMat3 worldInverseInertia;
+	unsigned int flags;
+	float paddings[2];
+
+	// Bodies the solver doesn't move can be shared within a color or a wide batch, so they must not be written to
+	bool isDynamic() const { return isDynamicBody(flags); }
+};
+
+// Split impulse only. Pushes bodies out of each other without going through their velocities, moves
+//  them for a step and is then forgotten, so the correction never turns into kinetic energy.
+struct PseudoVelocity
+{
+	glm::vec3 linear;
+	glm::vec3 angular;
+};
+
+// Sub-stepping only. How far a body moved since the narrow phase ran, the angular part as a rotation vector,
+//  which is close enough over one step.
+struct Displacement
+{
+	glm::vec3 linear;
+	glm::vec3 angular;
+};
+}
+
+#endif // P3_SOLVER_BODY_H
@@ -0,0 +1,92 @@
+#include "P3SparseSet.h"
+
+P3::Handle P3::SparseSet::insert()
+{
+	uint32_t slot;
+	if (!mFreeSlots.empty())
+	{
+		slot = mFreeSlots.back();
+		mFreeSlots.pop_back();
+	}
+	else
+	{
+		slot = static_cast<uint32_t>(mSparseIndices.size());
+		mSparseIndices.emplace_back(-1);
+		mGenerations.emplace_back(0u);
+	}
+
+	mSparseIndices[slot] = size();
+	mDenseSlots.emplace_back(slot);
+
+	return { slot, mGenerations[slot] };
+}
+
+void P3::SparseSet::release(int idx)
+{
+	uint32_t slot = mDenseSlots[idx];
+
+	mSparseIndices[slot] = -1;
+	++mGenerations[slot];
+	mFreeSlots.emplace_back(slot);
+}
+
+void P3::SparseSet::move(int fromIdx, int toIdx)
+{
+	if (fromIdx == toIdx)
+		return;
+
+	mDenseSlots[toIdx] = mDenseSlots[fromIdx];
+	mSparseIndices[mDenseSlots[toIdx]] = toIdx;
+}
+
+int P3::SparseSet::getIndex(Handle handle) const
+{
+	if (handle.slot >= mSparseIndices.size() || mGenerations[handle.slot] != handle.generation)
+		return -1;
+
+	return mSparseIndices[handle.slot];
+}
+
+void P3::SparseSet::reserve(int count)
+{
+	mSparseIndices.reserve(count);
+	mGenerations.reserve(count);
+	mDenseSlots.reserve(count);
+}
+
+void P3::SparseSet::restore(uint32_t const *pSlots, size_t count, uint32_t const *pGenerations, size_t slotCount)
+{
+	mDenseSlots.assign(pSlots, pSlots + count);
+	mGenerations.assign(pGenerations, pGenerations + slotCount);
+	mSparseIndices.assign(slotCount, -1);
+
+	for (int idx = 0; idx < size(); ++idx)
+	{
+		mSparseIndices[mDenseSlots[idx]] = idx;
+	}
+
+	mFreeSlots.clear();
+	for (uint32_t slot = 0u; slot < slotCount; ++slot)
+	{
+		if (mSparseIndices[slot] < 0)
+			mFreeSlots.emplace_back(slot);
+	}
+}
+
+void P3::SparseSet::clear()
+{
+	// The generations are kept, handles from before the clear stay invalid
+	mFreeSlots.clear();
+	for (uint32_t slot = 0u; slot < mSparseIndices.size(); ++slot)
+	{
+		if (mSparseIndices[slot] >= 0)
+		{
+			mSparseIndices[slot] = -1;
+			++mGenerations[slot];
+		}
+
+		mFreeSlots.emplace_back(slot);
+	}
+
+	mDenseSlots.clear();
+}
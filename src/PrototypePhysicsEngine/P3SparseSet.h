@@ -0,0 +1,67 @@
+/**
+ * Maps the handles given out for bodies to their indices in the component arrays, and back. The arrays stay
+ *  dense: removing a body moves another one into its index, swap-and-pop, so the handles are what stays valid
+ *  across removals, never the indices.
+ *
+ * A handle is a slot and the generation that slot was on when the handle was given out. Releasing a slot bumps
+ *  its generation, so old handles to a reused slot don't resolve to whatever body took it over.
+ */
+
+#pragma once
+
+#ifndef P3_SPARSE_SET_H
+#define P3_SPARSE_SET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace P3
+{
+struct Handle
+{
+	uint32_t slot;
+	uint32_t generation;
+
+	Handle() : slot(UINT32_MAX), generation(0u) {} // Resolves to no body
+	Handle(uint32_t slot, uint32_t generation) : slot(slot), generation(generation) {}
+
+	bool operator==(Handle const &other) const { return slot == other.slot && generation == other.generation; }
+	bool operator!=(Handle const &other) const { return !(*this == other); }
+};
+
+class SparseSet
+{
+public:
+	// The new handle gets index size() - 1, the caller appends its components to match
+	Handle insert();
+
+	// Removal is done in steps, so the caller can move its components along: release the index, fill it with
+	//  moves, then pop the last index, which must be a duplicate by then or the released one itself.
+	void release(int idx);
+	void move(int fromIdx, int toIdx);
+	void popBack() { mDenseSlots.pop_back(); }
+
+	// -1 for a removed body
+	int getIndex(Handle) const;
+	Handle getHandle(int idx) const { return { mDenseSlots[idx], mGenerations[mDenseSlots[idx]] }; }
+	bool contains(Handle handle) const { return getIndex(handle) >= 0; }
+
+	int size() const { return static_cast<int>(mDenseSlots.size()); }
+	void reserve(int count);
+	void clear();
+
+	// The whole state is the slot of each index and the generation of each slot, e.g. for snapshots
+	std::vector<uint32_t> const &getSlots() const { return mDenseSlots; }
+	std::vector<uint32_t> const &getGenerations() const { return mGenerations; }
+	void restore(uint32_t const *pSlots, size_t count, uint32_t const *pGenerations, size_t slotCount);
+
+private:
+	std::vector<int> mSparseIndices; // Per slot, -1 when free
+	std::vector<uint32_t> mGenerations; // Per slot
+	std::vector<uint32_t> mDenseSlots; // Per index
+	std::vector<uint32_t> mFreeSlots;
+};
+}
+
+#endif // P3_SPARSE_SET_H
@@ -32,8 +32,10 @@ struct LinearTransform
 	float mass = 0.0f;
 	float inverseMass = 0.0f;
 
+	unsigned int flags = 0u; // cStaticBodyFlag, cKinematicBodyFlag
+
 	// To be ignored
-	float paddings[2] = { 0.0f, 0.0f };
+	float padding = 0.0f;
 
 	//----------------- State variables -----------------//
 	glm::vec4 position{};
@@ -0,0 +1,223 @@
+#include "P3TriTriBatch.h"
+
+#include "P3CpuNarrowPhase.h"
+#include "P3Simd.h"
+
+namespace
+{
+bool scalarTest(P3::TriTriBatch const &batch, int lane)
+{
+	glm::vec3 v[3], u[3];
+
+	for (int vertexIdx = 0; vertexIdx < 3; ++vertexIdx)
+	{
+		v[vertexIdx] = glm::vec3(batch.v[vertexIdx][0][lane], batch.v[vertexIdx][1][lane], batch.v[vertexIdx][2][lane]);
+		u[vertexIdx] = glm::vec3(batch.u[vertexIdx][0][lane], batch.u[vertexIdx][1][lane], batch.u[vertexIdx][2][lane]);
+	}
+
+	return fastTriTriIntersect3DTest(v[0], v[1], v[2], u[0], u[1], u[2]);
+}
+
+unsigned int testBatchScalar(P3::TriTriBatch const &batch)
+{
+	unsigned int hitMask = 0u;
+
+	for (int lane = 0; lane < batch.count; ++lane)
+	{
+		if (scalarTest(batch, lane)) hitMask |= 1u << lane;
+	}
+
+	return hitMask;
+}
+
+#ifdef P3_SIMD_AVX2
+P3_AVX2_BEGIN
+
+unsigned int getLaneMask(int count)
+{
+	return (1u << count) - 1u;
+}
+
+constexpr float cCoplanarEpsilon = 0.000001f; // Must match EPSILON of fastTriTriIntersect3DTest
+
+struct Vec3x8
+{
+	__m256 x, y, z;
+};
+
+inline Vec3x8 load(float const (&vertex)[3][P3::cTriTriBatchSize])
+{
+	return { _mm256_loadu_ps(vertex[0]), _mm256_loadu_ps(vertex[1]), _mm256_loadu_ps(vertex[2]) };
+}
+
+inline Vec3x8 sub(Vec3x8 const &a, Vec3x8 const &b)
+{
+	return { _mm256_sub_ps(a.x, b.x), _mm256_sub_ps(a.y, b.y), _mm256_sub_ps(a.z, b.z) };
+}
+
+// Same operation order as glm, so the lanes agree with the scalar test bit for bit
+inline Vec3x8 cross(Vec3x8 const &a, Vec3x8 const &b)
+{
+	return { _mm256_sub_ps(_mm256_mul_ps(a.y, b.z), _mm256_mul_ps(b.y, a.z)),
+			 _mm256_sub_ps(_mm256_mul_ps(a.z, b.x), _mm256_mul_ps(b.z, a.x)),
+			 _mm256_sub_ps(_mm256_mul_ps(a.x, b.y), _mm256_mul_ps(b.x, a.y)) };
+}
+
+inline __m256 dot(Vec3x8 const &a, Vec3x8 const &b)
+{
+	return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a.x, b.x), _mm256_mul_ps(a.y, b.y)), _mm256_mul_ps(a.z, b.z));
+}
+
+inline __m256 abs(__m256 a)
+{
+	return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a);
+}
+
+// Snap distances within epsilon of the plane onto it
+inline __m256 snapToPlane(__m256 dist)
+{
+	__m256 isOnPlane = _mm256_cmp_ps(abs(dist), _mm256_set1_ps(cCoplanarEpsilon), _CMP_LT_OQ);
+	return _mm256_andnot_ps(isOnPlane, dist);
+}
+
+inline __m256 isPositive(__m256 a)
+{
+	return _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ);
+}
+
+inline __m256 isNonZero(__m256 a)
+{
+	return _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_NEQ_UQ);
+}
+
+// computeIntersectInterval on 8 lanes. Instead of branching on which vertex is alone on its side of the plane,
+//  every lane picks its own vertex order, then ISECT runs once for all of them.
+void computeIntersectIntervals( __m256 proj0, __m256 proj1, __m256 proj2,
+								__m256 dist0, __m256 dist1, __m256 dist2,
+								__m256 prodDist0Dist1, __m256 prodDist0Dist2,
+								__m256 &isectStart, __m256 &isectEnd, __m256 &isCoplanar )
+{
+	__m256 isAlone2 = isPositive(prodDist0Dist1);
+	__m256 remaining = _mm256_andnot_ps(isAlone2, _mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+
+	__m256 isAlone1 = _mm256_and_ps(remaining, isPositive(prodDist0Dist2));
+	remaining = _mm256_andnot_ps(isAlone1, remaining);
+
+	__m256 isAlone0 = _mm256_and_ps(remaining, _mm256_or_ps(isPositive(_mm256_mul_ps(dist1, dist2)), isNonZero(dist0)));
+	remaining = _mm256_andnot_ps(isAlone0, remaining);
+
+	// Vert0 is in the plane from here on
+	__m256 isAlone1InPlane = _mm256_and_ps(remaining, isNonZero(dist1));
+	remaining = _mm256_andnot_ps(isAlone1InPlane, remaining);
+
+	__m256 isAlone2InPlane = _mm256_and_ps(remaining, isNonZero(dist2));
+	isCoplanar = _mm256_or_ps(isCoplanar, _mm256_andnot_ps(isAlone2InPlane, remaining));
+
+	isAlone1 = _mm256_or_ps(isAlone1, isAlone1InPlane);
+	isAlone2 = _mm256_or_ps(isAlone2, isAlone2InPlane);
+
+	// Alone 0: (0, 1, 2), alone 1: (1, 0, 2), alone 2: (2, 0, 1)
+	__m256 projA = _mm256_blendv_ps(_mm256_blendv_ps(proj0, proj1, isAlone1), proj2, isAlone2);
+	__m256 projB = _mm256_blendv_ps(proj0, proj1, isAlone0);
+	__m256 projC = _mm256_blendv_ps(proj2, proj1, isAlone2);
+	__m256 distA = _mm256_blendv_ps(_mm256_blendv_ps(dist0, dist1, isAlone1), dist2, isAlone2);
+	__m256 distB = _mm256_blendv_ps(dist0, dist1, isAlone0);
+	__m256 distC = _mm256_blendv_ps(dist2, dist1, isAlone2);
+
+	// ISECT. Coplanar lanes divide by 0 here, but they get masked out anyway
+	isectStart = _mm256_add_ps(projA, _mm256_div_ps(_mm256_mul_ps(_mm256_sub_ps(projB, projA), distA), _mm256_sub_ps(distA, distB)));
+	isectEnd   = _mm256_add_ps(projA, _mm256_div_ps(_mm256_mul_ps(_mm256_sub_ps(projC, projA), distA), _mm256_sub_ps(distA, distC)));
+}
+
+// Component of the intersection line direction with the largest magnitude, first one wins on ties
+inline __m256 project(Vec3x8 const &vertex, __m256 isYMax, __m256 isZMax)
+{
+	return _mm256_blendv_ps(_mm256_blendv_ps(vertex.x, vertex.y, isYMax), vertex.z, isZMax);
+}
+
+unsigned int testBatchAvx2(P3::TriTriBatch const &batch)
+{
+	Vec3x8 v0 = load(batch.v[0]), v1 = load(batch.v[1]), v2 = load(batch.v[2]);
+	Vec3x8 u0 = load(batch.u[0]), u1 = load(batch.u[1]), u2 = load(batch.u[2]);
+
+	// Plane of the first triangle, and the signed distances of the second one to it
+	Vec3x8 N1 = cross(sub(v1, v0), sub(v2, v0));
+	__m256 d1 = _mm256_sub_ps(_mm256_setzero_ps(), dot(N1, v0));
+
+	__m256 distU0 = snapToPlane(_mm256_add_ps(dot(N1, u0), d1));
+	__m256 distU1 = snapToPlane(_mm256_add_ps(dot(N1, u1), d1));
+	__m256 distU2 = snapToPlane(_mm256_add_ps(dot(N1, u2), d1));
+
+	__m256 prodDistU0DistU1 = _mm256_mul_ps(distU0, distU1);
+	__m256 prodDistU0DistU2 = _mm256_mul_ps(distU0, distU2);
+	__m256 isRejected = _mm256_and_ps(isPositive(prodDistU0DistU1), isPositive(prodDistU0DistU2));
+
+	// Plane of the second triangle, and the signed distances of the first one to it
+	Vec3x8 N2 = cross(sub(u1, u0), sub(u2, u0));
+	__m256 d2 = _mm256_sub_ps(_mm256_setzero_ps(), dot(N2, u0));
+
+	__m256 distV0 = snapToPlane(_mm256_add_ps(dot(N2, v0), d2));
+	__m256 distV1 = snapToPlane(_mm256_add_ps(dot(N2, v1), d2));
+	__m256 distV2 = snapToPlane(_mm256_add_ps(dot(N2, v2), d2));
+
+	__m256 prodDistV0DistV1 = _mm256_mul_ps(distV0, distV1);
+	__m256 prodDistV0DistV2 = _mm256_mul_ps(distV0, distV2);
+	isRejected = _mm256_or_ps(isRejected, _mm256_and_ps(isPositive(prodDistV0DistV1), isPositive(prodDistV0DistV2)));
+
+	// Everything got rejected early, which is most of the candidates coming out of a BVH
+	unsigned int laneMask = getLaneMask(batch.count);
+	if ((static_cast<unsigned int>(_mm256_movemask_ps(isRejected)) & laneMask) == laneMask) return 0u;
+
+	Vec3x8 intersectLineDirection = cross(N1, N2);
+	__m256 maxComp = abs(intersectLineDirection.x);
+	__m256 yComp = abs(intersectLineDirection.y);
+	__m256 zComp = abs(intersectLineDirection.z);
+	__m256 isYMax = _mm256_cmp_ps(yComp, maxComp, _CMP_GT_OQ);
+	maxComp = _mm256_blendv_ps(maxComp, yComp, isYMax);
+	__m256 isZMax = _mm256_cmp_ps(zComp, maxComp, _CMP_GT_OQ);
+
+	__m256 isect0Start, isect0End, isect1Start, isect1End;
+	__m256 isCoplanar = _mm256_setzero_ps();
+
+	computeIntersectIntervals( project(v0, isYMax, isZMax), project(v1, isYMax, isZMax), project(v2, isYMax, isZMax),
+							   distV0, distV1, distV2, prodDistV0DistV1, prodDistV0DistV2,
+							   isect0Start, isect0End, isCoplanar );
+
+	computeIntersectIntervals( project(u0, isYMax, isZMax), project(u1, isYMax, isZMax), project(u2, isYMax, isZMax),
+							   distU0, distU1, distU2, prodDistU0DistU1, prodDistU0DistU2,
+							   isect1Start, isect1End, isCoplanar );
+
+	// SORT
+	__m256 isect0Min = _mm256_min_ps(isect0Start, isect0End), isect0Max = _mm256_max_ps(isect0Start, isect0End);
+	__m256 isect1Min = _mm256_min_ps(isect1Start, isect1End), isect1Max = _mm256_max_ps(isect1Start, isect1End);
+
+	// !(isect0Max < isect1Min || isect1Max < isect0Min)
+	__m256 isOverlapping = _mm256_and_ps(_mm256_cmp_ps(isect0Max, isect1Min, _CMP_NLT_UQ),
+										 _mm256_cmp_ps(isect1Max, isect0Min, _CMP_NLT_UQ));
+
+	unsigned int rejectedMask = static_cast<unsigned int>(_mm256_movemask_ps(isRejected));
+	unsigned int coplanarMask = static_cast<unsigned int>(_mm256_movemask_ps(isCoplanar)) & ~rejectedMask & laneMask;
+	unsigned int hitMask = static_cast<unsigned int>(_mm256_movemask_ps(isOverlapping)) & ~rejectedMask & ~coplanarMask & laneMask;
+
+	for (int lane = 0; coplanarMask; ++lane, coplanarMask >>= 1)
+	{
+		if ((coplanarMask & 1u) && scalarTest(batch, lane)) hitMask |= 1u << lane;
+	}
+
+	return hitMask;
+}
+
+P3_AVX2_END
+#endif
+}
+
+unsigned int P3::fastTriTriIntersect3DTestBatch(TriTriBatch const &batch)
+{
+	if (batch.isEmpty()) return 0u;
+
+#ifdef P3_SIMD_AVX2
+	if (hasAvx2()) return testBatchAvx2(batch);
+#endif
+
+	return testBatchScalar(batch);
+}
@@ -0,0 +1,60 @@
+/**
+ * Batched 3D triangle-triangle intersection test. Same test as fastTriTriIntersect3DTest, but 8 triangle
+ *  pairs are stored structure of arrays so every step runs on all of them at once. On a CPU with AVX2,
+ *  and built with P3_USE_AVX2, that's one lane per pair, otherwise it just loops over the scalar test.
+ *
+ * Pairs that turn out to be coplanar are rare, so those lanes fall back to the scalar test one by one.
+ */
+
+#pragma once
+
+#ifndef P3_TRI_TRI_BATCH_H
+#define P3_TRI_TRI_BATCH_H
+
+#include <glm/glm.hpp>
+
+namespace P3
+{
+constexpr int cTriTriBatchSize = 8;
+
+struct TriTriBatch
+{
+	// Indexed [vertex][axis][lane]
+	float v[3][3][cTriTriBatchSize];
+	float u[3][3][cTriTriBatchSize];
+
+	// Whatever the caller needs to map a lane back to its pair, e.g. the 2 triangle indices
+	glm::ivec2 pairIds[cTriTriBatchSize];
+
+	int count = 0;
+
+	// Returns true once the batch is full and has to be flushed
+	bool push( glm::vec3 const &v0, glm::vec3 const &v1, glm::vec3 const &v2,
+			   glm::vec3 const &u0, glm::vec3 const &u1, glm::vec3 const &u2,
+			   glm::ivec2 const &pairId )
+	{
+		glm::vec3 const *pVertices[6] = { &v0, &v1, &v2, &u0, &u1, &u2 };
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			for (int vertexIdx = 0; vertexIdx < 3; ++vertexIdx)
+			{
+				v[vertexIdx][axis][count] = (*pVertices[vertexIdx])[axis];
+				u[vertexIdx][axis][count] = (*pVertices[vertexIdx + 3])[axis];
+			}
+		}
+
+		pairIds[count] = pairId;
+
+		return ++count == cTriTriBatchSize;
+	}
+
+	bool isEmpty() const { return !count; }
+	void clear() { count = 0; }
+};
+
+// Bit i is set if the triangles in lane i intersect. Lanes past count are always 0.
+unsigned int fastTriTriIntersect3DTestBatch(TriTriBatch const &);
+}
+
+#endif // P3_TRI_TRI_BATCH_H
@@ -0,0 +1,92 @@
+#include "P3TriangleMeshCollider.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+constexpr float cDegenerateAreaSq = 1e-12f;
+constexpr float cFlatEdgeCosAngle = 0.999f;
+
+namespace P3
+{
+void TriangleMeshCollider::create( std::vector<float> const &positions,
+								   std::vector<unsigned int> const &elements,
+								   glm::mat4 const &model )
+{
+	mVertices.clear();
+	mTriangles.clear();
+	mActiveEdgeFlags.clear();
+
+	mVertices.reserve(positions.size() / 3);
+	for (size_t i = 0; i + 2 < positions.size(); i += 3)
+	{
+		mVertices.emplace_back(model * glm::vec4(positions[i], positions[i + 1], positions[i + 2], 1.0f));
+	}
+
+	std::vector<Aabb> triangleAabbs;
+	mTriangles.reserve(elements.size() / 3);
+	triangleAabbs.reserve(elements.size() / 3);
+
+	for (size_t i = 0; i + 2 < elements.size(); i += 3)
+	{
+		glm::uvec3 triangle(elements[i], elements[i + 1], elements[i + 2]);
+
+		glm::vec3 const &a = mVertices[triangle.x];
+		glm::vec3 const &b = mVertices[triangle.y];
+		glm::vec3 const &c = mVertices[triangle.z];
+
+		// No normal can be computed for these, and they can't be touched anyway
+		glm::vec3 doubleAreaNormal = glm::cross(b - a, c - a);
+		if (glm::dot(doubleAreaNormal, doubleAreaNormal) <= cDegenerateAreaSq) continue;
+
+		mTriangles.emplace_back(triangle);
+		triangleAabbs.emplace_back(glm::vec4(glm::min(a, glm::min(b, c)), 1.0f), glm::vec4(glm::max(a, glm::max(b, c)), 1.0f));
+	}
+
+	// An edge shared by 2 (almost) coplanar triangles is internal, e.g. the diagonal of a quad. A box sliding over it
+	//  must only see the face normal, otherwise it catches on the edge. Only works for meshes with shared vertices.
+	std::unordered_map<uint64_t, int> edgeToTriangleMap;
+	mActiveEdgeFlags.assign(mTriangles.size(), 0x7);
+
+	for (size_t triangleIdx = 0; triangleIdx < mTriangles.size(); ++triangleIdx)
+	{
+		glm::uvec3 const &triangle = mTriangles[triangleIdx];
+
+		for (int edgeIdx = 0; edgeIdx < 3; ++edgeIdx)
+		{
+			unsigned int start = triangle[edgeIdx];
+			unsigned int end   = triangle[(edgeIdx + 1) % 3];
+			uint64_t edgeKey = (uint64_t(std::min(start, end)) << 32) | std::max(start, end);
+
+			auto edgeIter = edgeToTriangleMap.find(edgeKey);
+			if (edgeIter == edgeToTriangleMap.end())
+			{
+				edgeToTriangleMap[edgeKey] = static_cast<int>(triangleIdx) * 3 + edgeIdx;
+				continue;
+			}
+
+			int otherTriangleIdx = edgeIter->second / 3;
+			int otherEdgeIdx     = edgeIter->second % 3;
+
+			if (glm::abs(glm::dot(getNormal(static_cast<int>(triangleIdx)), getNormal(otherTriangleIdx))) >= cFlatEdgeCosAngle)
+			{
+				mActiveEdgeFlags[triangleIdx]      &= ~(1 << edgeIdx);
+				mActiveEdgeFlags[otherTriangleIdx] &= ~(1 << otherEdgeIdx);
+			}
+		}
+	}
+
+	mBvh.build(triangleAabbs);
+}
+
+glm::vec3 TriangleMeshCollider::getNormal(int triangleIdx) const
+{
+	glm::vec3 const &a = getVertex(triangleIdx, 0);
+	glm::vec3 const &b = getVertex(triangleIdx, 1);
+	glm::vec3 const &c = getVertex(triangleIdx, 2);
+
+	return glm::normalize(glm::cross(b - a, c - a));
+}
+}
@@ -0,0 +1,57 @@
+/**
+ * A static, concave collider made out of triangles, e.g. a level or a terrain loaded as a Shape.
+ *  Since the mesh never moves, the vertices are baked into world space once, and a BVH over the
+ *  triangles is built once. Moving bodies then only look at the triangles their Aabb overlaps.
+ */
+
+#pragma once
+
+#ifndef P3_TRIANGLE_MESH_COLLIDER_H
+#define P3_TRIANGLE_MESH_COLLIDER_H
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <utility>
+#include <vector>
+
+#include "P3Bvh.h"
+
+namespace P3
+{
+class TriangleMeshCollider
+{
+public:
+	// Same layout as Shape::posBuf and Shape::eleBuf, 3 floats per vertex and 3 indices per triangle
+	void create(std::vector<float> const &, std::vector<unsigned int> const &, glm::mat4 const & = glm::mat4(1.0f));
+
+	// Invoke func(triangleIdx) for every triangle whose Aabb overlaps the query box
+	template<typename Func>
+	void query(Aabb const &queryAabb, Func &&func) const
+	{
+		mBvh.query(queryAabb, std::forward<Func>(func));
+	}
+
+	glm::vec3 const &getVertex(int triangleIdx, int cornerIdx) const
+	{
+		return mVertices[mTriangles[triangleIdx][cornerIdx]];
+	}
+
+	// Bit i is set if edge (i, i + 1) of the triangle can generate edge contacts, see create()
+	unsigned char getActiveEdges(int triangleIdx) const { return mActiveEdgeFlags[triangleIdx]; }
+
+	glm::vec3 getNormal(int triangleIdx) const;
+
+	int getTriangleCount() const { return static_cast<int>(mTriangles.size()); }
+	Bvh const &getBvh() const { return mBvh; }
+	std::vector<glm::vec3> const &getVertices() const { return mVertices; }
+	std::vector<glm::uvec3> const &getTriangles() const { return mTriangles; }
+
+private:
+	std::vector<glm::vec3> mVertices;   // World space
+	std::vector<glm::uvec3> mTriangles; // Degenerate triangles are dropped on creation
+	std::vector<unsigned char> mActiveEdgeFlags;
+	Bvh mBvh;
+};
+}
+
+#endif // P3_TRIANGLE_MESH_COLLIDER_H
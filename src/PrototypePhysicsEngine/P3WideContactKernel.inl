@@ -0,0 +1,126 @@
+// The solve of a batch, included once per instruction set by P3WideContactSolver.cpp, see P3Simd.h.
+//  Not a header on its own, so no include guard.
+
+struct SymmetricMat3x8
+{
+	Float8 xx, yy, zz, xy, xz, yz;
+};
+
+inline SymmetricMat3x8 loadSymmetric(float const (&p)[6][cLaneCount])
+{
+	return { load(p[0]), load(p[1]), load(p[2]), load(p[3]), load(p[4]), load(p[5]) };
+}
+
+// Same operation order as P3::SymmetricMat3
+inline Vec3x8 operator*(SymmetricMat3x8 const &a, Vec3x8 const &v)
+{
+	return { a.xx * v.x + a.xy * v.y + a.xz * v.z,
+			 a.xy * v.x + a.yy * v.y + a.yz * v.z,
+			 a.xz * v.x + a.yz * v.y + a.zz * v.z };
+}
+
+void gatherVelocities(int const (&bodyIndices)[cLaneCount], std::vector<P3::SolverBody> const &solverBodies, Vec3x8 &v, Vec3x8 &w)
+{
+	float linear[3][cLaneCount], angular[3][cLaneCount];
+
+	for (int lane = 0; lane < cLaneCount; ++lane)
+	{
+		int bodyIdx = bodyIndices[lane];
+
+		packLane(linear, lane, bodyIdx >= 0 ? solverBodies[bodyIdx].linearVelocity : glm::vec3(0.0f));
+		packLane(angular, lane, bodyIdx >= 0 ? solverBodies[bodyIdx].angularVelocity : glm::vec3(0.0f));
+	}
+
+	v = load(linear);
+	w = load(angular);
+}
+
+// Only dynamic bodies, static ones may be shared by several lanes and never change anyway
+void scatterVelocities( int const (&bodyIndices)[cLaneCount],
+						Vec3x8 const &v, Vec3x8 const &w,
+						std::vector<P3::SolverBody> &solverBodies )
+{
+	float linear[3][cLaneCount], angular[3][cLaneCount];
+	store(linear, v);
+	store(angular, w);
+
+	for (int lane = 0; lane < cLaneCount; ++lane)
+	{
+		int bodyIdx = bodyIndices[lane];
+		if (bodyIdx < 0 || !solverBodies[bodyIdx].isDynamic())
+			continue;
+
+		solverBodies[bodyIdx].linearVelocity = glm::vec3(linear[0][lane], linear[1][lane], linear[2][lane]);
+		solverBodies[bodyIdx].angularVelocity = glm::vec3(angular[0][lane], angular[1][lane], angular[2][lane]);
+	}
+}
+
+float solveBatch(P3::WideContactBatch const &batch, P3::WideContactRow *rows, std::vector<P3::SolverBody> &solverBodies)
+{
+	Vec3x8 vA, wA, vB, wB;
+	gatherVelocities(batch.referenceBodyIndices, solverBodies, vA, wA);
+	gatherVelocities(batch.incidentBodyIndices, solverBodies, vB, wB);
+
+	Vec3x8 normal = load(batch.normal);
+	Vec3x8 tangents[2] = { load(batch.tangents[0]), load(batch.tangents[1]) };
+	Float8 friction = load(batch.friction);
+	Float8 referenceInverseMass = load(batch.referenceInverseMass);
+	Float8 incidentInverseMass = load(batch.incidentInverseMass);
+	SymmetricMat3x8 referenceInverseInertia = loadSymmetric(batch.referenceInverseInertia);
+	SymmetricMat3x8 incidentInverseInertia = loadSymmetric(batch.incidentInverseInertia);
+	Float8 zero = splat(0.0f);
+	Float8 residual = zero;
+
+	for (int rowIdx = batch.firstRowIdx; rowIdx < batch.firstRowIdx + batch.rowCount; ++rowIdx)
+	{
+		P3::WideContactRow &row = rows[rowIdx];
+
+		Vec3x8 rA = load(row.referenceRelativePosition);
+		Vec3x8 rB = load(row.incidentRelativePosition);
+
+		// Relative velocity at contact
+		Vec3x8 dv = vB + cross(wB, rB) - vA - cross(wA, rA);
+
+		// Friction, clamped by the normal impulse so far
+		Float8 maxLambda = friction * load(row.normalImpulse);
+
+		for (int k = 0; k < 2; ++k)
+		{
+			Float8 lambda = zero - dot(dv, tangents[k]) * load(row.tangentMasses[k]);
+
+			Float8 oldTangentImpulse = load(row.tangentImpulses[k]);
+			Float8 tangentImpulse = min(max(oldTangentImpulse + lambda, zero - maxLambda), maxLambda);
+			store(row.tangentImpulses[k], tangentImpulse);
+			lambda = tangentImpulse - oldTangentImpulse;
+			residual = max(residual, abs(lambda));
+
+			Vec3x8 P = tangents[k] * lambda;
+			vA = vA - P * referenceInverseMass;
+			wA = wA - referenceInverseInertia * cross(rA, P);
+			vB = vB + P * incidentInverseMass;
+			wB = wB + incidentInverseInertia * cross(rB, P);
+		}
+
+		// Normal impulse, with the positional bias factored in
+		dv = vB + cross(wB, rB) - vA - cross(wA, rA);
+		Float8 vn = dot(dv, normal);
+		Float8 lambda = load(row.normalMass) * (zero - vn + load(row.bias));
+
+		Float8 oldNormalImpulse = load(row.normalImpulse);
+		Float8 normalImpulse = max(oldNormalImpulse + lambda, zero);
+		store(row.normalImpulse, normalImpulse);
+		lambda = normalImpulse - oldNormalImpulse;
+		residual = max(residual, abs(lambda));
+
+		Vec3x8 P = normal * lambda;
+		vA = vA - P * referenceInverseMass;
+		wA = wA - referenceInverseInertia * cross(rA, P);
+		vB = vB + P * incidentInverseMass;
+		wB = wB + incidentInverseInertia * cross(rB, P);
+	}
+
+	scatterVelocities(batch.referenceBodyIndices, vA, wA, solverBodies);
+	scatterVelocities(batch.incidentBodyIndices, vB, wB, solverBodies);
+
+	return reduceMax(residual);
+}
@@ -0,0 +1,162 @@
+#include "P3WideContactSolver.h"
+
+#include <algorithm>
+
+#include "P3NarrowPhaseCommon.h"
+#include "P3Simd.h"
+
+namespace
+{
+constexpr int cLaneCount = P3::cWideContactLaneCount;
+static_assert(cLaneCount == P3::cSimdLaneCount, "One manifold per SIMD lane");
+
+void packLane(float (&dst)[3][cLaneCount], int lane, glm::vec3 const &v)
+{
+	dst[0][lane] = v.x;
+	dst[1][lane] = v.y;
+	dst[2][lane] = v.z;
+}
+
+void packLane(float (&dst)[6][cLaneCount], int lane, P3::SymmetricMat3 const &m)
+{
+	dst[0][lane] = m.xx;
+	dst[1][lane] = m.yy;
+	dst[2][lane] = m.zz;
+	dst[3][lane] = m.xy;
+	dst[4][lane] = m.xz;
+	dst[5][lane] = m.yz;
+}
+
+namespace ScalarKernel
+{
+using namespace P3::Scalar;
+#include "P3WideContactKernel.inl"
+}
+
+#ifdef P3_SIMD_AVX2
+P3_AVX2_BEGIN
+
+namespace Avx2Kernel
+{
+using namespace P3::Avx2;
+#include "P3WideContactKernel.inl"
+}
+
+P3_AVX2_END
+#endif
+}
+
+namespace P3
+{
+void WideContactSolver::prepare( ManifoldGpuPackage const &manifoldPkg,
+								 std::vector<std::vector<int>> const &colorManifoldIndices,
+								 std::vector<SolverBody> const &solverBodies )
+{
+	mBatches.clear();
+	mRows.clear();
+	mColorFirstBatchIndices.assign(1, 0);
+
+	for (std::vector<int> const &manifoldIndices : colorManifoldIndices)
+	{
+		int manifoldCount = static_cast<int>(manifoldIndices.size());
+		for (int first = 0; first < manifoldCount; first += cLaneCount)
+		{
+			// Zeroed, so unused lanes and contact slots have 0 masses
+			mBatches.push_back(WideContactBatch());
+			WideContactBatch &batch = mBatches.back();
+
+			batch.laneCount = std::min(cLaneCount, static_cast<int>(manifoldIndices.size()) - first);
+			batch.firstRowIdx = static_cast<int>(mRows.size());
+			batch.rowCount = 0;
+
+			for (int lane = 0; lane < batch.laneCount; ++lane)
+			{
+				batch.rowCount = std::max(batch.rowCount, manifoldPkg.manifolds[manifoldIndices[first + lane]].contactBoxIndicesAndContactCount.z);
+			}
+
+			mRows.resize(mRows.size() + batch.rowCount, WideContactRow());
+
+			for (int lane = 0; lane < cLaneCount; ++lane)
+			{
+				if (lane >= batch.laneCount)
+				{
+					batch.manifoldIndices[lane] = -1;
+					batch.referenceBodyIndices[lane] = -1;
+					batch.incidentBodyIndices[lane] = -1;
+					continue;
+				}
+
+				int manifoldIdx = manifoldIndices[first + lane];
+				Manifold const &manifold = manifoldPkg.manifolds[manifoldIdx];
+				Contact const *contacts = manifoldPkg.getContacts(manifold);
+
+				int referenceBoxIdx = manifold.contactBoxIndicesAndContactCount.x;
+				int incidentBoxIdx  = manifold.contactBoxIndicesAndContactCount.y;
+
+				batch.manifoldIndices[lane] = manifoldIdx;
+				batch.referenceBodyIndices[lane] = referenceBoxIdx;
+				batch.incidentBodyIndices[lane] = incidentBoxIdx;
+
+				packLane(batch.normal, lane, glm::vec3(manifold.contactNormal));
+				packLane(batch.tangents[0], lane, glm::vec3(manifold.contactTangents[0]));
+				packLane(batch.tangents[1], lane, glm::vec3(manifold.contactTangents[1]));
+				batch.friction[lane] = manifold.frictionRestitution.x;
+
+				batch.referenceInverseMass[lane] = solverBodies[referenceBoxIdx].inverseMass;
+				batch.incidentInverseMass[lane]  = solverBodies[incidentBoxIdx].inverseMass;
+				packLane(batch.referenceInverseInertia, lane, solverBodies[referenceBoxIdx].worldInverseInertia);
+				packLane(batch.incidentInverseInertia, lane, solverBodies[incidentBoxIdx].worldInverseInertia);
+
+				for (int contactPointIdx = 0; contactPointIdx < manifold.contactBoxIndicesAndContactCount.z; ++contactPointIdx)
+				{
+					Contact const &contact = contacts[contactPointIdx];
+					WideContactRow &row = mRows[batch.firstRowIdx + contactPointIdx];
+
+					packLane(row.referenceRelativePosition, lane, glm::vec3(contact.referenceRelativePosition));
+					packLane(row.incidentRelativePosition, lane, glm::vec3(contact.incidentRelativePosition));
+					row.normalMass[lane] = contact.normalTangentMassesBias.x;
+					row.tangentMasses[0][lane] = contact.normalTangentMassesBias.y;
+					row.tangentMasses[1][lane] = contact.normalTangentMassesBias.z;
+					row.bias[lane] = contact.normalTangentMassesBias.w;
+					row.normalImpulse[lane] = contact.normalTangentBiasImpulses.x;
+					row.tangentImpulses[0][lane] = contact.normalTangentBiasImpulses.y;
+					row.tangentImpulses[1][lane] = contact.normalTangentBiasImpulses.z;
+				}
+			}
+		}
+
+		mColorFirstBatchIndices.push_back(static_cast<int>(mBatches.size()));
+	}
+}
+
+float WideContactSolver::solveBatch(int batchIdx, std::vector<SolverBody> &solverBodies)
+{
+#ifdef P3_SIMD_AVX2
+	if (hasAvx2()) return Avx2Kernel::solveBatch(mBatches[batchIdx], mRows.data(), solverBodies);
+#endif
+
+	return ScalarKernel::solveBatch(mBatches[batchIdx], mRows.data(), solverBodies);
+}
+
+void WideContactSolver::finish(ManifoldGpuPackage &manifoldPkg) const
+{
+	for (WideContactBatch const &batch : mBatches)
+	{
+		for (int lane = 0; lane < batch.laneCount; ++lane)
+		{
+			Manifold const &manifold = manifoldPkg.manifolds[batch.manifoldIndices[lane]];
+			Contact *contacts = manifoldPkg.getContacts(manifold);
+
+			for (int contactPointIdx = 0; contactPointIdx < manifold.contactBoxIndicesAndContactCount.z; ++contactPointIdx)
+			{
+				WideContactRow const &row = mRows[batch.firstRowIdx + contactPointIdx];
+				Contact &contact = contacts[contactPointIdx];
+
+				contact.normalTangentBiasImpulses.x = row.normalImpulse[lane];
+				contact.normalTangentBiasImpulses.y = row.tangentImpulses[0][lane];
+				contact.normalTangentBiasImpulses.z = row.tangentImpulses[1][lane];
+			}
+		}
+	}
+}
+}
@@ -0,0 +1,88 @@
+/**
+ * Wide version of the contact solver iterations. 8 manifolds of the same graph color are packed into
+ *  a batch, structure of arrays, one manifold per lane. Contact i of all 8 manifolds is then solved at
+ *  once, so the normal and friction impulses of 8 contacts come out of the same instructions. Lanes of a
+ *  batch never share a dynamic body, so the velocities are gathered from the solver bodies once per batch and
+ *  scattered at the end.
+ *
+ * With AVX2 each quantity is one __m256, otherwise the same code loops over 8 floats.
+ *
+ * Same math as P3ConstraintSolver::solveManifold. The contacts are prepared by the scalar preSolve first.
+ */
+
+#pragma once
+
+#ifndef P3_WIDE_CONTACT_SOLVER_H
+#define P3_WIDE_CONTACT_SOLVER_H
+
+#include <vector>
+
+#include "P3SolverBody.h"
+
+struct ManifoldGpuPackage;
+
+namespace P3
+{
+constexpr int cWideContactLaneCount = 8;
+
+// Contact i of every manifold in a batch. Lanes whose manifold has fewer contacts have 0 masses, so they
+//  produce 0 impulses and can run along with the others.
+struct WideContactRow
+{
+	float referenceRelativePosition[3][cWideContactLaneCount];
+	float incidentRelativePosition[3][cWideContactLaneCount];
+	float normalMass[cWideContactLaneCount];
+	float tangentMasses[2][cWideContactLaneCount];
+	float bias[cWideContactLaneCount];
+
+	// Accumulated over the iterations, written back to the contacts at the end
+	float normalImpulse[cWideContactLaneCount];
+	float tangentImpulses[2][cWideContactLaneCount];
+};
+
+struct WideContactBatch
+{
+	int laneCount;
+	int manifoldIndices[cWideContactLaneCount];
+	int referenceBodyIndices[cWideContactLaneCount]; // -1 on unused lanes
+	int incidentBodyIndices[cWideContactLaneCount];
+
+	float normal[3][cWideContactLaneCount];
+	float tangents[2][3][cWideContactLaneCount];
+	float friction[cWideContactLaneCount];
+
+	float referenceInverseMass[cWideContactLaneCount];
+	float incidentInverseMass[cWideContactLaneCount];
+	float referenceInverseInertia[6][cWideContactLaneCount]; // Same order as SymmetricMat3
+	float incidentInverseInertia[6][cWideContactLaneCount];
+
+	int firstRowIdx;
+	int rowCount;
+};
+
+class WideContactSolver
+{
+public:
+	// Packs the manifolds of each color into batches. The solver bodies are only read for the masses and inertias.
+	void prepare(ManifoldGpuPackage const &, std::vector<std::vector<int>> const &, std::vector<SolverBody> const &);
+
+	int getColorCount() const { return static_cast<int>(mColorFirstBatchIndices.size()) - 1; }
+	int getFirstBatchIdx(int color) const { return mColorFirstBatchIndices[color]; }
+	int getBatchCount(int color) const { return mColorFirstBatchIndices[color + 1] - mColorFirstBatchIndices[color]; }
+	int getBatchCount() const { return static_cast<int>(mBatches.size()); }
+
+	// One iteration over a batch. Batches of the same color can run in parallel.
+	//  Returns the largest impulse change of any lane, like P3ConstraintSolver::solveManifold.
+	float solveBatch(int batchIdx, std::vector<SolverBody> &);
+
+	// Writes the accumulated impulses back to the contacts, for warm starting the next step
+	void finish(ManifoldGpuPackage &) const;
+
+private:
+	std::vector<WideContactBatch> mBatches;
+	std::vector<WideContactRow> mRows;
+	std::vector<int> mColorFirstBatchIndices; // One past the end for the last color
+};
+}
+
+#endif // P3_WIDE_CONTACT_SOLVER_H
@@ -18,7 +18,8 @@ void RenderSystem::init(int width, int height)
 	initDebug();
 }
 
-void RenderSystem::render(MatrixContainer const &modelMatrices, const CollisionPairGpuPackage *collisionPairs, int rigidBodyCount)
+void RenderSystem::render( MatrixContainer const &modelMatrices, const CollisionPairGpuPackage *collisionPairs,
+						   std::vector<LinearTransform> const &linearTransforms )
 {
 	// Clear framebuffer.
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -39,7 +40,7 @@ void RenderSystem::render(MatrixContainer const &modelMatrices, const CollisionP
 		unsigned int redOrNo = 0u;
 		unsigned int isRigid = 0u;
 
-		isRigid = i < rigidBodyCount;
+		isRigid = i < linearTransforms.size() && isDynamicBody(linearTransforms[i].flags);
 
 		// Check collision pair list if this mesh has collided
 
@@ -127,23 +128,24 @@ void RenderSystem::renderDebug( std::vector<P3BoxCollider> const &boxColliders,
 	);
 	CHECKED_GL_CALL(glDrawArrays(GL_POINTS, 0, cBoxColliderVertCount * boxColliders.size()));
 
-	// The size is not correct, cMaxColliderCount is just a placeholder number.
-	glm::vec4 batchedContactPoints[cMaxContactPointCount * cMaxColliderCount]{};
-	glm::vec4 batchedContactNormals[cMaxContactPointCount * cMaxColliderCount]{};
+	// Sized by the contacts of the package, there is no cap on the manifold count anymore
+	std::vector<glm::vec4> batchedContactPoints(manifoldGpuPackage->misc.y);
+	std::vector<glm::vec4> batchedContactNormals(2 * manifoldGpuPackage->misc.y);
 	int contactPointIdx = 0, contacNormalIdx = 0;
 
 	for (int manifoldIdx = 0; manifoldIdx < manifoldGpuPackage->misc.x; ++manifoldIdx)
 	{
 		Manifold const &manifold = manifoldGpuPackage->manifolds[manifoldIdx];
+		Contact const *contacts = manifoldGpuPackage->getContacts(manifold);
 
 		// Iterate through all the contact points of this manifold
 		for (int k = 0; k < manifold.contactBoxIndicesAndContactCount.z; ++k)
 		{
-			assert(k < cMaxContactPointCount); // Prob move this to the for loop evaluation later for better fail-safe.
+			assert(k < cMaxManifoldContactCount); // Prob move this to the for loop evaluation later for better fail-safe.
 
-			batchedContactPoints[contactPointIdx++]  = manifold.contacts[k].position;
-			batchedContactNormals[contacNormalIdx++] = manifold.contacts[k].position;
-			batchedContactNormals[contacNormalIdx++] = manifold.contacts[k].position
+			batchedContactPoints[contactPointIdx++]  = contacts[k].position;
+			batchedContactNormals[contacNormalIdx++] = contacts[k].position;
+			batchedContactNormals[contacNormalIdx++] = contacts[k].position
 													 + glm::vec4((1.1f * manifold.contactNormal.w) * glm::vec3(manifold.contactNormal), 1.0f);
 		}
 	}
@@ -156,7 +158,7 @@ void RenderSystem::renderDebug( std::vector<P3BoxCollider> const &boxColliders,
 	glBufferData(
 		GL_ARRAY_BUFFER,
 		contactPointIdx * sizeof(glm::vec4),
-		(const void *)batchedContactPoints,
+		(const void *)batchedContactPoints.data(),
 		GL_DYNAMIC_DRAW
 	);
 	CHECKED_GL_CALL(glDrawArrays(GL_POINTS, 0, contactPointIdx));
@@ -167,7 +169,7 @@ void RenderSystem::renderDebug( std::vector<P3BoxCollider> const &boxColliders,
 	glBufferData(
 		GL_ARRAY_BUFFER,
 		contacNormalIdx * sizeof(glm::vec4),
-		(const void *)batchedContactNormals,
+		(const void *)batchedContactNormals.data(),
 		GL_DYNAMIC_DRAW
 	);
 	CHECKED_GL_CALL(glDrawArrays(GL_LINES, 0, contacNormalIdx));
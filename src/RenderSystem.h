@@ -7,6 +7,7 @@
 #include <glm/mat4x4.hpp>
 
 #include "PrototypePhysicsEngine/P3Collider.h"
+#include "PrototypePhysicsEngine/P3Transform.h"
 #include "Program.h"
 #include "Shape.h"
 
@@ -37,7 +38,7 @@ public:
 
 	void init(int, int);
 
-	void render(MatrixContainer const &, const CollisionPairGpuPackage *, int);
+	void render(MatrixContainer const &, const CollisionPairGpuPackage *, std::vector<LinearTransform> const &);
 	void renderInstanced(MatrixContainer const &);
 	void renderDebug(std::vector<P3BoxCollider> const &, const ManifoldGpuPackage *);
 
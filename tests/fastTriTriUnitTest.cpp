@@ -9,6 +9,7 @@
 #include <glm/vec3.hpp>
 
 #include "P3NarrowPhaseCollisionDetection.h"
+#include "P3TriTriBatch.h"
 
 void fastTriTriUnitTestCollide()
 {
@@ -38,6 +39,69 @@ void fastTriTriUnitTestNotCollide()
 	printf("Collided?\t%s\n\n", fastTriTriIntersect3DTest(v0, v1, v2, u0, u1, u2) ? "true" : "false");
 }
 
+void fastTriTriUnitTestCoplanar()
+{
+	// Same plane, overlapping edges
+	glm::vec3 v0{ 0.0f, 0.0f, 0.0f };
+	glm::vec3 v1{ 1.0f, 0.0f, 0.0f };
+	glm::vec3 v2{ 0.0f, 1.0f, 0.0f };
+
+	glm::vec3 u0{ 0.2f, 0.2f, 0.0f };
+	glm::vec3 u1{ 2.0f, 0.2f, 0.0f };
+	glm::vec3 u2{ 0.2f, 2.0f, 0.0f };
+
+	printf("Collided?\t%s\n\n", fastTriTriIntersect3DTest(v0, v1, v2, u0, u1, u2) ? "true" : "false");
+
+	// Same plane, second triangle fully inside the first one
+	u0 = glm::vec3{ 0.1f, 0.1f, 0.0f };
+	u1 = glm::vec3{ 0.3f, 0.1f, 0.0f };
+	u2 = glm::vec3{ 0.1f, 0.3f, 0.0f };
+
+	printf("Collided?\t%s\n\n", fastTriTriIntersect3DTest(v0, v1, v2, u0, u1, u2) ? "true" : "false");
+
+	// Same plane, apart
+	u0 = glm::vec3{ 2.0f, 2.0f, 0.0f };
+	u1 = glm::vec3{ 3.0f, 2.0f, 0.0f };
+	u2 = glm::vec3{ 2.0f, 3.0f, 0.0f };
+
+	printf("Collided?\t%s\n\n", fastTriTriIntersect3DTest(v0, v1, v2, u0, u1, u2) ? "true" : "false");
+}
+
+void fastTriTriUnitTestBatch()
+{
+	// The batched test must agree with the scalar one on every lane, including the coplanar ones
+	glm::vec3 triangles[][6] =
+	{
+		{ { -0.5f, 0.0f, 0.0f }, { 0.0f, 0.5f, 0.0f }, { 0.5f, 0.0f, 0.0f }, { -0.5f, 0.0f, 0.0f }, { 0.0f, 1.0f, 2.0f }, { -0.5f, 0.0f, -2.0f } },
+		{ { -0.5f, 0.0f, 5.0f }, { 0.0f, 0.5f, 5.0f }, { 0.5f, 0.0f, 5.0f }, { -0.5f, 0.0f, 0.0f }, { 0.0f, 1.0f, 2.0f }, { -0.5f, 0.0f, -2.0f } },
+		{ { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.2f, 0.2f, 0.0f }, { 2.0f, 0.2f, 0.0f }, { 0.2f, 2.0f, 0.0f } },
+		{ { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.1f, 0.1f, 0.0f }, { 0.3f, 0.1f, 0.0f }, { 0.1f, 0.3f, 0.0f } },
+		{ { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 2.0f, 2.0f, 0.0f }, { 3.0f, 2.0f, 0.0f }, { 2.0f, 3.0f, 0.0f } },
+		{ { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.2f, 0.2f, -1.0f }, { 0.2f, 0.2f, 1.0f }, { 0.5f, -1.0f, 0.0f } },
+		{ { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 2.0f, 2.0f, -1.0f }, { 2.0f, 2.0f, 1.0f }, { 3.0f, 1.0f, 0.0f } },
+		{ { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 1.0f }, { 2.0f, 0.0f, 0.0f } },
+	};
+
+	P3::TriTriBatch batch;
+	for (int i = 0; i < P3::cTriTriBatchSize; ++i)
+	{
+		glm::vec3 const (&t)[6] = triangles[i];
+		batch.push(t[0], t[1], t[2], t[3], t[4], t[5], glm::ivec2(i, 0));
+	}
+
+	unsigned int hitMask = P3::fastTriTriIntersect3DTestBatch(batch);
+
+	for (int i = 0; i < P3::cTriTriBatchSize; ++i)
+	{
+		glm::vec3 const (&t)[6] = triangles[i];
+		bool isColliding = fastTriTriIntersect3DTest(t[0], t[1], t[2], t[3], t[4], t[5]);
+
+		printf("Lane %d collided?\t%s\tMatches scalar?\t%s\n", i, (hitMask & (1u << i)) ? "true" : "false",
+			   isColliding == ((hitMask & (1u << i)) != 0u) ? "true" : "false");
+	}
+	printf("\n");
+}
+
 inline void fastTriTriUnitTest(glm::vec3 const &v0, glm::vec3 const &v1, glm::vec3 const &v2,
 							   glm::vec3 const &u0, glm::vec3 const &u1, glm::vec3 const &u2)
 {